@@ -0,0 +1,84 @@
+#ifndef ALIGNEDALLOCATOR_H
+#define ALIGNEDALLOCATOR_H
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+// _mm_malloc / _mm_free
+#include <emmintrin.h>
+
+// ----------------------------------------------------------------------------
+// STL allocator returning memory aligned to the given boundary so that the
+// per-particle arrays can be streamed with aligned SSE/AVX loads
+// ----------------------------------------------------------------------------
+
+// Per thread state is aligned to a cache line so that two threads never write to the same
+// line. alignas isn't supported by Visual Studio 2013, which has its own attribute.
+#define CACHE_LINE_SIZE 64
+#ifdef _MSC_VER
+#define CACHE_ALIGNED __declspec(align(CACHE_LINE_SIZE))
+#else
+#define CACHE_ALIGNED alignas(CACHE_LINE_SIZE)
+#endif
+
+template <typename T, std::size_t Alignment = 32>
+class AlignedAllocator
+{
+public:
+	typedef T				value_type;
+	typedef T*				pointer;
+	typedef const T*		const_pointer;
+	typedef T&				reference;
+	typedef const T&		const_reference;
+	typedef std::size_t		size_type;
+	typedef std::ptrdiff_t	difference_type;
+
+	template <typename U>
+	struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+	AlignedAllocator() {}
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+	pointer allocate(size_type n)
+	{
+		if (n == 0)
+		{
+			return nullptr;
+		}
+
+		void* pMemory = _mm_malloc(n * sizeof(T), Alignment);
+		if (pMemory == nullptr)
+		{
+			throw std::bad_alloc();
+		}
+
+		return static_cast<pointer>(pMemory);
+	}
+
+	void deallocate(pointer p, size_type) { _mm_free(p); }
+
+	size_type max_size() const { return static_cast<size_type>(-1) / sizeof(T); }
+
+	template <typename U, typename... Args>
+	void construct(U* p, Args&&... args) { ::new((void*)p) U(std::forward<Args>(args)...); }
+
+	template <typename U>
+	void destroy(U* p) { p->~U(); }
+
+	template <typename U>
+	bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+	template <typename U>
+	bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// std::allocator only aligns to 16 bytes, the elements of a CACHE_ALIGNED type need this one
+template <typename T>
+using CacheAlignedVector = std::vector<T, AlignedAllocator<T, CACHE_LINE_SIZE>>;
+
+#endif // ALIGNEDALLOCATOR_H
@@ -1,12 +1,12 @@
 #include "BaseParticle.h"
 
 #include "SpatialPartition.h"
-#include "ParticleManager.h"
 
 int BaseParticle::ParticleGlobalIndex = 0;
 
 BaseParticle::BaseParticle(const glm::vec2& position, unsigned int parentIndex)
 {
+#ifndef HEADLESS
 	// Shape
 	m_Shape.setPosition(sf::Vector2<float>(position.x, position.y));
 	m_Shape.setRadius(PARTICLE_RADIUS);
@@ -15,6 +15,7 @@ BaseParticle::BaseParticle(const glm::vec2& position, unsigned int parentIndex)
 	m_Shape.setFillColor(m_DefaultColor);
 	m_Shape.setOrigin(m_Shape.getLocalBounds().width / 2.0f, 
 	m_Shape.getLocalBounds().height / 2.0f);
+#endif // HEADLESS
 
 	Position			= position;
 	PredictedPosition	= position;
@@ -28,6 +29,8 @@ BaseParticle::BaseParticle(const glm::vec2& position, unsigned int parentIndex)
 
 	GlobalIndex = ParticleGlobalIndex++;
 
+	m_cellIDsList.Count = 0;
+
 	m_iParentSimulationIndex = parentIndex;
 }
 
@@ -36,104 +39,34 @@ BaseParticle::~BaseParticle()
 {
 }
 
-void BaseParticle::Update()
+#ifndef HEADLESS
+
+void BaseParticle::Draw(sf::RenderWindow& window)
 {
 	// Update the position of the shape
 	m_Shape.setPosition(sf::Vector2<float>(Position.x, Position.y));
-}
 
-void BaseParticle::Draw(sf::RenderWindow& window)
-{
 	window.draw(m_Shape);
 }
 
-void BaseParticle::UpdateNeighbors()
-{
-	ParticleManager& particleMan = ParticleManager::GetInstance();
-	std::vector<BaseParticle*>& particleList = particleMan.GetParticles();
-
-	// Clear the neighbor lists
-	m_FluidNeighborParticles.clear();
-	m_DeformableNeighborParticles.clear();
-
-	// Update neighbors
-	std::map<int, std::vector<int>>& buckets = SpatialPartition::GetInstance().GetBuckets();
-
-	for (unsigned int i = 0; i < m_cellIDsList.size(); i++)
-	{
-		std::vector<int>& currentBucket = buckets[m_cellIDsList[i]];
-		unsigned int iCurrentBucketSize = currentBucket.size();
-
-		for (unsigned int index = 0; index < iCurrentBucketSize; index++)
-		{
-			// Get the current element
-			BaseParticle* pCurrentParticle = particleList[currentBucket[index]];
-
-			if (pCurrentParticle->Index != Index)
-			{
-				if (pCurrentParticle->ParticleType == ParticleType::FluidParticle)
-				{
-					m_FluidNeighborParticles.push_back(pCurrentParticle->GlobalIndex);
-				}
-				else
-				{
-					m_DeformableNeighborParticles.push_back(pCurrentParticle->GlobalIndex);
-				}
-			}
-		}
-	}
-}
+#endif // HEADLESS
 
 void BaseParticle::UpdateCellIds()
 {
-	m_cellIDsList.resize(0);
-
-	float iXPosMRad = (LocalPosition.x - Radius) * INVERSE_CELL_SIZE;
-	float iXPosPRad = (LocalPosition.x + Radius) * INVERSE_CELL_SIZE;
-	float iYPosMRad = (LocalPosition.y - Radius) * INVERSE_CELL_SIZE;
-	float iYPosPRad = (LocalPosition.y + Radius) * INVERSE_CELL_SIZE;
-
-	int iFloorXM = Floor(iXPosMRad);
-	int iFloorXP = Floor(iXPosPRad);
-	int iFloorYM = Floor(iYPosMRad);
-	int iFloorYP = Floor(iYPosPRad);
-
-	// Top left corner
-	int iCellIndex = iFloorXM + iFloorYM * CELL_COLS;
-	m_cellIDsList.push_back(iCellIndex);
-
-	// Top right corner
-	iCellIndex = iFloorXP + iFloorYM * CELL_COLS;
-	if (IsUnique(iCellIndex))
-	{
-		m_cellIDsList.push_back(iCellIndex);
-	}
-
-	// Bottom left corner
-	iCellIndex = iFloorXM + iFloorYP * CELL_COLS;
-	if (IsUnique(iCellIndex))
-	{
-		m_cellIDsList.push_back(iCellIndex);
-	}
-
-	// Bottom right corner
-	iCellIndex = iFloorXP + iFloorYP * CELL_COLS;
-	if (IsUnique(iCellIndex))
-	{
-		m_cellIDsList.push_back(iCellIndex);
-	}
+	m_cellIDsList.Count = 1;
+	m_cellIDsList.IDs[0] = SpatialPartition::ComputeCellID(LocalPosition);
 }
 
 const bool BaseParticle::IsUnique(int element) const
 {
 	unsigned int index = 0;
-	unsigned int size = m_cellIDsList.size();
+	unsigned int size = m_cellIDsList.Count;
 
 	bool unique = true;
 
 	for (index = 0; index < size; index++)
 	{
-		if (element == m_cellIDsList[index])
+		if (element == m_cellIDsList.IDs[index])
 		{
 			return false;
 		}
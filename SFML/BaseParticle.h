@@ -2,6 +2,7 @@
 #define BASEPARTICLE_H
 
 #include "Common.h"
+#include "UniformGrid.h"
 
 #include <set>
 
@@ -26,23 +27,22 @@ public:
 	// Public methods 
 	// ------------------------------------------------------------------------
 
-	virtual void Update();
+#ifndef HEADLESS
+	// The shape is only positioned when the particle is drawn
 	virtual void Draw(sf::RenderWindow& window);
-
-	// Neighbors
-	void UpdateNeighbors();
-	inline std::vector<int>& GetFluidNeighbors() { return m_FluidNeighborParticles; }
-	inline std::vector<int>& GetSoftNeighbors() { return m_DeformableNeighborParticles; }
+#endif // HEADLESS
 
 	void UpdateCellIds();
 	const bool IsUnique(int element) const;
 	
-	std::vector<int>& GetCellIDsList() { return m_cellIDsList; }
+	CellIDList& GetCellIDsList() { return m_cellIDsList; }
 
 	// Colors
+#ifndef HEADLESS
 	inline void SetDefaultColor() { m_Shape.setFillColor(m_DefaultColor); }
 	inline void SetNeighborColor() { m_Shape.setFillColor(m_NeighborColor); }
 	inline void SetCollisionColor() { m_Shape.setFillColor(m_CollisionColor); }
+#endif // HEADLESS
 
 	inline void SetDefaultColor(const sf::Color& newColor) { m_DefaultColor = newColor; }
 
@@ -114,10 +114,15 @@ public:
 
 	inline bool IsCollidingDynamic(BaseParticle& other)
 	{
-		glm::vec2 d = ClosestPointToPointOnLine(Position, Position + Velocity, other.Position);
+		return IsCollidingDynamic(other.Position);
+	}
 
-		float fDx = d.x - other.Position.x;
-		float fDy = d.y - other.Position.y;
+	inline bool IsCollidingDynamic(const glm::vec2& otherPosition)
+	{
+		glm::vec2 d = ClosestPointToPointOnLine(Position, Position + Velocity, otherPosition);
+
+		float fDx = d.x - otherPosition.x;
+		float fDy = d.y - otherPosition.y;
 
 		float fSqrDistance = fDx * fDx + fDy * fDy;
 
@@ -137,48 +142,18 @@ public:
 
 	inline float DistanceToLine(const glm::vec2& p1, const glm::vec2& p2)
 	{
-		float p1p2Length = glm::length(p1 - p2);
-		if (p1p2Length != 0.0f)
-		{
-			return abs((p2.y - p1.y) * Position.x - (p2.x - p1.x) * Position.y + p2.x * p1.y - p2.y * p1.x) / p1p2Length;
-		}
-		else
-		{
-			return 0.0f;
-		}
+		return PointToLineDistance(Position, p1, p2);
 	}
 
 	inline glm::vec2 ClosestPointToPointOnLine(const glm::vec2& p1, const glm::vec2& p2, const glm::vec2& point)
 	{
-		// Intersection point
-		glm::vec2 c = glm::vec2(0.0f);
-
-		// Find the equation of the line
-		float fA1 = p2.y - p1.y;
-		float fB1 = p1.x - p2.x;
-		float fC1 = p1.x * p2.y - p2.x * p1.y;
-
-		// Find the equation of the perpendicular which goes through the current point
-		float fA2 = fA1;
-		float fB2 = -fB1;
-		float fC2 = fB2 * point.x + fA2 * point.y;
-
-		// Calculate the determinant of the system for the 2 equations
-		float fDet = fA1 * fA1 + fB1 * fB1;
-
-		if (fDet == 0.0f)
+		// If the line is degenerate the closest point is the particle itself
+		if (p1 == p2)
 		{
-			// If the determinant is 0.0 the closest point on the line is the point itself
-			c = Position;
-		}
-		else
-		{
-			// Cramer rule to solve the system
-			c.x = (fA1 * fC1 - fB1 * fC2) / fDet;
-			c.y = (fA1 * fC2 + fB1 * fC1) / fDet;
+			return Position;
 		}
 
-		return c;
+		return ClosestPointOnLine(p1, p2, point);
 	}
 
 	inline const unsigned int GetParentIndex() const { return m_iParentSimulationIndex; }
@@ -191,7 +166,7 @@ public:
 	int Index;
 	int GlobalIndex;
 
-	ParticleType ParticleType;
+	::ParticleType ParticleType;
 
 	float Radius;
 	float Mass;
@@ -221,14 +196,13 @@ protected:
 	sf::Color m_CollisionColor;
 	sf::Color m_NeighborColor;
 
+#ifndef HEADLESS
 	// Particle shape
 	sf::CircleShape m_Shape;
-
-	std::vector<int> m_FluidNeighborParticles;
-	std::vector<int> m_DeformableNeighborParticles;
+#endif // HEADLESS
 
 	// List of IDs of the cell the current particle is in
-	std::vector<int> m_cellIDsList;
+	CellIDList m_cellIDsList;
 };
 
 #endif // BASEPARTICLE_H
\ No newline at end of file
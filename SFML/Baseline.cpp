@@ -0,0 +1,430 @@
+#include "Baseline.h"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+
+// ------------------------------------------------------------------------
+
+static const char* BASELINE_HEADER = "name,threads,fluid_particles,soft_bodies,soft_body_particles,reorder_interval,"
+	"steps,warmup_steps,seed,mean_ms,stddev_ms,batches,min_ms,p50_ms,p99_ms,max_ms,source";
+
+// ------------------------------------------------------------------------
+
+BaselineRecord::BaselineRecord()
+	: ThreadCount(1),
+	FluidParticleCount(0),
+	SoftBodyCount(0),
+	SoftBodyParticleCount(0),
+	ReorderInterval(0),
+	StepCount(0),
+	WarmUpSteps(0),
+	Seed(0),
+	Mean(NAN),
+	StandardDeviation(NAN),
+	BatchCount(0),
+	Min(NAN),
+	P50(NAN),
+	P99(NAN),
+	Max(NAN)
+{
+}
+
+// ------------------------------------------------------------------------
+
+double BaselineRecord::GetConfidenceInterval() const
+{
+	if (BatchCount < 2)
+	{
+		return NAN;
+	}
+
+	return GetStudentT95(BatchCount - 1.0) * StandardDeviation / sqrt((double)BatchCount);
+}
+
+// ------------------------------------------------------------------------
+
+bool BaselineRecord::Matches(const BaselineRecord& other) const
+{
+	return Name == other.Name &&
+		ThreadCount == other.ThreadCount &&
+		FluidParticleCount == other.FluidParticleCount &&
+		SoftBodyCount == other.SoftBodyCount &&
+		SoftBodyParticleCount == other.SoftBodyParticleCount &&
+		ReorderInterval == other.ReorderInterval;
+}
+
+// ------------------------------------------------------------------------
+
+void GetBatchMeans(const std::vector<double>& values, unsigned int iBatchCount,
+	double& fMean, double& fStandardDeviation, unsigned int& iUsedBatchCount)
+{
+	iUsedBatchCount = std::min(iBatchCount, (unsigned int)values.size());
+	fMean = NAN;
+	fStandardDeviation = NAN;
+
+	if (iUsedBatchCount == 0)
+	{
+		return;
+	}
+
+	unsigned int iBatchSize = (unsigned int)values.size() / iUsedBatchCount;
+
+	std::vector<double> batchMeans(iUsedBatchCount, 0.0);
+	for (unsigned int iBatch = 0; iBatch < iUsedBatchCount; iBatch++)
+	{
+		for (unsigned int i = 0; i < iBatchSize; i++)
+		{
+			batchMeans[iBatch] += values[iBatch * iBatchSize + i];
+		}
+
+		batchMeans[iBatch] /= iBatchSize;
+	}
+
+	double fSum = 0.0;
+	for (unsigned int iBatch = 0; iBatch < iUsedBatchCount; iBatch++)
+	{
+		fSum += batchMeans[iBatch];
+	}
+	fMean = fSum / iUsedBatchCount;
+
+	// Sample standard deviation
+	double fSumSquares = 0.0;
+	for (unsigned int iBatch = 0; iBatch < iUsedBatchCount; iBatch++)
+	{
+		fSumSquares += (batchMeans[iBatch] - fMean) * (batchMeans[iBatch] - fMean);
+	}
+	fStandardDeviation = iUsedBatchCount > 1 ? sqrt(fSumSquares / (iUsedBatchCount - 1)) : NAN;
+}
+
+// ------------------------------------------------------------------------
+
+double GetStudentT95(double fDegreesOfFreedom)
+{
+	// Quantiles for 1 to 30 degrees of freedom, then 40, 60, 120 and infinity
+	static const double TABLE[] =
+	{
+		12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+		2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+		2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+	};
+
+	if (fDegreesOfFreedom < 1.0)
+	{
+		return TABLE[0];
+	}
+
+	if (fDegreesOfFreedom <= 30.0)
+	{
+		// Linear interpolation for the fractional degrees of freedom of Welch's test
+		unsigned int iLower = (unsigned int)fDegreesOfFreedom;
+		double fFraction = fDegreesOfFreedom - iLower;
+		double fLower = TABLE[iLower - 1];
+		double fUpper = iLower < 30 ? TABLE[iLower] : 2.021;
+
+		return fLower + (fUpper - fLower) * fFraction;
+	}
+
+	// Interpolation in 1 / df, which is close to linear for large df
+	static const double LARGE_DF[] = { 30.0, 40.0, 60.0, 120.0 };
+	static const double LARGE_T[] = { 2.042, 2.021, 2.000, 1.980, 1.960 };
+
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		if (fDegreesOfFreedom <= LARGE_DF[i + 1])
+		{
+			double fFraction = (1.0 / LARGE_DF[i] - 1.0 / fDegreesOfFreedom) / (1.0 / LARGE_DF[i] - 1.0 / LARGE_DF[i + 1]);
+			return LARGE_T[i] + (LARGE_T[i + 1] - LARGE_T[i]) * fFraction;
+		}
+	}
+
+	double fFraction = 1.0 - 120.0 / fDegreesOfFreedom;
+	return LARGE_T[3] + (LARGE_T[4] - LARGE_T[3]) * fFraction;
+}
+
+// ------------------------------------------------------------------------
+
+static void WriteValue(std::ostream& out, double fValue)
+{
+	// Unknown values are left empty
+	if (fValue == fValue)
+	{
+		out << fValue;
+	}
+}
+
+static double ParseValue(const std::string& field)
+{
+	return field.empty() ? NAN : atof(field.c_str());
+}
+
+static unsigned int ParseCount(const std::string& field)
+{
+	return (unsigned int)strtoul(field.c_str(), nullptr, 10);
+}
+
+// ------------------------------------------------------------------------
+
+bool ReadBaselineFile(const std::string& fileName, std::vector<BaselineRecord>& records)
+{
+	std::ifstream inFile(fileName);
+	if (!inFile.is_open())
+	{
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(inFile, line))
+	{
+		if (!line.empty() && line[line.size() - 1] == '\r')
+		{
+			line.erase(line.size() - 1);
+		}
+
+		if (line.empty() || line == BASELINE_HEADER)
+		{
+			continue;
+		}
+
+		std::vector<std::string> fields;
+		std::stringstream lineStream(line);
+		std::string field;
+		while (std::getline(lineStream, field, ','))
+		{
+			fields.push_back(field);
+		}
+
+		// The source is the last field and may be empty
+		if (fields.size() < 16)
+		{
+			continue;
+		}
+		fields.resize(17);
+
+		BaselineRecord record;
+		record.Name = fields[0];
+		record.ThreadCount = ParseCount(fields[1]);
+		record.FluidParticleCount = ParseCount(fields[2]);
+		record.SoftBodyCount = ParseCount(fields[3]);
+		record.SoftBodyParticleCount = ParseCount(fields[4]);
+		record.ReorderInterval = ParseCount(fields[5]);
+		record.StepCount = ParseCount(fields[6]);
+		record.WarmUpSteps = ParseCount(fields[7]);
+		record.Seed = ParseCount(fields[8]);
+		record.Mean = ParseValue(fields[9]);
+		record.StandardDeviation = ParseValue(fields[10]);
+		record.BatchCount = ParseCount(fields[11]);
+		record.Min = ParseValue(fields[12]);
+		record.P50 = ParseValue(fields[13]);
+		record.P99 = ParseValue(fields[14]);
+		record.Max = ParseValue(fields[15]);
+		record.Source = fields[16];
+
+		records.push_back(record);
+	}
+
+	return true;
+}
+
+// ------------------------------------------------------------------------
+
+bool WriteBaselineFile(const std::string& fileName, const std::vector<BaselineRecord>& records)
+{
+	std::ofstream outFile(fileName);
+	if (!outFile.is_open())
+	{
+		return false;
+	}
+
+	outFile << BASELINE_HEADER << std::endl;
+
+	for (const BaselineRecord& record : records)
+	{
+		outFile << record.Name << "," << record.ThreadCount << "," << record.FluidParticleCount << "," <<
+			record.SoftBodyCount << "," << record.SoftBodyParticleCount << "," << record.ReorderInterval << "," <<
+			record.StepCount << "," << record.WarmUpSteps << "," << record.Seed << ",";
+
+		WriteValue(outFile, record.Mean);
+		outFile << ",";
+		WriteValue(outFile, record.StandardDeviation);
+		outFile << "," << record.BatchCount << ",";
+		WriteValue(outFile, record.Min);
+		outFile << ",";
+		WriteValue(outFile, record.P50);
+		outFile << ",";
+		WriteValue(outFile, record.P99);
+		outFile << ",";
+		WriteValue(outFile, record.Max);
+
+		// The source is free text, keep it from adding fields
+		std::string source = record.Source;
+		std::replace(source.begin(), source.end(), ',', ';');
+		outFile << "," << source << std::endl;
+	}
+
+	return true;
+}
+
+// ------------------------------------------------------------------------
+
+void StoreBaselineRecord(std::vector<BaselineRecord>& records, const BaselineRecord& record)
+{
+	for (BaselineRecord& storedRecord : records)
+	{
+		if (storedRecord.Matches(record))
+		{
+			storedRecord = record;
+			return;
+		}
+	}
+
+	records.push_back(record);
+}
+
+// ------------------------------------------------------------------------
+
+bool ConvertTextResults(const std::string& fileName, std::vector<BaselineRecord>& records)
+{
+	std::ifstream inFile(fileName);
+	if (!inFile.is_open())
+	{
+		return false;
+	}
+
+	// The records are named after the file, e.g. benchmarkFluid
+	std::string sourceName = fileName.substr(fileName.find_last_of("/\\") + 1);
+	std::string name = sourceName.substr(0, sourceName.find('.'));
+
+	BaselineRecord record;
+	bool bInRecord = false;
+	unsigned int iRecordIndex = 0;
+
+	std::string line;
+	while (true)
+	{
+		bool bEndOfFile = !std::getline(inFile, line);
+
+		if (!line.empty() && line[line.size() - 1] == '\r')
+		{
+			line.erase(line.size() - 1);
+		}
+
+		// Records are separated by lines of dashes, the notes before the first one are skipped
+		if (bEndOfFile || line.compare(0, 5, "-----") == 0)
+		{
+			if (bInRecord && record.StepCount > 0)
+			{
+				record.Source = sourceName + " #" + std::to_string(++iRecordIndex);
+				records.push_back(record);
+			}
+
+			if (bEndOfFile)
+			{
+				break;
+			}
+
+			record = BaselineRecord();
+			record.Name = name;
+			bInRecord = true;
+			continue;
+		}
+
+		if (!bInRecord)
+		{
+			continue;
+		}
+
+		if (line == "Single threaded.")
+		{
+			record.ThreadCount = 1;
+			continue;
+		}
+
+		size_t iSeparator = line.find(':');
+		if (iSeparator == std::string::npos)
+		{
+			continue;
+		}
+
+		std::string key = line.substr(0, iSeparator);
+		std::string value = line.substr(iSeparator + 1);
+
+		// Times per frame are in seconds
+		if (key == "Thread count")							record.ThreadCount = ParseCount(value);
+		else if (key == "Particle count" ||
+			key == "Fluid particle count")					record.FluidParticleCount = ParseCount(value);
+		else if (key == "Soft body count")					record.SoftBodyCount = ParseCount(value);
+		else if (key == "Soft body particle count")			record.SoftBodyParticleCount = ParseCount(value);
+		else if (key == "Reorder interval")					record.ReorderInterval = ParseCount(value);
+		else if (key == "Total Frames")						record.StepCount = ParseCount(value);
+		else if (key == "Average time per frame")			record.Mean = ParseValue(value) * 1000.0;
+		else if (key == "Min time per frame")				record.Min = ParseValue(value) * 1000.0;
+		else if (key == "Max time per frame")				record.Max = ParseValue(value) * 1000.0;
+	}
+
+	return true;
+}
+
+// ------------------------------------------------------------------------
+
+BaselineComparison CompareToBaseline(const BaselineRecord& baseline, const BaselineRecord& current, double fTolerance)
+{
+	BaselineComparison comparison;
+	comparison.Verdict = BaselineVerdict::NotComparable;
+	comparison.Difference = current.Mean - baseline.Mean;
+	comparison.ConfidenceInterval = NAN;
+	comparison.RelativeDifference = comparison.Difference / baseline.Mean * 100.0;
+
+	if (baseline.BatchCount < 2 || current.BatchCount < 2)
+	{
+		return comparison;
+	}
+
+	// Welch's t-test on the batch means
+	double fBaselineVariance = baseline.StandardDeviation * baseline.StandardDeviation / baseline.BatchCount;
+	double fCurrentVariance = current.StandardDeviation * current.StandardDeviation / current.BatchCount;
+	double fStandardError = sqrt(fBaselineVariance + fCurrentVariance);
+
+	// Welch-Satterthwaite degrees of freedom
+	double fDegreesOfFreedom = 1.0;
+	double fDenominator = fBaselineVariance * fBaselineVariance / (baseline.BatchCount - 1) +
+		fCurrentVariance * fCurrentVariance / (current.BatchCount - 1);
+	if (fDenominator > 0.0)
+	{
+		fDegreesOfFreedom = (fBaselineVariance + fCurrentVariance) * (fBaselineVariance + fCurrentVariance) / fDenominator;
+	}
+
+	comparison.ConfidenceInterval = GetStudentT95(fDegreesOfFreedom) * fStandardError;
+
+	bool bSignificant = fabs(comparison.Difference) > comparison.ConfidenceInterval &&
+		fabs(comparison.RelativeDifference) > fTolerance;
+
+	if (!bSignificant)
+	{
+		comparison.Verdict = BaselineVerdict::Unchanged;
+	}
+	else
+	{
+		comparison.Verdict = comparison.Difference > 0.0 ? BaselineVerdict::Slower : BaselineVerdict::Faster;
+	}
+
+	return comparison;
+}
+
+// ------------------------------------------------------------------------
+
+const char* GetVerdictName(BaselineVerdict verdict)
+{
+	switch (verdict)
+	{
+		case BaselineVerdict::Slower:			return "SLOWER";
+		case BaselineVerdict::Faster:			return "faster";
+		case BaselineVerdict::Unchanged:		return "unchanged";
+		case BaselineVerdict::NotComparable:	return "not comparable";
+		default:								return "invalid";
+	}
+}
+
+// ------------------------------------------------------------------------
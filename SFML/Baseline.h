@@ -0,0 +1,103 @@
+#ifndef BASELINE_H
+#define BASELINE_H
+
+#include <string>
+#include <vector>
+
+// ----------------------------------------------------------------------------
+// Stored benchmark results and their comparison. A baseline file is a CSV
+// file with a header and one record per scenario run. The mean step time of
+// a run comes with the spread of its batch means: the timed steps are split
+// in consecutive batches whose means are close to independent, unlike the
+// step times themselves, so they give an honest confidence interval.
+//
+// The text logs of the application benchmark (Benchmarks/*.txt) convert to
+// records without a spread. They keep the history but can't be compared
+// with any confidence.
+// ----------------------------------------------------------------------------
+
+struct BaselineRecord
+{
+	BaselineRecord();
+
+	std::string Name;
+
+	unsigned int ThreadCount;
+	unsigned int FluidParticleCount;
+	unsigned int SoftBodyCount;
+	unsigned int SoftBodyParticleCount;
+	unsigned int ReorderInterval;
+	unsigned int StepCount;
+	unsigned int WarmUpSteps;
+	unsigned int Seed;
+
+	// Milliseconds. The standard deviation is the one of the batch means, 0 batches if unknown.
+	double Mean;
+	double StandardDeviation;
+	unsigned int BatchCount;
+	double Min;
+	double P50;
+	double P99;
+	double Max;
+
+	// Where the record comes from - benchmark run or converted file
+	std::string Source;
+
+	// Half width of the 95% confidence interval of the mean, NAN without batches
+	double GetConfidenceInterval() const;
+
+	// Same scenario and settings, the times may differ
+	bool Matches(const BaselineRecord& other) const;
+};
+
+// Mean and standard deviation of iBatchCount batch means of the values (the tail which
+// doesn't fill a batch is left out). Fewer values than batches give one batch per value.
+void GetBatchMeans(const std::vector<double>& values, unsigned int iBatchCount,
+	double& fMean, double& fStandardDeviation, unsigned int& iUsedBatchCount);
+
+// Two sided 95% quantile of the Student t distribution
+double GetStudentT95(double fDegreesOfFreedom);
+
+// ------------------------------------------------------------------------
+
+// Read the records of a baseline file, returns false if it can't be opened
+bool ReadBaselineFile(const std::string& fileName, std::vector<BaselineRecord>& records);
+
+// Write the records with a header
+bool WriteBaselineFile(const std::string& fileName, const std::vector<BaselineRecord>& records);
+
+// Replace the record of the same scenario or add it
+void StoreBaselineRecord(std::vector<BaselineRecord>& records, const BaselineRecord& record);
+
+// Records of a text log written by the application benchmark, returns false if it can't be opened
+bool ConvertTextResults(const std::string& fileName, std::vector<BaselineRecord>& records);
+
+// ------------------------------------------------------------------------
+
+enum class BaselineVerdict
+{
+	Slower,
+	Faster,
+	Unchanged,
+	NotComparable,
+};
+
+struct BaselineComparison
+{
+	BaselineVerdict Verdict;
+
+	// Difference of the means (current - baseline) and the half width of its 95% confidence interval, in ms
+	double Difference;
+	double ConfidenceInterval;
+
+	// Difference relative to the baseline mean, in percent
+	double RelativeDifference;
+};
+
+// Welch's t-test of the means. A change is significant when the confidence interval of the
+// difference excludes zero and the change is larger than fTolerance percent of the baseline.
+BaselineComparison CompareToBaseline(const BaselineRecord& baseline, const BaselineRecord& current, double fTolerance);
+
+const char* GetVerdictName(BaselineVerdict verdict);
+
+#endif // BASELINE_H
@@ -0,0 +1,853 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <algorithm>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#endif
+
+#include "Common.h"
+#include "FluidSimulation.h"
+#include "SoftBody.h"
+#include "SimulationManager.h"
+#include "Scenario.h"
+#include "Profiler.h"
+#include "Baseline.h"
+
+// ----------------------------------------------------------------------------
+// Headless benchmark runner. Builds a scenario, simulates it for a fixed
+// number of steps and writes the wall time of every step and of its phases
+// as JSON or CSV, with a summary of each phase in the JSON output. The mean
+// step time can be stored in a baseline file and compared with it later.
+// ----------------------------------------------------------------------------
+
+static void PrintUsage()
+{
+	std::cout << "Usage: PBDBenchmark [options]" << std::endl;
+	std::cout << "  --preset NAME              start from a named scenario (default: default)" << std::endl;
+	std::cout << "  --list-presets             print the preset names and exit" << std::endl;
+	std::cout << "  --fluid-particles N        square block of about N fluid particles" << std::endl;
+	std::cout << "  --soft-bodies N            number of soft bodies" << std::endl;
+	std::cout << "  --soft-body-size WxH       particles of each soft body" << std::endl;
+	std::cout << "  --threads N                solver thread count" << std::endl;
+	std::cout << "  --reorder-interval N       steps between spatial reorders, 0 disables them" << std::endl;
+	std::cout << "  --steps N                  timed steps" << std::endl;
+	std::cout << "  --warmup N                 steps simulated before the timed ones" << std::endl;
+	std::cout << "  --seed N                   random seed" << std::endl;
+	std::cout << "  --format json|csv          output format (default: json)" << std::endl;
+	std::cout << "  --output FILE              output file (default: standard output)" << std::endl;
+	std::cout << "  --trace FILE               write a Chrome trace of the timed steps" << std::endl;
+	std::cout << "  --counters                 count hardware events per phase (Linux perf_event)" << std::endl;
+	std::cout << "Baselines (the step times are only written with --output):" << std::endl;
+	std::cout << "  --save-baseline FILE       store the mean step time of this run in a baseline file" << std::endl;
+	std::cout << "  --baseline FILE            compare this run with its record in a baseline file" << std::endl;
+	std::cout << "  --compare FILE             run and compare every scenario recorded in a baseline file" << std::endl;
+	std::cout << "  --tolerance PERCENT        smallest change reported as significant (default: 2)" << std::endl;
+	std::cout << "  --convert-text FILE        convert a text log of Benchmarks to baseline records in --output," << std::endl;
+	std::cout << "                             may be repeated" << std::endl;
+	std::cout << "The exit code is 2 when a run is significantly slower than its baseline, 1 when a run failed or" << std::endl;
+	std::cout << "found no baseline and 3 when --compare found no record it can compare." << std::endl;
+}
+
+// ------------------------------------------------------------------------
+
+#ifdef PROFILING
+
+// Profiler phase name as a JSON key / CSV column
+static std::string GetPhaseKey(ProfilePhase phase)
+{
+	std::string key = Profiler::GetPhaseName(phase);
+
+	for (unsigned int i = 0; i < key.size(); i++)
+	{
+		key[i] = key[i] == ' ' ? '_' : (char)tolower(key[i]);
+	}
+
+	return key;
+}
+
+#endif // PROFILING
+
+// ------------------------------------------------------------------------
+
+struct PhaseSummary
+{
+	double Mean;
+	double Min;
+	double P50;
+	double P90;
+	double P99;
+	double Max;
+};
+
+static PhaseSummary Summarize(std::vector<double> values)
+{
+	PhaseSummary summary = {};
+
+	if (values.empty())
+	{
+		return summary;
+	}
+
+	std::sort(values.begin(), values.end());
+
+	double fSum = 0.0;
+	for (unsigned int i = 0; i < values.size(); i++)
+	{
+		fSum += values[i];
+	}
+
+	summary.Mean = fSum / values.size();
+	summary.Min = values.front();
+	summary.P50 = NearestRankPercentile(values, 50.0);
+	summary.P90 = NearestRankPercentile(values, 90.0);
+	summary.P99 = NearestRankPercentile(values, 99.0);
+	summary.Max = values.back();
+
+	return summary;
+}
+
+// ------------------------------------------------------------------------
+
+// Wall time of every timed step in milliseconds, one series per phase
+struct BenchmarkResults
+{
+	std::vector<std::string> PhaseNames;
+	std::vector<std::vector<double>> PhaseTimes;
+
+#ifdef PROFILING
+	// Hardware events of each profiler phase over all the timed steps
+	bool HasCounters;
+	unsigned long long CounterTotals[PROFILE_PHASE_COUNT][PERF_COUNTER_COUNT];
+#endif // PROFILING
+};
+
+// ------------------------------------------------------------------------
+
+#ifdef PROFILING
+
+// Particles a phase works on - the soft body phases only see the deformable particles
+static unsigned int GetPhaseParticleCount(ProfilePhase phase, FluidSimulation& fluidSim)
+{
+	switch (phase)
+	{
+		case ProfilePhase::SoftBodyShapeMatching:
+		case ProfilePhase::SoftBodyCollisions:
+		case ProfilePhase::SoftBodyIntegrate:
+			return (unsigned int)ParticleManager::GetInstance().GetDeformableParticles().size();
+		default:
+			return fluidSim.GetPaticleCount();
+	}
+}
+
+// Instructions per cycle and events per particle and step, NAN if the counters are not available
+static double GetCounterRatio(const Scenario& scenario, FluidSimulation& fluidSim, const BenchmarkResults& results,
+	ProfilePhase phase, PerfCounter counter)
+{
+	const unsigned long long* pTotals = results.CounterTotals[(unsigned int)phase];
+	Profiler& profiler = Profiler::GetInstance();
+
+	if (!profiler.IsCounterAvailable(counter))
+	{
+		return NAN;
+	}
+
+	if (counter == PerfCounter::Instructions)
+	{
+		if (!profiler.IsCounterAvailable(PerfCounter::Cycles) || pTotals[(unsigned int)PerfCounter::Cycles] == 0)
+		{
+			return NAN;
+		}
+
+		return (double)pTotals[(unsigned int)PerfCounter::Instructions] / (double)pTotals[(unsigned int)PerfCounter::Cycles];
+	}
+
+	unsigned int iParticleCount = GetPhaseParticleCount(phase, fluidSim);
+	if (iParticleCount == 0)
+	{
+		return NAN;
+	}
+
+	return (double)pTotals[(unsigned int)counter] / ((double)iParticleCount * scenario.StepCount);
+}
+
+// ------------------------------------------------------------------------
+
+static void WriteCounterValue(std::ostream& out, double fValue)
+{
+	if (fValue != fValue)
+	{
+		out << "null";
+	}
+	else
+	{
+		out << fValue;
+	}
+}
+
+static void WriteCountersJSON(std::ostream& out, const Scenario& scenario, FluidSimulation& fluidSim, const BenchmarkResults& results)
+{
+	Profiler& profiler = Profiler::GetInstance();
+
+	out << "  \"counters\": {" << std::endl;
+
+	out << "    \"available\": [";
+	bool bFirst = true;
+	for (unsigned int iCounter = 0; iCounter < PERF_COUNTER_COUNT; iCounter++)
+	{
+		if (profiler.IsCounterAvailable((PerfCounter)iCounter))
+		{
+			out << (bFirst ? "" : ", ") << "\"" << PerfCounterGroup::GetCounterName((PerfCounter)iCounter) << "\"";
+			bFirst = false;
+		}
+	}
+	out << "]," << std::endl;
+
+	// Totals over the timed steps, IPC and misses per particle per step
+	out << "    \"phases\": {" << std::endl;
+	bFirst = true;
+	for (unsigned int iPhase = 0; iPhase < PROFILE_PHASE_COUNT; iPhase++)
+	{
+		ProfilePhase phase = (ProfilePhase)iPhase;
+		if (phase == ProfilePhase::Draw)
+		{
+			continue;
+		}
+
+		const unsigned long long* pTotals = results.CounterTotals[iPhase];
+
+		out << (bFirst ? "" : ",\n") << "      \"" << GetPhaseKey(phase) << "\": { " <<
+			"\"cycles\": " << pTotals[(unsigned int)PerfCounter::Cycles] << ", " <<
+			"\"instructions\": " << pTotals[(unsigned int)PerfCounter::Instructions] << ", " <<
+			"\"ipc\": ";
+		WriteCounterValue(out, GetCounterRatio(scenario, fluidSim, results, phase, PerfCounter::Instructions));
+		out << ", \"l1d_misses_per_particle\": ";
+		WriteCounterValue(out, GetCounterRatio(scenario, fluidSim, results, phase, PerfCounter::L1DMisses));
+		out << ", \"llc_misses_per_particle\": ";
+		WriteCounterValue(out, GetCounterRatio(scenario, fluidSim, results, phase, PerfCounter::LLCMisses));
+		out << ", \"branch_misses_per_particle\": ";
+		WriteCounterValue(out, GetCounterRatio(scenario, fluidSim, results, phase, PerfCounter::BranchMisses));
+		out << " }";
+		bFirst = false;
+	}
+	out << std::endl << "    }" << std::endl;
+
+	out << "  }," << std::endl;
+}
+
+#endif // PROFILING
+
+static void WriteJSON(std::ostream& out, const Scenario& scenario, FluidSimulation& fluidSim, const BenchmarkResults& results)
+{
+	out << "{" << std::endl;
+
+	out << "  \"scenario\": {" << std::endl;
+	out << "    \"name\": \"" << scenario.Name << "\"," << std::endl;
+	out << "    \"fluid_particles\": " << fluidSim.GetPaticleCount() << "," << std::endl;
+	out << "    \"soft_bodies\": " << scenario.SoftBodyCount << "," << std::endl;
+	out << "    \"soft_body_width\": " << scenario.SoftBodyWidth << "," << std::endl;
+	out << "    \"soft_body_height\": " << scenario.SoftBodyHeight << "," << std::endl;
+	out << "    \"soft_body_particles\": " << ParticleManager::GetInstance().GetDeformableParticles().size() << "," << std::endl;
+#ifdef MULTITHREADING
+	out << "    \"threads\": " << fluidSim.GetThreadCount() << "," << std::endl;
+#else
+	out << "    \"threads\": 1," << std::endl;
+#endif // MULTITHREADING
+	out << "    \"hardware_threads\": " << std::thread::hardware_concurrency() << "," << std::endl;
+	out << "    \"kernels\": \"" << fluidSim.GetKernels().Name << "\"," << std::endl;
+	out << "    \"reorder_interval\": " << fluidSim.GetReorderInterval() << "," << std::endl;
+	out << "    \"steps\": " << scenario.StepCount << "," << std::endl;
+	out << "    \"warmup_steps\": " << scenario.WarmUpSteps << "," << std::endl;
+	out << "    \"seed\": " << scenario.Seed << std::endl;
+	out << "  }," << std::endl;
+
+	out << "  \"summary_ms\": {" << std::endl;
+	for (unsigned int iPhase = 0; iPhase < results.PhaseNames.size(); iPhase++)
+	{
+		PhaseSummary summary = Summarize(results.PhaseTimes[iPhase]);
+
+		out << "    \"" << results.PhaseNames[iPhase] << "\": { " <<
+			"\"mean\": " << summary.Mean << ", " <<
+			"\"min\": " << summary.Min << ", " <<
+			"\"p50\": " << summary.P50 << ", " <<
+			"\"p90\": " << summary.P90 << ", " <<
+			"\"p99\": " << summary.P99 << ", " <<
+			"\"max\": " << summary.Max << " }" <<
+			(iPhase + 1 < results.PhaseNames.size() ? "," : "") << std::endl;
+	}
+	out << "  }," << std::endl;
+
+#ifdef PROFILING
+	if (results.HasCounters)
+	{
+		WriteCountersJSON(out, scenario, fluidSim, results);
+	}
+#endif // PROFILING
+
+	out << "  \"steps_ms\": [" << std::endl;
+	for (unsigned int iStep = 0; iStep < scenario.StepCount; iStep++)
+	{
+		out << "    { ";
+		for (unsigned int iPhase = 0; iPhase < results.PhaseNames.size(); iPhase++)
+		{
+			out << "\"" << results.PhaseNames[iPhase] << "\": " << results.PhaseTimes[iPhase][iStep] <<
+				(iPhase + 1 < results.PhaseNames.size() ? ", " : " ");
+		}
+		out << "}" << (iStep + 1 < scenario.StepCount ? "," : "") << std::endl;
+	}
+	out << "  ]" << std::endl;
+
+	out << "}" << std::endl;
+}
+
+// ------------------------------------------------------------------------
+
+static void WriteCSV(std::ostream& out, const Scenario& scenario, const BenchmarkResults& results)
+{
+	out << "step";
+	for (unsigned int iPhase = 0; iPhase < results.PhaseNames.size(); iPhase++)
+	{
+		out << "," << results.PhaseNames[iPhase] << "_ms";
+	}
+	out << std::endl;
+
+	for (unsigned int iStep = 0; iStep < scenario.StepCount; iStep++)
+	{
+		out << iStep;
+		for (unsigned int iPhase = 0; iPhase < results.PhaseNames.size(); iPhase++)
+		{
+			out << "," << results.PhaseTimes[iPhase][iStep];
+		}
+		out << std::endl;
+	}
+}
+
+// ------------------------------------------------------------------------
+
+static const unsigned int BASELINE_BATCH_COUNT = 20;
+
+static BaselineRecord MakeBaselineRecord(const Scenario& scenario, FluidSimulation& fluidSim, const BenchmarkResults& results)
+{
+	BaselineRecord record;
+	record.Name = scenario.Name;
+#ifdef MULTITHREADING
+	record.ThreadCount = fluidSim.GetThreadCount();
+#endif // MULTITHREADING
+	record.FluidParticleCount = fluidSim.GetPaticleCount();
+	record.SoftBodyCount = scenario.SoftBodyCount;
+	record.SoftBodyParticleCount = (unsigned int)ParticleManager::GetInstance().GetDeformableParticles().size();
+	record.ReorderInterval = fluidSim.GetReorderInterval();
+	record.StepCount = scenario.StepCount;
+	record.WarmUpSteps = scenario.WarmUpSteps;
+	record.Seed = scenario.Seed;
+
+	// Consecutive step times are correlated, their batch means much less so
+	GetBatchMeans(results.PhaseTimes[0], BASELINE_BATCH_COUNT, record.Mean, record.StandardDeviation, record.BatchCount);
+
+	PhaseSummary summary = Summarize(results.PhaseTimes[0]);
+	record.Min = summary.Min;
+	record.P50 = summary.P50;
+	record.P99 = summary.P99;
+	record.Max = summary.Max;
+
+	record.Source = std::string("PBDBenchmark ") + fluidSim.GetKernels().Name + " kernels " +
+		std::to_string(std::thread::hardware_concurrency()) + " hardware threads";
+
+	return record;
+}
+
+// ------------------------------------------------------------------------
+
+// Compare with the matching record of the baseline file, returns the exit code
+static int CompareWithBaseline(const std::string& baselineFileName, const BaselineRecord& record, double fTolerance)
+{
+	std::vector<BaselineRecord> baselineRecords;
+	if (!ReadBaselineFile(baselineFileName, baselineRecords))
+	{
+		std::cerr << "Failed to read " << baselineFileName << std::endl;
+		return 1;
+	}
+
+	for (const BaselineRecord& baseline : baselineRecords)
+	{
+		if (!baseline.Matches(record))
+		{
+			continue;
+		}
+
+		BaselineComparison comparison = CompareToBaseline(baseline, record, fTolerance);
+
+		std::cout << record.Name << " (" << record.ThreadCount << " threads): " << baseline.Mean << " -> " << record.Mean <<
+			" ms, " << (comparison.Difference >= 0.0 ? "+" : "") << comparison.Difference << " +/- " << comparison.ConfidenceInterval <<
+			" ms (" << (comparison.RelativeDifference >= 0.0 ? "+" : "") << comparison.RelativeDifference << "%), " <<
+			GetVerdictName(comparison.Verdict) << std::endl;
+
+		return comparison.Verdict == BaselineVerdict::Slower ? 2 : 0;
+	}
+
+	std::cerr << "No baseline for " << record.Name << " with these settings in " << baselineFileName << std::endl;
+	return 1;
+}
+
+// ------------------------------------------------------------------------
+
+// The record keeps the particle count of the soft bodies, not their shape. The shape of the
+// preset is used when it has that count, otherwise the squarest one.
+static std::string GetSoftBodySize(const BaselineRecord& baseline, const Scenario& preset)
+{
+	unsigned int iBodyParticleCount = baseline.SoftBodyCount > 0 ? baseline.SoftBodyParticleCount / baseline.SoftBodyCount : 0;
+	if (iBodyParticleCount == 0 || iBodyParticleCount == (unsigned int)(preset.SoftBodyWidth * preset.SoftBodyHeight))
+	{
+		return std::to_string(preset.SoftBodyWidth) + "x" + std::to_string(preset.SoftBodyHeight);
+	}
+
+	unsigned int iHeight = (unsigned int)sqrt((double)iBodyParticleCount);
+	while (iBodyParticleCount % iHeight != 0)
+	{
+		iHeight--;
+	}
+
+	return std::to_string(iBodyParticleCount / iHeight) + "x" + std::to_string(iHeight);
+}
+
+// ------------------------------------------------------------------------
+
+// Exit code of a command run with system
+static int GetExitCode(int iStatus)
+{
+#ifdef _WIN32
+	return iStatus;
+#else
+	return WIFEXITED(iStatus) ? WEXITSTATUS(iStatus) : 1;
+#endif
+}
+
+// ------------------------------------------------------------------------
+
+// Run every scenario of the baseline file in its own process, the managers are singletons
+static int CompareAll(const char* pExecutable, const std::string& baselineFileName, double fTolerance)
+{
+	std::vector<BaselineRecord> baselineRecords;
+	if (!ReadBaselineFile(baselineFileName, baselineRecords))
+	{
+		std::cerr << "Failed to read " << baselineFileName << std::endl;
+		return 1;
+	}
+
+	int iExitCode = 0;
+	unsigned int iComparedCount = 0;
+
+	for (const BaselineRecord& baseline : baselineRecords)
+	{
+		// Converted text logs have no spread to compare with
+		Scenario scenario;
+		if (baseline.BatchCount < 2 || !GetScenarioPreset(baseline.Name, scenario))
+		{
+			continue;
+		}
+
+		// Every setting of the record, the child only compares with a record of the same scenario
+		std::string command = std::string("\"") + pExecutable + "\"" +
+			" --preset " + baseline.Name +
+			" --fluid-particles " + std::to_string(baseline.FluidParticleCount) +
+			" --soft-bodies " + std::to_string(baseline.SoftBodyCount) +
+			" --soft-body-size " + GetSoftBodySize(baseline, scenario) +
+			" --threads " + std::to_string(baseline.ThreadCount) +
+			" --reorder-interval " + std::to_string(baseline.ReorderInterval) +
+			" --steps " + std::to_string(baseline.StepCount) +
+			" --warmup " + std::to_string(baseline.WarmUpSteps) +
+			" --seed " + std::to_string(baseline.Seed) +
+			" --tolerance " + std::to_string(fTolerance) +
+			" --baseline \"" + baselineFileName + "\"";
+
+		// A slowdown takes precedence over a run that failed or found no baseline
+		std::cout.flush();
+		int iRunExitCode = GetExitCode(system(command.c_str()));
+		if (iRunExitCode == 2)
+		{
+			iExitCode = 2;
+		}
+		else if (iRunExitCode != 0 && iExitCode == 0)
+		{
+			iExitCode = 1;
+		}
+
+		iComparedCount++;
+	}
+
+	// A file without comparable records must not pass as a run without slowdowns
+	if (iComparedCount == 0)
+	{
+		std::cerr << "No record of " << baselineFileName << " can be compared, they need a known preset and batch means" << std::endl;
+		return 3;
+	}
+
+	std::cout << iComparedCount << " scenarios compared, " << (iExitCode == 0 ? "no significant slowdown" : iExitCode == 2 ? "significant slowdowns" : "failed runs") << std::endl;
+
+	return iExitCode;
+}
+
+// ------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+	Scenario scenario;
+	std::string format = "json";
+	std::string outFileName;
+	std::string traceFileName;
+	bool bCounters = false;
+	std::string saveBaselineFileName;
+	std::string baselineFileName;
+	std::string compareFileName;
+	std::vector<std::string> textFileNames;
+	double fTolerance = 2.0;
+
+	// The preset is applied first so that the other options override it
+	for (int iArg = 1; iArg + 1 < argc; iArg++)
+	{
+		if (std::string(argv[iArg]) == "--preset" && !GetScenarioPreset(argv[iArg + 1], scenario))
+		{
+			std::cerr << "Unknown preset: " << argv[iArg + 1] << std::endl;
+			return 1;
+		}
+	}
+
+	for (int iArg = 1; iArg < argc; iArg++)
+	{
+		std::string arg = argv[iArg];
+		bool bHasValue = iArg + 1 < argc;
+
+		if (arg == "--help")
+		{
+			PrintUsage();
+			return 0;
+		}
+		else if (arg == "--list-presets")
+		{
+			std::vector<std::string> names = GetScenarioPresetNames();
+			for (unsigned int i = 0; i < names.size(); i++)
+			{
+				std::cout << names[i] << std::endl;
+			}
+			return 0;
+		}
+		else if (arg == "--preset" && bHasValue)
+		{
+			iArg++;
+		}
+		else if (arg == "--fluid-particles" && bHasValue)
+		{
+			int iParticleCount = std::max(atoi(argv[++iArg]), 1);
+			scenario.FluidWidthCount = (int)ceil(sqrt((double)iParticleCount));
+			scenario.FluidHeightCount = (iParticleCount + scenario.FluidWidthCount - 1) / scenario.FluidWidthCount;
+		}
+		else if (arg == "--soft-bodies" && bHasValue)
+		{
+			scenario.SoftBodyCount = std::max(atoi(argv[++iArg]), 0);
+		}
+		else if (arg == "--soft-body-size" && bHasValue)
+		{
+			std::string size = argv[++iArg];
+			size_t iSeparator = size.find('x');
+			if (iSeparator == std::string::npos)
+			{
+				std::cerr << "Soft body size must be WxH: " << size << std::endl;
+				return 1;
+			}
+
+			scenario.SoftBodyWidth = std::max(atoi(size.substr(0, iSeparator).c_str()), 1);
+			scenario.SoftBodyHeight = std::max(atoi(size.substr(iSeparator + 1).c_str()), 1);
+		}
+		else if (arg == "--threads" && bHasValue)
+		{
+			scenario.ThreadCount = (unsigned int)std::max(atoi(argv[++iArg]), 1);
+		}
+		else if (arg == "--reorder-interval" && bHasValue)
+		{
+			scenario.ReorderInterval = (unsigned int)std::max(atoi(argv[++iArg]), 0);
+		}
+		else if (arg == "--steps" && bHasValue)
+		{
+			scenario.StepCount = (unsigned int)std::max(atoi(argv[++iArg]), 1);
+		}
+		else if (arg == "--warmup" && bHasValue)
+		{
+			scenario.WarmUpSteps = (unsigned int)std::max(atoi(argv[++iArg]), 0);
+		}
+		else if (arg == "--seed" && bHasValue)
+		{
+			scenario.Seed = (unsigned int)strtoul(argv[++iArg], nullptr, 10);
+		}
+		else if (arg == "--format" && bHasValue)
+		{
+			format = argv[++iArg];
+			if (format != "json" && format != "csv")
+			{
+				std::cerr << "Unknown format: " << format << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--output" && bHasValue)
+		{
+			outFileName = argv[++iArg];
+		}
+		else if (arg == "--trace" && bHasValue)
+		{
+			traceFileName = argv[++iArg];
+		}
+		else if (arg == "--counters")
+		{
+			bCounters = true;
+		}
+		else if (arg == "--save-baseline" && bHasValue)
+		{
+			saveBaselineFileName = argv[++iArg];
+		}
+		else if (arg == "--baseline" && bHasValue)
+		{
+			baselineFileName = argv[++iArg];
+		}
+		else if (arg == "--compare" && bHasValue)
+		{
+			compareFileName = argv[++iArg];
+		}
+		else if (arg == "--tolerance" && bHasValue)
+		{
+			fTolerance = std::max(atof(argv[++iArg]), 0.0);
+		}
+		else if (arg == "--convert-text" && bHasValue)
+		{
+			textFileNames.push_back(argv[++iArg]);
+		}
+		else
+		{
+			std::cerr << "Unknown argument: " << arg << std::endl;
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (!textFileNames.empty())
+	{
+		if (outFileName.empty())
+		{
+			std::cerr << "--convert-text needs an --output file" << std::endl;
+			return 1;
+		}
+
+		std::vector<BaselineRecord> records;
+		for (const std::string& textFileName : textFileNames)
+		{
+			if (!ConvertTextResults(textFileName, records))
+			{
+				std::cerr << "Failed to read " << textFileName << std::endl;
+				return 1;
+			}
+		}
+
+		if (!WriteBaselineFile(outFileName, records))
+		{
+			std::cerr << "Failed to write " << outFileName << std::endl;
+			return 1;
+		}
+
+		std::cout << records.size() << " records written to " << outFileName << std::endl;
+		return 0;
+	}
+
+	if (!compareFileName.empty())
+	{
+		return CompareAll(argv[0], compareFileName, fTolerance);
+	}
+
+	// ---------------------------------------------------------------------------
+
+	FluidSimulation* fluidSim = BuildScenario(scenario);
+
+	BenchmarkResults results;
+	results.PhaseNames.push_back("step");
+	results.PhaseNames.push_back("fluid");
+	results.PhaseNames.push_back("grid_build");
+	results.PhaseNames.push_back("soft_bodies");
+
+#ifdef PROFILING
+	// Breakdown of the step, the draw is not part of it
+	for (unsigned int iPhase = 0; iPhase < PROFILE_PHASE_COUNT; iPhase++)
+	{
+		if ((ProfilePhase)iPhase != ProfilePhase::Draw)
+		{
+			results.PhaseNames.push_back(GetPhaseKey((ProfilePhase)iPhase));
+		}
+	}
+#endif // PROFILING
+
+	results.PhaseTimes.resize(results.PhaseNames.size());
+
+#ifdef PROFILING
+	results.HasCounters = bCounters;
+	memset(results.CounterTotals, 0, sizeof(results.CounterTotals));
+
+	Profiler::GetInstance().EnableCounters(bCounters);
+#else
+	if (bCounters)
+	{
+		std::cerr << "Hardware counters need a build with PROFILING" << std::endl;
+	}
+#endif // PROFILING
+
+	for (unsigned int iStep = 0; iStep < scenario.WarmUpSteps + scenario.StepCount; iStep++)
+	{
+#ifdef PROFILING
+		if (iStep == scenario.WarmUpSteps && !traceFileName.empty())
+		{
+			Profiler::GetInstance().StartTrace();
+		}
+#endif // PROFILING
+
+		double fStartTime = GetHighResolutionTime();
+
+		fluidSim->Update(FIXED_DELTA);
+
+		double fFluidEndTime = GetHighResolutionTime();
+
+		SimulationManager::GetInstance().UpdateSoftBodies(FIXED_DELTA, fluidSim->GetWorkerTeam());
+
+		double fEndTime = GetHighResolutionTime();
+
+		PROFILE_END_FRAME();
+
+		if (iStep >= scenario.WarmUpSteps)
+		{
+			results.PhaseTimes[0].push_back((fEndTime - fStartTime) * 1000.0);
+			results.PhaseTimes[1].push_back((fFluidEndTime - fStartTime) * 1000.0);
+			results.PhaseTimes[2].push_back(fluidSim->GetGridBuildTime() * 1000.0);
+			results.PhaseTimes[3].push_back((fEndTime - fFluidEndTime) * 1000.0);
+
+#ifdef PROFILING
+			unsigned int iColumn = 4;
+			for (unsigned int iPhase = 0; iPhase < PROFILE_PHASE_COUNT; iPhase++)
+			{
+				if ((ProfilePhase)iPhase != ProfilePhase::Draw)
+				{
+					results.PhaseTimes[iColumn++].push_back(Profiler::GetInstance().GetLastFrameTime((ProfilePhase)iPhase) * 1000.0);
+				}
+
+				for (unsigned int iCounter = 0; iCounter < PERF_COUNTER_COUNT; iCounter++)
+				{
+					results.CounterTotals[iPhase][iCounter] += Profiler::GetInstance().GetLastFrameCounter((ProfilePhase)iPhase, (PerfCounter)iCounter);
+				}
+			}
+#endif // PROFILING
+		}
+	}
+
+#ifdef PROFILING
+	if (!traceFileName.empty())
+	{
+		Profiler::GetInstance().StopTrace();
+		if (!Profiler::GetInstance().WriteTrace(traceFileName))
+		{
+			std::cerr << "Failed to write the trace to " << traceFileName << std::endl;
+		}
+	}
+#endif // PROFILING
+
+	// ---------------------------------------------------------------------------
+
+	bool bUsesBaseline = !saveBaselineFileName.empty() || !baselineFileName.empty();
+
+	std::ofstream outFile;
+	if (!outFileName.empty())
+	{
+		outFile.open(outFileName);
+		if (!outFile.is_open())
+		{
+			std::cerr << "Failed to open " << outFileName << std::endl;
+			return 1;
+		}
+	}
+
+	std::ostream& out = outFileName.empty() ? std::cout : outFile;
+
+	if (bUsesBaseline && outFileName.empty())
+	{
+		// Only the comparison goes to the console
+	}
+	else if (format == "json")
+	{
+		WriteJSON(out, scenario, *fluidSim, results);
+	}
+	else
+	{
+		WriteCSV(out, scenario, results);
+	}
+
+	// Short summary on the console when the results go to a file
+	if (!outFileName.empty())
+	{
+		PhaseSummary summary = Summarize(results.PhaseTimes[0]);
+		std::cout << scenario.Name << ": " << fluidSim->GetPaticleCount() << " fluid particles, " <<
+			ParticleManager::GetInstance().GetDeformableParticles().size() << " soft body particles, " <<
+			scenario.StepCount << " steps, mean " << summary.Mean << " ms, p50 " << summary.P50 <<
+			" ms, p99 " << summary.P99 << " ms" << std::endl;
+
+#ifdef PROFILING
+		if (results.HasCounters && !Profiler::GetInstance().IsCounterAvailable(PerfCounter::Cycles))
+		{
+			std::cout << "Hardware counters are not available (no PMU or perf_event_paranoid too high)" << std::endl;
+		}
+		else if (results.HasCounters)
+		{
+			for (unsigned int iPhase = 0; iPhase < PROFILE_PHASE_COUNT; iPhase++)
+			{
+				ProfilePhase phase = (ProfilePhase)iPhase;
+				if (phase != ProfilePhase::Draw)
+				{
+					std::cout << "  " << Profiler::GetPhaseName(phase) <<
+						": IPC " << GetCounterRatio(scenario, *fluidSim, results, phase, PerfCounter::Instructions) <<
+						", L1D misses/particle " << GetCounterRatio(scenario, *fluidSim, results, phase, PerfCounter::L1DMisses) <<
+						", LLC misses/particle " << GetCounterRatio(scenario, *fluidSim, results, phase, PerfCounter::LLCMisses) <<
+						", branch misses/particle " << GetCounterRatio(scenario, *fluidSim, results, phase, PerfCounter::BranchMisses) << std::endl;
+				}
+			}
+		}
+#endif // PROFILING
+	}
+
+	int iExitCode = 0;
+
+	if (bUsesBaseline)
+	{
+		BaselineRecord record = MakeBaselineRecord(scenario, *fluidSim, results);
+
+		if (!baselineFileName.empty())
+		{
+			iExitCode = CompareWithBaseline(baselineFileName, record, fTolerance);
+		}
+
+		if (!saveBaselineFileName.empty())
+		{
+			// A missing file starts a new baseline
+			std::vector<BaselineRecord> baselineRecords;
+			ReadBaselineFile(saveBaselineFileName, baselineRecords);
+			StoreBaselineRecord(baselineRecords, record);
+
+			if (!WriteBaselineFile(saveBaselineFileName, baselineRecords))
+			{
+				std::cerr << "Failed to write " << saveBaselineFileName << std::endl;
+				return 1;
+			}
+
+			std::cout << record.Name << ": mean " << record.Mean << " +/- " << record.GetConfidenceInterval() <<
+				" ms stored in " << saveBaselineFileName << std::endl;
+		}
+	}
+
+	return iExitCode;
+}
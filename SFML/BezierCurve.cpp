@@ -40,6 +40,8 @@ void BezierCurve::CalculateMulticurveBezierPoints(std::vector<glm::vec2>& finalP
 	}
 }
 
+#ifndef HEADLESS
+
 void BezierCurve::DrawBezierCurve(sf::RenderWindow& window, const std::vector<glm::vec2>& bezierPoints)
 {
 	for (unsigned int i = 0; i < bezierPoints.size() - 1; i++)
@@ -48,6 +50,8 @@ void BezierCurve::DrawBezierCurve(sf::RenderWindow& window, const std::vector<gl
 	}
 }
 
+#endif // HEADLESS
+
 void BezierCurve::CalculateControlPointPosition(const glm::vec2& p0,
 	const glm::vec2& controlPoint,
 	const glm::vec2& p2,
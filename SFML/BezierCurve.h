@@ -15,8 +15,10 @@ public:
 
 	// Bezier calculations
 	void CalculateMulticurveBezierPoints(std::vector<glm::vec2>& finalPoints);
+#ifndef HEADLESS
 	// Draw the bezier curve by drawing lines between the given array of points 
 	void DrawBezierCurve(sf::RenderWindow& window, const std::vector<glm::vec2>& bezierPoints);
+#endif // HEADLESS
 	// Update the points in the curve
 	void UpdateBezierPoints(const std::vector<DeformableParticle*>& deformableParticleList);
 
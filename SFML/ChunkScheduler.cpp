@@ -0,0 +1,109 @@
+#include "ChunkScheduler.h"
+
+// ------------------------------------------------------------------------
+
+ChunkScheduler::ChunkScheduler(unsigned int iChunkSize)
+	: m_iChunkSize(iChunkSize > 0 ? iChunkSize : 1),
+	m_iThreadCount(0),
+	m_bStealing(true)
+{
+	Setup(1);
+}
+
+// ------------------------------------------------------------------------
+
+void ChunkScheduler::Setup(unsigned int iThreadCount)
+{
+	m_iThreadCount = iThreadCount > 0 ? iThreadCount : 1;
+	m_Shares = CacheAlignedVector<Share>(m_iThreadCount);
+
+	for (unsigned int iThread = 0; iThread < m_iThreadCount; iThread++)
+	{
+		m_Shares[iThread].Range.store(Pack(0, 0));
+		m_Shares[iThread].ItemCount = 0;
+	}
+}
+
+// ------------------------------------------------------------------------
+
+void ChunkScheduler::Begin(unsigned int iThread, unsigned int iItemCount)
+{
+	// Contiguous shares keep the chunks of a thread close in memory
+	unsigned long long iChunkCount = GetChunkCount(iItemCount);
+	unsigned int iBegin = (unsigned int)(iChunkCount * iThread / m_iThreadCount);
+	unsigned int iEnd = (unsigned int)(iChunkCount * (iThread + 1) / m_iThreadCount);
+
+	m_Shares[iThread].ItemCount = iItemCount;
+	m_Shares[iThread].Range.store(Pack(iBegin, iEnd), std::memory_order_release);
+}
+
+// ------------------------------------------------------------------------
+
+bool ChunkScheduler::Next(unsigned int iThread, unsigned int& iChunk, unsigned int& iStartIndex, unsigned int& iEndIndex)
+{
+	while (!PopFront(iThread, iChunk))
+	{
+		if (!m_bStealing || !Steal(iThread))
+		{
+			return false;
+		}
+	}
+
+	unsigned int iItemCount = m_Shares[iThread].ItemCount;
+
+	iStartIndex = iChunk * m_iChunkSize;
+	iEndIndex = iStartIndex + m_iChunkSize < iItemCount ? iStartIndex + m_iChunkSize : iItemCount;
+
+	return true;
+}
+
+// ------------------------------------------------------------------------
+
+bool ChunkScheduler::PopFront(unsigned int iThread, unsigned int& iChunk)
+{
+	std::atomic<unsigned long long>& range = m_Shares[iThread].Range;
+	unsigned long long iRange = range.load(std::memory_order_acquire);
+
+	while (RangeBegin(iRange) < RangeEnd(iRange))
+	{
+		// On failure iRange is reloaded with the current value
+		if (range.compare_exchange_weak(iRange, Pack(RangeBegin(iRange) + 1, RangeEnd(iRange))))
+		{
+			iChunk = RangeBegin(iRange);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// ------------------------------------------------------------------------
+
+bool ChunkScheduler::Steal(unsigned int iThread)
+{
+	for (unsigned int i = 1; i < m_iThreadCount; i++)
+	{
+		unsigned int iVictim = (iThread + i) % m_iThreadCount;
+		std::atomic<unsigned long long>& range = m_Shares[iVictim].Range;
+		unsigned long long iRange = range.load(std::memory_order_acquire);
+
+		while (RangeBegin(iRange) < RangeEnd(iRange))
+		{
+			// Take the back half, rounded up so a single chunk can be stolen too
+			unsigned int iBegin = RangeBegin(iRange);
+			unsigned int iEnd = RangeEnd(iRange);
+			unsigned int iSplit = iEnd - (iEnd - iBegin + 1) / 2;
+
+			if (range.compare_exchange_weak(iRange, Pack(iBegin, iSplit)))
+			{
+				// The own share is empty at this point so nobody else is touching it
+				m_Shares[iThread].Range.store(Pack(iSplit, iEnd), std::memory_order_release);
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+// ------------------------------------------------------------------------
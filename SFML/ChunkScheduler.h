@@ -0,0 +1,67 @@
+#ifndef CHUNKSCHEDULER_H
+#define CHUNKSCHEDULER_H
+
+#include <vector>
+#include <atomic>
+
+#include "Common.h"
+#include "AlignedAllocator.h"
+
+// ----------------------------------------------------------------------------
+// Work stealing over fixed size chunks of a range of items. Each thread
+// starts with a contiguous share of the chunks and takes them from the
+// front. Once its share is done it steals half of the remaining chunks from
+// the back of another thread's share, so threads with cheap items help the
+// ones stuck with expensive items.
+//
+// All the threads call Begin at the start of a phase and then Next until it
+// returns false. Consecutive phases must be separated by a barrier.
+//
+// Without stealing every thread processes exactly its own share, so the
+// chunks a thread sees only depend on the thread count. The per-thread
+// accumulations are then reproducible from one run to the next.
+// ----------------------------------------------------------------------------
+
+class ChunkScheduler
+{
+public:
+	explicit ChunkScheduler(unsigned int iChunkSize = 64);
+
+	// Resize for a team of threads. Not thread safe.
+	void Setup(unsigned int iThreadCount);
+
+	// Give the thread its share of the chunks of iItemCount items
+	void Begin(unsigned int iThread, unsigned int iItemCount);
+
+	// Next chunk to process - items [iStartIndex, iEndIndex)
+	bool Next(unsigned int iThread, unsigned int& iChunk, unsigned int& iStartIndex, unsigned int& iEndIndex);
+
+	inline unsigned int GetChunkCount(unsigned int iItemCount) const { return (iItemCount + m_iChunkSize - 1) / m_iChunkSize; }
+	inline unsigned int GetChunkSize() const { return m_iChunkSize; }
+
+	// Stealing is enabled by default
+	inline void SetStealing(bool bStealing) { m_bStealing = bStealing; }
+	inline bool IsStealing() const { return m_bStealing; }
+
+private:
+	// Range of chunks [begin, end) packed into 64 bits so it can be updated with a single CAS
+	struct CACHE_ALIGNED Share
+	{
+		std::atomic<unsigned long long> Range;
+		unsigned int ItemCount;
+	};
+
+	static inline unsigned long long Pack(unsigned int iBegin, unsigned int iEnd) { return ((unsigned long long)iEnd << 32) | iBegin; }
+	static inline unsigned int RangeBegin(unsigned long long iRange) { return (unsigned int)(iRange & 0xffffffff); }
+	static inline unsigned int RangeEnd(unsigned long long iRange) { return (unsigned int)(iRange >> 32); }
+
+	bool PopFront(unsigned int iThread, unsigned int& iChunk);
+	bool Steal(unsigned int iThread);
+
+	unsigned int m_iChunkSize;
+	unsigned int m_iThreadCount;
+	bool m_bStealing;
+	CacheAlignedVector<Share> m_Shares;
+};
+
+#endif // CHUNKSCHEDULER_H
@@ -1,5 +1,28 @@
 #include "Common.h"
 
+#include <algorithm>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <chrono>
+#endif
+
+#ifdef HEADLESS
+
+const sf::Color sf::Color::Black(0, 0, 0);
+const sf::Color sf::Color::White(255, 255, 255);
+const sf::Color sf::Color::Red(255, 0, 0);
+const sf::Color sf::Color::Green(0, 255, 0);
+const sf::Color sf::Color::Blue(0, 0, 255);
+const sf::Color sf::Color::Yellow(255, 255, 0);
+const sf::Color sf::Color::Magenta(255, 0, 255);
+const sf::Color sf::Color::Cyan(0, 255, 255);
+
+#else
+
 void DrawLine(sf::RenderWindow& window,
 	const glm::vec2& p1,
 	const glm::vec2& p2,
@@ -14,7 +37,36 @@ void DrawLine(sf::RenderWindow& window,
 	window.draw(line, 2, sf::Lines);
 }
 
+#endif // HEADLESS
+
 float QuakeLength(const glm::vec2& v)
 {
 	return SquareRootFloat(v.x * v.x + v.y * v.y);
 }
+
+double GetHighResolutionTime()
+{
+#ifdef _WIN32
+	// std::chrono clocks only have millisecond resolution in VS2013
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+double NearestRankPercentile(const std::vector<double>& sortedValues, double fPercentile)
+{
+	if (sortedValues.empty())
+	{
+		return 0.0;
+	}
+
+	unsigned int iRank = (unsigned int)ceil(fPercentile / 100.0 * sortedValues.size());
+	iRank = std::min(std::max(iRank, 1u), (unsigned int)sortedValues.size());
+
+	return sortedValues[iRank - 1];
+}
@@ -1,7 +1,13 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+// HEADLESS builds the simulation without SFML, for machines without a display
+#ifdef HEADLESS
+#include "HeadlessTypes.h"
+#else
 #include <SFML/Graphics.hpp>
+#endif // HEADLESS
+
 #include <math.h>
 
 #include <glm/vec2.hpp>
@@ -19,6 +25,11 @@
 #include <condition_variable>
 #define MULTITHREADING
 
+// Per phase timers (Profiler.h), define NO_PROFILING to compile them out
+#ifndef NO_PROFILING
+#define PROFILING
+#endif // NO_PROFILING
+
 // SSE1
 #include <emmintrin.h>
 
@@ -28,17 +39,29 @@
 // Methods --------------------------------------------------------------------
 // ----------------------------------------------------------------------------
 
+#ifndef HEADLESS
+
 void DrawLine(sf::RenderWindow& window,
 	const glm::vec2& p1,
 	const glm::vec2& p2,
 	const sf::Color& color);
 
+#endif // HEADLESS
+
 // ----------------------------------------------------------------------------
 
 float QuakeLength(const glm::vec2& v);
 
 // ----------------------------------------------------------------------------
 
+// Wall clock time in seconds read from a high resolution counter
+double GetHighResolutionTime();
+
+// Nearest rank percentile (0-100) of values sorted in ascending order, 0 for an empty list
+double NearestRankPercentile(const std::vector<double>& sortedValues, double fPercentile);
+
+// ----------------------------------------------------------------------------
+
 inline int Floor(float f)
 {
 	// SSE1 instructions for float->int
@@ -54,6 +77,50 @@ inline bool IsBetween(const glm::vec2& p1, const glm::vec2& p2, const glm::vec2&
 
 // ----------------------------------------------------------------------------
 
+// Distance from a point to the infinite line going through p1 and p2
+inline float PointToLineDistance(const glm::vec2& point, const glm::vec2& p1, const glm::vec2& p2)
+{
+	float p1p2Length = glm::length(p1 - p2);
+	if (p1p2Length != 0.0f)
+	{
+		return abs((p2.y - p1.y) * point.x - (p2.x - p1.x) * point.y + p2.x * p1.y - p2.y * p1.x) / p1p2Length;
+	}
+	else
+	{
+		return 0.0f;
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+// Projection of a point on the infinite line going through p1 and p2
+// If the line is degenerate the point itself is returned
+inline glm::vec2 ClosestPointOnLine(const glm::vec2& p1, const glm::vec2& p2, const glm::vec2& point)
+{
+	// Find the equation of the line
+	float fA1 = p2.y - p1.y;
+	float fB1 = p1.x - p2.x;
+	float fC1 = p1.x * p2.y - p2.x * p1.y;
+
+	// Find the equation of the perpendicular which goes through the current point
+	float fA2 = fA1;
+	float fB2 = -fB1;
+	float fC2 = fB2 * point.x + fA2 * point.y;
+
+	// Calculate the determinant of the system for the 2 equations
+	float fDet = fA1 * fA1 + fB1 * fB1;
+
+	if (fDet == 0.0f)
+	{
+		return point;
+	}
+
+	// Cramer rule to solve the system
+	return glm::vec2((fA1 * fC1 - fB1 * fC2) / fDet, (fA1 * fC2 + fB1 * fC1) / fDet);
+}
+
+// ----------------------------------------------------------------------------
+
 // http://stackoverflow.com/questions/217578/point-in-polygon-aka-hit-test
 inline bool Intersecting(float start1X, float start1Y, float end1X, float end1Y,
 	float start2X, float start2Y, float end2X, float end2Y)
@@ -109,13 +176,13 @@ inline bool Intersecting(float start1X, float start1Y, float end1X, float end1Y,
 // ----------------------------------------------------------------------------
 
 inline float SquareRootFloat(float number) {
-	long i;
+	int i;
 	float x, y;
 	const float f = 1.5F;
 
 	x = number * 0.5F;
 	y = number;
-	i = *(long *)&y;
+	i = *(int *)&y;
 	i = 0x5f3759df - (i >> 1);
 	y = *(float *)&i;
 	y = y * (f - (x * y * y));
@@ -169,6 +236,11 @@ const float INVERSE_CELL_SIZE	= 1.0f / CELL_SIZE;
 const int CELL_COLS				= Floor(CONTAINER_WIDTH / CELL_SIZE);
 const int CELL_ROWS				= Floor(CONTAINER_HEIGHT / CELL_SIZE);
 const int TOTAL_CELLS			= CELL_COLS * CELL_ROWS;
+// Distance a deformable particle can move before the soft body collision grid is rebuilt
+const float SOFT_BODY_GRID_SKIN	= PARTICLE_RADIUS;
+// Spacing of the samples of the soft body signed distance fields
+const float SIGNED_DISTANCE_CELL_SIZE			= PARTICLE_RADIUS;
+const float INVERSE_SIGNED_DISTANCE_CELL_SIZE	= 1.0f / SIGNED_DISTANCE_CELL_SIZE;
 
 // Fluid limits
 const float WALL_LEFTLIMIT			= HorizontalOffset;
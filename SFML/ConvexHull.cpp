@@ -0,0 +1,156 @@
+#include "ConvexHull.h"
+
+#include <algorithm>
+
+// ------------------------------------------------------------------------
+
+static inline bool IsBefore(const glm::vec2& p1, const glm::vec2& p2)
+{
+	return p1.x < p2.x || (p1.x == p2.x && p1.y < p2.y);
+}
+
+// Positive when o, a, b turn counterclockwise
+static inline float Cross(const glm::vec2& o, const glm::vec2& a, const glm::vec2& b)
+{
+	return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+// ------------------------------------------------------------------------
+
+void ConvexHull::Update(const std::vector<DeformableParticle*>& particleList)
+{
+	unsigned int iParticleCount = particleList.size();
+
+	auto isBefore = [&](unsigned int i1, unsigned int i2)
+	{
+		return IsBefore(particleList[i1]->Position, particleList[i2]->Position);
+	};
+
+	bool bSorted = false;
+
+	if (m_SortedIndices.size() == iParticleCount)
+	{
+		// Insertion sort - the order of the last update is almost right. A body which turned
+		// too much since then is sorted from scratch rather than in quadratic time.
+		unsigned int iMoveCount = 0;
+		unsigned int iMaxMoveCount = 4 * iParticleCount;
+
+		for (unsigned int i = 1; i < iParticleCount && iMoveCount <= iMaxMoveCount; i++)
+		{
+			unsigned int index = m_SortedIndices[i];
+
+			unsigned int j = i;
+			while (j > 0 && isBefore(index, m_SortedIndices[j - 1]))
+			{
+				m_SortedIndices[j] = m_SortedIndices[j - 1];
+				j--;
+			}
+			m_SortedIndices[j] = index;
+
+			iMoveCount += i - j;
+		}
+
+		bSorted = iMoveCount <= iMaxMoveCount;
+	}
+	else
+	{
+		m_SortedIndices.resize(iParticleCount);
+		for (unsigned int index = 0; index < iParticleCount; index++)
+		{
+			m_SortedIndices[index] = index;
+		}
+	}
+
+	if (!bSorted)
+	{
+		std::sort(m_SortedIndices.begin(), m_SortedIndices.end(), isBefore);
+	}
+
+	if (iParticleCount < 3)
+	{
+		m_HullIndices = m_SortedIndices;
+	}
+	else
+	{
+		// Lower chain left to right then upper chain right to left, dropping the vertices which don't
+		// turn counterclockwise. The hull indices are used as the stack of the scan.
+		m_HullIndices.resize(2 * iParticleCount);
+		unsigned int iHullSize = 0;
+
+		for (unsigned int i = 0; i < iParticleCount; i++)
+		{
+			const glm::vec2& position = particleList[m_SortedIndices[i]]->Position;
+
+			while (iHullSize >= 2 && Cross(particleList[m_HullIndices[iHullSize - 2]]->Position,
+				particleList[m_HullIndices[iHullSize - 1]]->Position, position) <= 0.0f)
+			{
+				iHullSize--;
+			}
+			m_HullIndices[iHullSize++] = m_SortedIndices[i];
+		}
+
+		unsigned int iLowerSize = iHullSize + 1;
+		for (int i = (int)iParticleCount - 2; i >= 0; i--)
+		{
+			const glm::vec2& position = particleList[m_SortedIndices[i]]->Position;
+
+			while (iHullSize >= iLowerSize && Cross(particleList[m_HullIndices[iHullSize - 2]]->Position,
+				particleList[m_HullIndices[iHullSize - 1]]->Position, position) <= 0.0f)
+			{
+				iHullSize--;
+			}
+			m_HullIndices[iHullSize++] = m_SortedIndices[i];
+		}
+
+		// The last vertex is the first one again
+		m_HullIndices.resize(iHullSize - 1);
+	}
+
+	// Edges and bounds
+	m_EdgeList.clear();
+
+	if (m_HullIndices.size() >= 2)
+	{
+		for (unsigned int i = 0; i < m_HullIndices.size(); i++)
+		{
+			Edge edge;
+			edge.Start = particleList[m_HullIndices[i]];
+			edge.End = particleList[m_HullIndices[(i + 1) % m_HullIndices.size()]];
+			m_EdgeList.push_back(edge);
+		}
+	}
+
+	// Same bounds as DeformableParticle::IsPointInsidePolygon computes from the edges
+	m_BoundsMin = glm::vec2(std::numeric_limits<float>::max());
+	m_BoundsMax = glm::vec2(std::numeric_limits<float>::lowest());
+
+	for (const Edge& e : m_EdgeList)
+	{
+		m_BoundsMin = glm::min(m_BoundsMin, e.Start->Position);
+		m_BoundsMax = glm::max(m_BoundsMax, e.Start->Position);
+	}
+}
+
+// ------------------------------------------------------------------------
+
+#ifndef HEADLESS
+
+void ConvexHull::Draw(sf::RenderWindow& window)
+{
+	std::vector<sf::Vertex> lines;
+
+	for (const Edge& e : m_EdgeList)
+	{
+		lines.push_back(sf::Vertex(sf::Vector2f(e.Start->Position.x, e.Start->Position.y)));
+		lines.push_back(sf::Vertex(sf::Vector2f(e.End->Position.x, e.End->Position.y)));
+	}
+
+	if (!lines.empty())
+	{
+		window.draw(&lines[0], lines.size(), sf::Lines);
+	}
+}
+
+#endif // HEADLESS
+
+// ------------------------------------------------------------------------
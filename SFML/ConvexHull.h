@@ -0,0 +1,52 @@
+#ifndef CONVEXHULL_H
+#define CONVEXHULL_H
+
+#include <vector>
+#include <limits>
+
+#include "DeformableParticle.h"
+
+// ----------------------------------------------------------------------------
+// Convex hull of the particles of a soft body with Andrew's monotone chain.
+// The particles are kept sorted by position in an array of indices into the
+// particle list which is reused from one update to the next: a body barely
+// moves in a step, so an insertion sort restores the order in close to
+// linear time and the two chains are built in a single pass over it. The
+// particle list itself is never reordered.
+// ----------------------------------------------------------------------------
+
+class ConvexHull
+{
+public:
+	ConvexHull()
+		: m_BoundsMin(std::numeric_limits<float>::max()), m_BoundsMax(std::numeric_limits<float>::lowest()) {};
+
+	// Hull of the current positions of the particles. The sorted order of the previous call
+	// is the starting point as long as the list keeps its size.
+	void Update(const std::vector<DeformableParticle*>& particleList);
+
+#ifndef HEADLESS
+	void Draw(sf::RenderWindow& window);
+#endif // HEADLESS
+
+	// Indices in the particle list of the hull vertices, counterclockwise with y up
+	inline const std::vector<unsigned int>& GetHullIndices() const { return m_HullIndices; }
+
+	// Edges between consecutive vertices, none with fewer than 2 vertices
+	inline std::vector<Edge>& GetEdgeList() { return m_EdgeList; }
+
+	// Axis aligned bounds of the hull when it was built, empty (min > max) without edges
+	inline const glm::vec2& GetBoundsMin() const { return m_BoundsMin; }
+	inline const glm::vec2& GetBoundsMax() const { return m_BoundsMax; }
+
+private:
+	// Particles ordered by x then y
+	std::vector<unsigned int> m_SortedIndices;
+	std::vector<unsigned int> m_HullIndices;
+	std::vector<Edge> m_EdgeList;
+
+	glm::vec2 m_BoundsMin;
+	glm::vec2 m_BoundsMax;
+};
+
+#endif // CONVEXHULL_H
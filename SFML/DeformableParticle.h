@@ -29,12 +29,15 @@ public:
 		// Color
 		m_ControlledColor	= sf::Color::Red;
 		m_DefaultColor		= color;
+#ifndef HEADLESS
 		SetDefaultColor();
 		m_Shape.setOutlineThickness(0.0f);
+#endif // HEADLESS
 
 		// Position
 		OriginalPosition	= position;
 		GoalPosition		= position;
+		CollisionGridPosition = position;
 
 		// Fixed
 		m_bFixed = false;
@@ -46,6 +49,7 @@ public:
 		// Index
 		Index = DeformableParticleGlobalIndex++;
 
+#ifndef HEADLESS
 		// Goal shape properties
 		m_GoalShape.setPosition(sf::Vector2<float>(GoalPosition.x, GoalPosition.y));
 		m_GoalShape.setRadius(PARTICLE_RADIUS);
@@ -54,17 +58,17 @@ public:
 		m_GoalShape.setFillColor(sf::Color::Blue);
 		m_GoalShape.setOrigin(m_GoalShape.getLocalBounds().width / 2.0f,
 			m_GoalShape.getLocalBounds().height / 2.0f);
+#endif // HEADLESS
 	}
 
-	virtual void Update();
+#ifndef HEADLESS
 	void Draw(sf::RenderWindow& window) override;
-	
-	void UpdateGoalShapePosition();
 	void DrawGoalShape(sf::RenderWindow& window);
 
-	float CalculateMinimumTranslationDistance();
-
 	inline void SetControlledColor() { m_Shape.setFillColor(m_ControlledColor); }
+#endif // HEADLESS
+
+	float CalculateMinimumTranslationDistance();
 
 	inline bool IsFixedParticle() { return m_bFixed; }
 	inline void SetFixedParticle(const glm::vec2& pos) 
@@ -85,9 +89,9 @@ public:
 		// Axis aligned bounding box
 		float xMin, yMin, xMax, yMax;;
 		xMin = yMin = std::numeric_limits<float>::max();
-		xMax = yMax = std::numeric_limits<float>::min();
+		xMax = yMax = std::numeric_limits<float>::lowest();
 
-		for each (Edge e in edgeList)
+		for (const Edge& e : edgeList)
 		{
 			float startXEdge = e.Start->Position.x;
 			float endXEdge = e.End->Position.x;
@@ -131,14 +135,21 @@ public:
 			}
 		}
 
+		return IsPointInsidePolygon(point, edgeList, glm::vec2(xMin, yMin), glm::vec2(xMax, yMax));
+	}
+
+	// Same test with the bounds of the polygon already known
+	static bool IsPointInsidePolygon(const glm::vec2& point, const std::vector<Edge>& edgeList,
+		const glm::vec2& boundsMin, const glm::vec2& boundsMax)
+	{
 		// Check against bounding box
-		if (point.x < xMin || point.x > xMax || point.y < yMin || point.y > yMax)
+		if (point.x < boundsMin.x || point.x > boundsMax.x || point.y < boundsMin.y || point.y > boundsMax.y)
 		{
 			return false;
 		}
 
 		// Build ray
-		float xStartRay = xMin - EPS;
+		float xStartRay = boundsMin.x - EPS;
 		float yStartRay = point.y;
 		float xEndRay = point.x;
 		float yEndRay = point.y;
@@ -146,7 +157,7 @@ public:
 		unsigned int intersections = 0;
 
 		// Check each edge for intersection
-		for each (Edge e in edgeList)
+		for (const Edge& e : edgeList)
 		{
 			if (Intersecting(xStartRay, yStartRay, xEndRay, yEndRay,
 				e.Start->Position.x, e.Start->Position.y, e.End->Position.x, e.End->Position.y))
@@ -173,6 +184,9 @@ public:
 	glm::vec2 OriginalPosition;
 	glm::vec2 GoalPosition;
 
+	// Position at the last build of the soft body collision grid, see SpatialPartition
+	glm::vec2 CollisionGridPosition;
+
 private:
 	static int DeformableParticleGlobalIndex;
 
@@ -188,9 +202,9 @@ private:
 	// Color
 	sf::Color m_ControlledColor;
 
+#ifndef HEADLESS
 	sf::CircleShape m_GoalShape;
-
-	glm::vec2 m_vIntersectionPoint;
+#endif // HEADLESS
 };
 
 #endif // DEFORMABLEPARTICLE_H
\ No newline at end of file
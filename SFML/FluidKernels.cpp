@@ -0,0 +1,333 @@
+#include "FluidKernels.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+// ------------------------------------------------------------------------
+// Helpers
+// ------------------------------------------------------------------------
+
+static inline float HorizontalSum(__m128 v)
+{
+	__m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+	__m128 sums = _mm_add_ps(v, shuffled);
+	shuffled = _mm_movehl_ps(shuffled, sums);
+	sums = _mm_add_ss(sums, shuffled);
+	return _mm_cvtss_f32(sums);
+}
+
+// ------------------------------------------------------------------------
+
+// Load the x and y components of up to 4 neighbors into SoA registers.
+// Missing lanes are set to the fill value.
+static inline void GatherVectors(const glm::vec2* pSource, const int* pNeighbors, unsigned int iLanes,
+	const glm::vec2& fill, __m128& x, __m128& y)
+{
+	float xs[4];
+	float ys[4];
+
+	for (unsigned int iLane = 0; iLane < 4; iLane++)
+	{
+		const glm::vec2& value = iLane < iLanes ? pSource[pNeighbors[iLane]] : fill;
+		xs[iLane] = value.x;
+		ys[iLane] = value.y;
+	}
+
+	x = _mm_loadu_ps(xs);
+	y = _mm_loadu_ps(ys);
+}
+
+// ------------------------------------------------------------------------
+// SSE2
+// ------------------------------------------------------------------------
+
+static void DensitySSE2(const FluidKernelParams& params,
+	const glm::vec2& position, const glm::vec2* pPositions,
+	const int* pNeighbors, unsigned int iCount,
+	float* pKernel, glm::vec2* pGradient, DensitySums& sums)
+{
+	const __m128 px = _mm_set1_ps(position.x);
+	const __m128 py = _mm_set1_ps(position.y);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 h = _mm_set1_ps(params.SmoothingDistance);
+	const __m128 h2 = _mm_set1_ps(params.SmoothingDistance2);
+	const __m128 poly6Coeff = _mm_set1_ps(params.Poly6Coeff);
+	const __m128 spikyCoeff = _mm_set1_ps(params.SpikyGradCoeff);
+	const __m128 spikyEps = _mm_set1_ps(0.0001f);
+	const __m128 inverseRestDensity = _mm_set1_ps(params.InverseRestDensity);
+	const glm::vec2 farPosition = position + glm::vec2(2.0f * params.SmoothingDistance, 0.0f);
+
+	__m128 accDensity = zero;
+	__m128 accGradientX = zero;
+	__m128 accGradientY = zero;
+	__m128 accGradientLength2 = zero;
+
+	for (unsigned int i = 0; i < iCount; i += 4)
+	{
+		unsigned int iLanes = iCount - i < 4 ? iCount - i : 4;
+
+		// Missing lanes are placed outside the smoothing distance so they get masked out
+		__m128 nx, ny;
+		GatherVectors(pPositions, pNeighbors + i, iLanes, farPosition, nx, ny);
+
+		__m128 rx = _mm_sub_ps(px, nx);
+		__m128 ry = _mm_sub_ps(py, ny);
+		__m128 rLength = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)));
+
+		// Both kernels are 0 outside the smoothing distance and for coincident particles
+		__m128 mask = _mm_and_ps(_mm_cmple_ps(rLength, h), _mm_cmpneq_ps(rLength, zero));
+
+		// Poly6
+		__m128 poly6Diff = _mm_sub_ps(h2, _mm_mul_ps(rLength, rLength));
+		__m128 kernel = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(poly6Coeff, poly6Diff), poly6Diff), poly6Diff);
+		kernel = _mm_and_ps(mask, kernel);
+
+		// Spiky gradient
+		__m128 spikyDiff = _mm_sub_ps(h, rLength);
+		__m128 scale = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(spikyCoeff, spikyDiff), spikyDiff), _mm_add_ps(rLength, spikyEps));
+		scale = _mm_and_ps(mask, scale);
+		__m128 gx = _mm_mul_ps(scale, rx);
+		__m128 gy = _mm_mul_ps(scale, ry);
+
+		// Pair values - interleave back to x, y pairs
+		__m128 gradientLow = _mm_unpacklo_ps(gx, gy);
+		__m128 gradientHigh = _mm_unpackhi_ps(gx, gy);
+
+		if (iLanes == 4)
+		{
+			_mm_storeu_ps(pKernel + i, kernel);
+			_mm_storeu_ps((float*)(pGradient + i), gradientLow);
+			_mm_storeu_ps((float*)(pGradient + i + 2), gradientHigh);
+		}
+		else
+		{
+			float kernels[4];
+			float gradients[8];
+			_mm_storeu_ps(kernels, kernel);
+			_mm_storeu_ps(gradients, gradientLow);
+			_mm_storeu_ps(gradients + 4, gradientHigh);
+
+			for (unsigned int iLane = 0; iLane < iLanes; iLane++)
+			{
+				pKernel[i + iLane] = kernels[iLane];
+				pGradient[i + iLane] = glm::vec2(gradients[2 * iLane], gradients[2 * iLane + 1]);
+			}
+		}
+
+		// Accumulate
+		accDensity = _mm_add_ps(accDensity, kernel);
+		accGradientX = _mm_add_ps(accGradientX, gx);
+		accGradientY = _mm_add_ps(accGradientY, gy);
+
+		__m128 sgx = _mm_mul_ps(gx, inverseRestDensity);
+		__m128 sgy = _mm_mul_ps(gy, inverseRestDensity);
+		accGradientLength2 = _mm_add_ps(accGradientLength2, _mm_add_ps(_mm_mul_ps(sgx, sgx), _mm_mul_ps(sgy, sgy)));
+	}
+
+	sums.Density = HorizontalSum(accDensity);
+	sums.SelfGradient = glm::vec2(HorizontalSum(accGradientX), HorizontalSum(accGradientY));
+	sums.GradientLength2 = HorizontalSum(accGradientLength2);
+}
+
+// ------------------------------------------------------------------------
+
+static glm::vec2 PositionCorrectionSSE2(const FluidKernelParams& params,
+	float fLambda, const float* pLambdas,
+	const int* pNeighbors, unsigned int iCount,
+	const float* pKernel, const glm::vec2* pGradient)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 lambda = _mm_set1_ps(fLambda);
+	const __m128 inverseArtificialPressure = _mm_set1_ps(params.InverseArtificialPressure);
+	const __m128 artificialPressureScale = _mm_set1_ps(params.ArtificialPressure ? -0.1f : 0.0f);
+
+	__m128 accX = zero;
+	__m128 accY = zero;
+
+	for (unsigned int i = 0; i < iCount; i += 4)
+	{
+		unsigned int iLanes = iCount - i < 4 ? iCount - i : 4;
+
+		__m128 neighborLambda, kernel, gradientLow, gradientHigh;
+
+		if (iLanes == 4)
+		{
+			neighborLambda = _mm_setr_ps(pLambdas[pNeighbors[i]], pLambdas[pNeighbors[i + 1]],
+				pLambdas[pNeighbors[i + 2]], pLambdas[pNeighbors[i + 3]]);
+			kernel = _mm_loadu_ps(pKernel + i);
+			gradientLow = _mm_loadu_ps((const float*)(pGradient + i));
+			gradientHigh = _mm_loadu_ps((const float*)(pGradient + i + 2));
+		}
+		else
+		{
+			// Missing lanes have a zero gradient
+			float lambdas[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			float kernels[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			float gradients[8] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+			for (unsigned int iLane = 0; iLane < iLanes; iLane++)
+			{
+				lambdas[iLane] = pLambdas[pNeighbors[i + iLane]];
+				kernels[iLane] = pKernel[i + iLane];
+				gradients[2 * iLane] = pGradient[i + iLane].x;
+				gradients[2 * iLane + 1] = pGradient[i + iLane].y;
+			}
+
+			neighborLambda = _mm_loadu_ps(lambdas);
+			kernel = _mm_loadu_ps(kernels);
+			gradientLow = _mm_loadu_ps(gradients);
+			gradientHigh = _mm_loadu_ps(gradients + 4);
+		}
+
+		// De-interleave the gradients
+		__m128 gx = _mm_shuffle_ps(gradientLow, gradientHigh, _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 gy = _mm_shuffle_ps(gradientLow, gradientHigh, _MM_SHUFFLE(3, 1, 3, 1));
+
+		// Artificial pressure -0.1 * (W / W(dq))^4
+		__m128 ratio = _mm_mul_ps(kernel, inverseArtificialPressure);
+		__m128 ratio2 = _mm_mul_ps(ratio, ratio);
+		__m128 artificialPressure = _mm_mul_ps(artificialPressureScale, _mm_mul_ps(ratio2, ratio2));
+
+		__m128 factor = _mm_add_ps(_mm_add_ps(lambda, neighborLambda), artificialPressure);
+
+		accX = _mm_add_ps(accX, _mm_mul_ps(gx, factor));
+		accY = _mm_add_ps(accY, _mm_mul_ps(gy, factor));
+	}
+
+	return glm::vec2(HorizontalSum(accX), HorizontalSum(accY));
+}
+
+// ------------------------------------------------------------------------
+
+static glm::vec2 XSPHViscositySSE2(const FluidKernelParams& params,
+	const glm::vec2& position, const glm::vec2& velocity,
+	const glm::vec2* pPositions, const glm::vec2* pVelocities,
+	const int* pNeighbors, unsigned int iCount)
+{
+	const __m128 px = _mm_set1_ps(position.x);
+	const __m128 py = _mm_set1_ps(position.y);
+	const __m128 vx = _mm_set1_ps(velocity.x);
+	const __m128 vy = _mm_set1_ps(velocity.y);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 h = _mm_set1_ps(params.SmoothingDistance);
+	const __m128 h2 = _mm_set1_ps(params.SmoothingDistance2);
+	const __m128 poly6Coeff = _mm_set1_ps(params.Poly6Coeff);
+	const glm::vec2 farPosition = position + glm::vec2(2.0f * params.SmoothingDistance, 0.0f);
+
+	__m128 accX = zero;
+	__m128 accY = zero;
+
+	for (unsigned int i = 0; i < iCount; i += 4)
+	{
+		unsigned int iLanes = iCount - i < 4 ? iCount - i : 4;
+
+		// Missing lanes are placed outside the smoothing distance so they get masked out
+		__m128 nx, ny;
+		GatherVectors(pPositions, pNeighbors + i, iLanes, farPosition, nx, ny);
+
+		__m128 nvx, nvy;
+		GatherVectors(pVelocities, pNeighbors + i, iLanes, velocity, nvx, nvy);
+
+		__m128 rx = _mm_sub_ps(px, nx);
+		__m128 ry = _mm_sub_ps(py, ny);
+		__m128 rLength = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)));
+
+		__m128 mask = _mm_and_ps(_mm_cmple_ps(rLength, h), _mm_cmpneq_ps(rLength, zero));
+
+		__m128 poly6Diff = _mm_sub_ps(h2, _mm_mul_ps(rLength, rLength));
+		__m128 kernel = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(poly6Coeff, poly6Diff), poly6Diff), poly6Diff);
+		kernel = _mm_and_ps(mask, kernel);
+
+		accX = _mm_add_ps(accX, _mm_mul_ps(kernel, _mm_sub_ps(vx, nvx)));
+		accY = _mm_add_ps(accY, _mm_mul_ps(kernel, _mm_sub_ps(vy, nvy)));
+	}
+
+	return glm::vec2(HorizontalSum(accX), HorizontalSum(accY));
+}
+
+// ------------------------------------------------------------------------
+// Runtime selection
+// ------------------------------------------------------------------------
+
+bool IsAVX2Supported()
+{
+	int info[4] = { 0, 0, 0, 0 };
+
+#ifdef _MSC_VER
+	__cpuid(info, 0);
+	if (info[0] < 7)
+	{
+		return false;
+	}
+
+	__cpuid(info, 1);
+	bool bOSXSave = (info[2] & (1 << 27)) != 0;
+	bool bFMA = (info[2] & (1 << 12)) != 0;
+
+	__cpuidex(info, 7, 0);
+	bool bAVX2 = (info[1] & (1 << 5)) != 0;
+
+	// The OS has to save the YMM registers on context switches
+	bool bYMMState = bOSXSave && (_xgetbv(0) & 0x6) == 0x6;
+#else
+	unsigned int eax, ebx, ecx, edx;
+	if (__get_cpuid_max(0, nullptr) < 7)
+	{
+		return false;
+	}
+
+	__cpuid(1, eax, ebx, ecx, edx);
+	bool bOSXSave = (ecx & (1 << 27)) != 0;
+	bool bFMA = (ecx & (1 << 12)) != 0;
+
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	bool bAVX2 = (ebx & (1 << 5)) != 0;
+
+	// The OS has to save the YMM registers on context switches
+	bool bYMMState = false;
+	if (bOSXSave)
+	{
+		unsigned int xcr0Low, xcr0High;
+		__asm__ volatile("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+		bYMMState = (xcr0Low & 0x6) == 0x6;
+	}
+	(void)info;
+#endif
+
+	return bAVX2 && bFMA && bYMMState;
+}
+
+// ------------------------------------------------------------------------
+
+const FluidKernelSet& GetSSE2FluidKernels()
+{
+	static const FluidKernelSet kernels =
+	{
+		"SSE2",
+		4,
+		DensitySSE2,
+		PositionCorrectionSSE2,
+		XSPHViscositySSE2
+	};
+
+	return kernels;
+}
+
+// ------------------------------------------------------------------------
+
+const FluidKernelSet& GetFluidKernels()
+{
+	static const FluidKernelSet* pKernels = nullptr;
+
+	if (pKernels == nullptr)
+	{
+		pKernels = IsAVX2Supported() ? &GetAVX2FluidKernels() : &GetSSE2FluidKernels();
+	}
+
+	return *pKernels;
+}
+
+// ------------------------------------------------------------------------
@@ -0,0 +1,70 @@
+#ifndef FLUIDKERNELS_H
+#define FLUIDKERNELS_H
+
+#include "Common.h"
+
+// ----------------------------------------------------------------------------
+// Batch SPH kernels. A particle is evaluated against 4 (SSE2) or 8 (AVX2)
+// neighbors at once: the neighbor positions are gathered from the particle
+// arrays into SoA registers and the smoothing distance test is applied as a
+// lane mask instead of a branch. The best implementation supported by the
+// CPU is selected at runtime.
+// ----------------------------------------------------------------------------
+
+// Constants shared by all the kernels
+struct FluidKernelParams
+{
+	float SmoothingDistance;
+	float SmoothingDistance2;
+	float Poly6Coeff;
+	float SpikyGradCoeff;
+	float InverseRestDensity;
+	float InverseArtificialPressure;
+	bool ArtificialPressure;
+};
+
+// Sums accumulated by the density pass
+struct DensitySums
+{
+	float Density;				// sum of poly6(pi, pj)
+	glm::vec2 SelfGradient;		// sum of spiky gradients (pi, pj)
+	float GradientLength2;		// sum of |spiky gradient / rest density|^2
+};
+
+// Density pass: poly6 value and spiky gradient of each pair are written to pKernel/pGradient
+typedef void (*DensityBatchFn)(const FluidKernelParams& params,
+	const glm::vec2& position, const glm::vec2* pPositions,
+	const int* pNeighbors, unsigned int iCount,
+	float* pKernel, glm::vec2* pGradient, DensitySums& sums);
+
+// Position correction: sum of gradient * (lambda + lambda_j + artificial pressure) using the pair values of the density pass
+typedef glm::vec2 (*PositionCorrectionBatchFn)(const FluidKernelParams& params,
+	float fLambda, const float* pLambdas,
+	const int* pNeighbors, unsigned int iCount,
+	const float* pKernel, const glm::vec2* pGradient);
+
+// XSPH viscosity: sum of poly6(pi, pj) * (vi - vj)
+typedef glm::vec2 (*XSPHBatchFn)(const FluidKernelParams& params,
+	const glm::vec2& position, const glm::vec2& velocity,
+	const glm::vec2* pPositions, const glm::vec2* pVelocities,
+	const int* pNeighbors, unsigned int iCount);
+
+struct FluidKernelSet
+{
+	const char* Name;
+	unsigned int Width;
+
+	DensityBatchFn Density;
+	PositionCorrectionBatchFn PositionCorrection;
+	XSPHBatchFn XSPHViscosity;
+};
+
+// Best kernel set supported by the CPU. Call once from the main thread, the result does not change.
+const FluidKernelSet& GetFluidKernels();
+
+const FluidKernelSet& GetSSE2FluidKernels();
+const FluidKernelSet& GetAVX2FluidKernels();
+
+bool IsAVX2Supported();
+
+#endif // FLUIDKERNELS_H
@@ -0,0 +1,275 @@
+#include "FluidKernels.h"
+
+#include <immintrin.h>
+
+// ----------------------------------------------------------------------------
+// AVX2 + FMA kernels. This file is the only one compiled with AVX2 enabled,
+// the functions are only called when IsAVX2Supported() returns true.
+// ----------------------------------------------------------------------------
+
+static inline float HorizontalSum(__m256 v)
+{
+	__m128 sums = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	__m128 shuffled = _mm_movehdup_ps(sums);
+	sums = _mm_add_ps(sums, shuffled);
+	shuffled = _mm_movehl_ps(shuffled, sums);
+	sums = _mm_add_ss(sums, shuffled);
+	return _mm_cvtss_f32(sums);
+}
+
+// ------------------------------------------------------------------------
+
+// Lane mask for the first iLanes lanes
+static inline __m256i LaneMask(unsigned int iLanes)
+{
+	return _mm256_cmpgt_epi32(_mm256_set1_epi32((int)iLanes), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+// ------------------------------------------------------------------------
+
+// Gather the x and y components of 8 neighbors into SoA registers.
+// Lanes outside laneMask are set to the fill value.
+static inline void GatherVectors(const glm::vec2* pSource, __m256i neighbors, __m256i laneMask,
+	const glm::vec2& fill, __m256& x, __m256& y)
+{
+	const float* pBase = (const float*)pSource;
+	__m256i xIndex = _mm256_add_epi32(neighbors, neighbors);
+	__m256i yIndex = _mm256_add_epi32(xIndex, _mm256_set1_epi32(1));
+	__m256 mask = _mm256_castsi256_ps(laneMask);
+
+	x = _mm256_mask_i32gather_ps(_mm256_set1_ps(fill.x), pBase, xIndex, mask, 4);
+	y = _mm256_mask_i32gather_ps(_mm256_set1_ps(fill.y), pBase, yIndex, mask, 4);
+}
+
+// ------------------------------------------------------------------------
+
+static void DensityAVX2(const FluidKernelParams& params,
+	const glm::vec2& position, const glm::vec2* pPositions,
+	const int* pNeighbors, unsigned int iCount,
+	float* pKernel, glm::vec2* pGradient, DensitySums& sums)
+{
+	const __m256 px = _mm256_set1_ps(position.x);
+	const __m256 py = _mm256_set1_ps(position.y);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 h = _mm256_set1_ps(params.SmoothingDistance);
+	const __m256 h2 = _mm256_set1_ps(params.SmoothingDistance2);
+	const __m256 poly6Coeff = _mm256_set1_ps(params.Poly6Coeff);
+	const __m256 spikyCoeff = _mm256_set1_ps(params.SpikyGradCoeff);
+	const __m256 spikyEps = _mm256_set1_ps(0.0001f);
+	const __m256 inverseRestDensity = _mm256_set1_ps(params.InverseRestDensity);
+	const glm::vec2 farPosition = position + glm::vec2(2.0f * params.SmoothingDistance, 0.0f);
+
+	__m256 accDensity = zero;
+	__m256 accGradientX = zero;
+	__m256 accGradientY = zero;
+	__m256 accGradientLength2 = zero;
+
+	for (unsigned int i = 0; i < iCount; i += 8)
+	{
+		unsigned int iLanes = iCount - i < 8 ? iCount - i : 8;
+		__m256i laneMask = LaneMask(iLanes);
+		__m256i neighbors = _mm256_maskload_epi32(pNeighbors + i, laneMask);
+
+		// Missing lanes are placed outside the smoothing distance so they get masked out
+		__m256 nx, ny;
+		GatherVectors(pPositions, neighbors, laneMask, farPosition, nx, ny);
+
+		__m256 rx = _mm256_sub_ps(px, nx);
+		__m256 ry = _mm256_sub_ps(py, ny);
+		__m256 rLength2 = _mm256_fmadd_ps(rx, rx, _mm256_mul_ps(ry, ry));
+		__m256 rLength = _mm256_sqrt_ps(rLength2);
+
+		// Both kernels are 0 outside the smoothing distance and for coincident particles
+		__m256 mask = _mm256_and_ps(_mm256_cmp_ps(rLength, h, _CMP_LE_OQ), _mm256_cmp_ps(rLength, zero, _CMP_NEQ_UQ));
+
+		// Poly6
+		__m256 poly6Diff = _mm256_sub_ps(h2, _mm256_mul_ps(rLength, rLength));
+		__m256 kernel = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(poly6Coeff, poly6Diff), poly6Diff), poly6Diff);
+		kernel = _mm256_and_ps(mask, kernel);
+
+		// Spiky gradient
+		__m256 spikyDiff = _mm256_sub_ps(h, rLength);
+		__m256 scale = _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(spikyCoeff, spikyDiff), spikyDiff), _mm256_add_ps(rLength, spikyEps));
+		scale = _mm256_and_ps(mask, scale);
+		__m256 gx = _mm256_mul_ps(scale, rx);
+		__m256 gy = _mm256_mul_ps(scale, ry);
+
+		// Pair values - interleave back to x, y pairs. unpack works per 128 bit half
+		// so the halves are swapped into place afterwards.
+		__m256 unpackLow = _mm256_unpacklo_ps(gx, gy);
+		__m256 unpackHigh = _mm256_unpackhi_ps(gx, gy);
+		__m256 gradientLow = _mm256_permute2f128_ps(unpackLow, unpackHigh, 0x20);
+		__m256 gradientHigh = _mm256_permute2f128_ps(unpackLow, unpackHigh, 0x31);
+
+		if (iLanes == 8)
+		{
+			_mm256_storeu_ps(pKernel + i, kernel);
+			_mm256_storeu_ps((float*)(pGradient + i), gradientLow);
+			_mm256_storeu_ps((float*)(pGradient + i + 4), gradientHigh);
+		}
+		else
+		{
+			float kernels[8];
+			float gradients[16];
+			_mm256_storeu_ps(kernels, kernel);
+			_mm256_storeu_ps(gradients, gradientLow);
+			_mm256_storeu_ps(gradients + 8, gradientHigh);
+
+			for (unsigned int iLane = 0; iLane < iLanes; iLane++)
+			{
+				pKernel[i + iLane] = kernels[iLane];
+				pGradient[i + iLane] = glm::vec2(gradients[2 * iLane], gradients[2 * iLane + 1]);
+			}
+		}
+
+		// Accumulate
+		accDensity = _mm256_add_ps(accDensity, kernel);
+		accGradientX = _mm256_add_ps(accGradientX, gx);
+		accGradientY = _mm256_add_ps(accGradientY, gy);
+
+		__m256 sgx = _mm256_mul_ps(gx, inverseRestDensity);
+		__m256 sgy = _mm256_mul_ps(gy, inverseRestDensity);
+		accGradientLength2 = _mm256_fmadd_ps(sgx, sgx, _mm256_fmadd_ps(sgy, sgy, accGradientLength2));
+	}
+
+	sums.Density = HorizontalSum(accDensity);
+	sums.SelfGradient = glm::vec2(HorizontalSum(accGradientX), HorizontalSum(accGradientY));
+	sums.GradientLength2 = HorizontalSum(accGradientLength2);
+}
+
+// ------------------------------------------------------------------------
+
+static glm::vec2 PositionCorrectionAVX2(const FluidKernelParams& params,
+	float fLambda, const float* pLambdas,
+	const int* pNeighbors, unsigned int iCount,
+	const float* pKernel, const glm::vec2* pGradient)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 lambda = _mm256_set1_ps(fLambda);
+	const __m256 inverseArtificialPressure = _mm256_set1_ps(params.InverseArtificialPressure);
+	const __m256 artificialPressureScale = _mm256_set1_ps(params.ArtificialPressure ? -0.1f : 0.0f);
+
+	__m256 accX = zero;
+	__m256 accY = zero;
+
+	for (unsigned int i = 0; i < iCount; i += 8)
+	{
+		unsigned int iLanes = iCount - i < 8 ? iCount - i : 8;
+		__m256i laneMask = LaneMask(iLanes);
+		__m256i neighbors = _mm256_maskload_epi32(pNeighbors + i, laneMask);
+
+		// Missing lanes have a zero gradient
+		__m256 neighborLambda = _mm256_mask_i32gather_ps(zero, pLambdas, neighbors, _mm256_castsi256_ps(laneMask), 4);
+		__m256 kernel;
+		__m256 gradientLow;
+		__m256 gradientHigh;
+
+		if (iLanes == 8)
+		{
+			kernel = _mm256_loadu_ps(pKernel + i);
+			gradientLow = _mm256_loadu_ps((const float*)(pGradient + i));
+			gradientHigh = _mm256_loadu_ps((const float*)(pGradient + i + 4));
+		}
+		else
+		{
+			kernel = _mm256_maskload_ps(pKernel + i, laneMask);
+
+			float gradients[16] = { 0.0f };
+			for (unsigned int iLane = 0; iLane < iLanes; iLane++)
+			{
+				gradients[2 * iLane] = pGradient[i + iLane].x;
+				gradients[2 * iLane + 1] = pGradient[i + iLane].y;
+			}
+
+			gradientLow = _mm256_loadu_ps(gradients);
+			gradientHigh = _mm256_loadu_ps(gradients + 8);
+		}
+
+		// De-interleave the gradients. shuffle works per 128 bit half and leaves
+		// the pairs in the order 0 1 4 5 2 3 6 7 which the permute fixes.
+		__m256 gx = _mm256_shuffle_ps(gradientLow, gradientHigh, _MM_SHUFFLE(2, 0, 2, 0));
+		__m256 gy = _mm256_shuffle_ps(gradientLow, gradientHigh, _MM_SHUFFLE(3, 1, 3, 1));
+		gx = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(gx), _MM_SHUFFLE(3, 1, 2, 0)));
+		gy = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(gy), _MM_SHUFFLE(3, 1, 2, 0)));
+
+		// Artificial pressure -0.1 * (W / W(dq))^4
+		__m256 ratio = _mm256_mul_ps(kernel, inverseArtificialPressure);
+		__m256 ratio2 = _mm256_mul_ps(ratio, ratio);
+		__m256 artificialPressure = _mm256_mul_ps(artificialPressureScale, _mm256_mul_ps(ratio2, ratio2));
+
+		__m256 factor = _mm256_add_ps(_mm256_add_ps(lambda, neighborLambda), artificialPressure);
+
+		accX = _mm256_fmadd_ps(gx, factor, accX);
+		accY = _mm256_fmadd_ps(gy, factor, accY);
+	}
+
+	return glm::vec2(HorizontalSum(accX), HorizontalSum(accY));
+}
+
+// ------------------------------------------------------------------------
+
+static glm::vec2 XSPHViscosityAVX2(const FluidKernelParams& params,
+	const glm::vec2& position, const glm::vec2& velocity,
+	const glm::vec2* pPositions, const glm::vec2* pVelocities,
+	const int* pNeighbors, unsigned int iCount)
+{
+	const __m256 px = _mm256_set1_ps(position.x);
+	const __m256 py = _mm256_set1_ps(position.y);
+	const __m256 vx = _mm256_set1_ps(velocity.x);
+	const __m256 vy = _mm256_set1_ps(velocity.y);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 h = _mm256_set1_ps(params.SmoothingDistance);
+	const __m256 h2 = _mm256_set1_ps(params.SmoothingDistance2);
+	const __m256 poly6Coeff = _mm256_set1_ps(params.Poly6Coeff);
+	const glm::vec2 farPosition = position + glm::vec2(2.0f * params.SmoothingDistance, 0.0f);
+
+	__m256 accX = zero;
+	__m256 accY = zero;
+
+	for (unsigned int i = 0; i < iCount; i += 8)
+	{
+		unsigned int iLanes = iCount - i < 8 ? iCount - i : 8;
+		__m256i laneMask = LaneMask(iLanes);
+		__m256i neighbors = _mm256_maskload_epi32(pNeighbors + i, laneMask);
+
+		// Missing lanes are placed outside the smoothing distance so they get masked out
+		__m256 nx, ny;
+		GatherVectors(pPositions, neighbors, laneMask, farPosition, nx, ny);
+
+		__m256 nvx, nvy;
+		GatherVectors(pVelocities, neighbors, laneMask, velocity, nvx, nvy);
+
+		__m256 rx = _mm256_sub_ps(px, nx);
+		__m256 ry = _mm256_sub_ps(py, ny);
+		__m256 rLength = _mm256_sqrt_ps(_mm256_fmadd_ps(rx, rx, _mm256_mul_ps(ry, ry)));
+
+		__m256 mask = _mm256_and_ps(_mm256_cmp_ps(rLength, h, _CMP_LE_OQ), _mm256_cmp_ps(rLength, zero, _CMP_NEQ_UQ));
+
+		__m256 poly6Diff = _mm256_sub_ps(h2, _mm256_mul_ps(rLength, rLength));
+		__m256 kernel = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(poly6Coeff, poly6Diff), poly6Diff), poly6Diff);
+		kernel = _mm256_and_ps(mask, kernel);
+
+		accX = _mm256_fmadd_ps(kernel, _mm256_sub_ps(vx, nvx), accX);
+		accY = _mm256_fmadd_ps(kernel, _mm256_sub_ps(vy, nvy), accY);
+	}
+
+	return glm::vec2(HorizontalSum(accX), HorizontalSum(accY));
+}
+
+// ------------------------------------------------------------------------
+
+const FluidKernelSet& GetAVX2FluidKernels()
+{
+	static const FluidKernelSet kernels =
+	{
+		"AVX2",
+		8,
+		DensityAVX2,
+		PositionCorrectionAVX2,
+		XSPHViscosityAVX2
+	};
+
+	return kernels;
+}
+
+// ------------------------------------------------------------------------
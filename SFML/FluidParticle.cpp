@@ -1,58 +1,39 @@
 #include "FluidParticle.h"
 #include "SimulationManager.h"
 #include "SoftBody.h"
-
-int FluidParticle::FluidParticleGlobalIndex = 0;
+#include "SpatialPartition.h"
 
 float FluidParticle::CalculateMinimumTranslationDistance()
 {
-	float fMinDistance = 0.0f;
+	const glm::vec2& position = Position();
 
-	SignedDistance = 0.0f;
+	float fSignedDistance = 0.0f;
+	glm::vec2 gradientSignedDistance = glm::vec2(0.0f);
 
 	std::vector<SoftBody*>& softBodyList = SimulationManager::GetInstance().GetSoftBodySimulationList();
 
-	for each (SoftBody* pSoftBody in softBodyList)
+	// Only the hulls whose bounds overlap the cell of the particle can contain it
+	const SpatialPartition& spatialPartition = SpatialPartition::GetInstance();
+	const int* pHullEntries = spatialPartition.GetHullEntries();
+	glm::vec2 localOffset(WALL_LEFTLIMIT, WALL_TOPLIMIT);
+	int iCell = SpatialPartition::ComputeCellID(position - localOffset);
+
+	for (unsigned int iEntry = spatialPartition.GetHullCellStart(iCell); iEntry < spatialPartition.GetHullCellEnd(iCell); iEntry++)
 	{
-		// Get the edge list
-		std::vector<Edge>& edgeList = pSoftBody->GetConvexHull().GetEdgeList();
+		float fDistance;
+		glm::vec2 gradient;
 
-		// Particle is inside the convex hull => push it outside
-		if (DeformableParticle::IsPointInsidePolygon(Position, edgeList))
+		// Particle is inside the soft body => push it out of the deepest one
+		if (softBodyList[pHullEntries[iEntry]]->GetSignedDistanceField().Sample(position, fDistance, gradient) &&
+			fDistance > fSignedDistance)
 		{
-			fMinDistance = std::numeric_limits<float>::max();
-
-			// Get the closest edge
-			for (unsigned int i = 0; i < edgeList.size(); i++)
-			{
-				float fDistanceToEdge = DistanceToLine(edgeList[i].Start->Position, edgeList[i].End->Position);
-
-				if (fDistanceToEdge < fMinDistance)
-				{
-					glm::vec2 point = ClosestPointToPointOnLine(edgeList[i].Start->Position, edgeList[i].End->Position, Position);
-
-					// Signed distance
-					SignedDistance = fDistanceToEdge;
-					m_vIntersectionPoint = point;
-				}
-			}
+			fSignedDistance = fDistance;
+			gradientSignedDistance = gradient;
 		}
 	}
 
-	if (m_vIntersectionPoint != glm::vec2(0.0f))
-	{
-		glm::vec2 intersectionToPosition = m_vIntersectionPoint - Position;
-		GradientSignedDistance = glm::normalize(intersectionToPosition);
-	}
-	else
-	{
-		GradientSignedDistance = glm::vec2(0.0f);
-	}
-
-	return SignedDistance;
-}
+	SignedDistance() = fSignedDistance;
+	GradientSignedDistance() = gradientSignedDistance;
 
-void FluidParticle::Draw(sf::RenderWindow& window)
-{
-	BaseParticle::Draw(window);
+	return fSignedDistance;
 }
@@ -1,58 +1,51 @@
 #ifndef FLUIDPARTICLE_H
 #define FLUIDPARTICLE_H
 
-#include "BaseParticle.h"
-#include "ParticleManager.h"
-#include "DeformableParticle.h"
+#include "Common.h"
+#include "FluidParticleStore.h"
 
-class FluidSimulation;
+// ----------------------------------------------------------------------------
+// Handle to a single particle inside a FluidParticleStore. The particle state
+// is owned by the store, the handle only keeps the store and the index.
+// ----------------------------------------------------------------------------
 
-class FluidParticle : public BaseParticle
+class FluidParticle
 {
 public:
-	FluidParticle(const glm::vec2& position, const sf::Color& color, unsigned int iParentIndex)
-		: BaseParticle(position, iParentIndex)
+	FluidParticle(FluidParticleStore& store, unsigned int iIndex)
+		: Index(iIndex), m_Store(store)
 	{
-		// Index
-		Index = FluidParticleGlobalIndex++;
+	}
 
-		// Color
-		m_DefaultColor = color;
-		SetDefaultColor();
-		m_Shape.setOutlineThickness(0.0f);
+	float CalculateMinimumTranslationDistance();
 
-		PredictedPosition	= Position;
+	// ------------------------------------------------------------------------
+	// Accessors
+	// ------------------------------------------------------------------------
 
-		Velocity = glm::vec2(0.0f, 0.0f);
+	inline glm::vec2& Position()				{ return m_Store.Position[Index]; }
+	inline glm::vec2& PredictedPosition()		{ return m_Store.PredictedPosition[Index]; }
+	inline glm::vec2& Velocity()				{ return m_Store.Velocity[Index]; }
+	inline glm::vec2& PositionCorrection()		{ return m_Store.PositionCorrection[Index]; }
 
-		// Fluid properties
-		DensityConstraint	= 0.0f;
-		SPHDensity			= 0.0f;
-		Lambda				= 0.0f;
+	inline float& SPHDensity()					{ return m_Store.SPHDensity[Index]; }
+	inline float& DensityConstraint()			{ return m_Store.DensityConstraint[Index]; }
+	inline float& Lambda()						{ return m_Store.Lambda[Index]; }
 
-		// Particle type
-		ParticleType = ParticleType::FluidParticle;
-	}
+	inline float& SignedDistance()				{ return m_Store.SignedDistance[Index]; }
+	inline glm::vec2& GradientSignedDistance()	{ return m_Store.GradientSignedDistance[Index]; }
 
-	void Draw(sf::RenderWindow& window) override;
-
-	float CalculateMinimumTranslationDistance();
+	inline CellIDList& GetCellIDsList()			{ return m_Store.CellIDs[Index]; }
 
 	// ------------------------------------------------------------------------
 	// Public members
 	// ------------------------------------------------------------------------
 
-	float SPHDensity;
-	float DensityConstraint;
-	float Lambda;
+	// Particle index within the store
+	const unsigned int Index;
 
 private:
-	static int FluidParticleGlobalIndex;
-
-	glm::vec2 m_ClosesPoint;
-
-	Edge m_ClosestEdge;
-	glm::vec2 m_vIntersectionPoint;
+	FluidParticleStore& m_Store;
 };
 
-#endif // FLUIDPARTICLE_H
\ No newline at end of file
+#endif // FLUIDPARTICLE_H
@@ -0,0 +1,117 @@
+#include "FluidParticleStore.h"
+
+// ------------------------------------------------------------------------
+
+unsigned int FluidParticleStore::AddParticle(const glm::vec2& position, const sf::Color& color)
+{
+	unsigned int iIndex = Size();
+
+	Position.push_back(position);
+	PredictedPosition.push_back(position);
+	Velocity.push_back(glm::vec2(0.0f));
+	PositionCorrection.push_back(glm::vec2(0.0f));
+
+	SPHDensity.push_back(0.0f);
+	DensityConstraint.push_back(0.0f);
+	Lambda.push_back(0.0f);
+
+	SignedDistance.push_back(0.0f);
+	GradientSignedDistance.push_back(glm::vec2(0.0f));
+
+	CellIDs.push_back(CellIDList());
+	NeighborListPosition.push_back(position);
+
+	Color.push_back(color);
+
+	return iIndex;
+}
+
+// ------------------------------------------------------------------------
+
+void FluidParticleStore::Reserve(unsigned int iCapacity)
+{
+	Position.reserve(iCapacity);
+	PredictedPosition.reserve(iCapacity);
+	Velocity.reserve(iCapacity);
+	PositionCorrection.reserve(iCapacity);
+
+	SPHDensity.reserve(iCapacity);
+	DensityConstraint.reserve(iCapacity);
+	Lambda.reserve(iCapacity);
+
+	SignedDistance.reserve(iCapacity);
+	GradientSignedDistance.reserve(iCapacity);
+
+	CellIDs.reserve(iCapacity);
+	NeighborListPosition.reserve(iCapacity);
+
+	Color.reserve(iCapacity);
+}
+
+// ------------------------------------------------------------------------
+
+void FluidParticleStore::Clear()
+{
+	Position.clear();
+	PredictedPosition.clear();
+	Velocity.clear();
+	PositionCorrection.clear();
+
+	SPHDensity.clear();
+	DensityConstraint.clear();
+	Lambda.clear();
+
+	SignedDistance.clear();
+	GradientSignedDistance.clear();
+
+	CellIDs.clear();
+	NeighborListPosition.clear();
+
+	Color.clear();
+}
+
+// ------------------------------------------------------------------------
+
+void FluidParticleStore::CopyFrom(const FluidParticleStore& other)
+{
+	Position = other.Position;
+	PredictedPosition = other.PredictedPosition;
+	Velocity = other.Velocity;
+	PositionCorrection = other.PositionCorrection;
+
+	SPHDensity = other.SPHDensity;
+	DensityConstraint = other.DensityConstraint;
+	Lambda = other.Lambda;
+
+	SignedDistance = other.SignedDistance;
+	GradientSignedDistance = other.GradientSignedDistance;
+
+	CellIDs = other.CellIDs;
+	NeighborListPosition = other.NeighborListPosition;
+
+	Color = other.Color;
+}
+
+// ------------------------------------------------------------------------
+
+void FluidParticleStore::Reorder(const std::vector<unsigned int>& newToOld)
+{
+	Permute(Position, newToOld);
+	Permute(PredictedPosition, newToOld);
+	Permute(Velocity, newToOld);
+	Permute(PositionCorrection, newToOld);
+
+	Permute(SPHDensity, newToOld);
+	Permute(DensityConstraint, newToOld);
+	Permute(Lambda, newToOld);
+
+	Permute(SignedDistance, newToOld);
+	Permute(GradientSignedDistance, newToOld);
+
+	Permute(CellIDs, newToOld);
+	Permute(NeighborListPosition, newToOld);
+
+	Permute(Color, newToOld);
+}
+
+// ------------------------------------------------------------------------
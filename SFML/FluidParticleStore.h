@@ -0,0 +1,81 @@
+#ifndef FLUIDPARTICLESTORE_H
+#define FLUIDPARTICLESTORE_H
+
+#include "Common.h"
+#include "AlignedAllocator.h"
+#include "UniformGrid.h"
+
+// ----------------------------------------------------------------------------
+// Structure-of-arrays storage for the fluid particles of a simulation. Every
+// per-particle property lives in its own contiguous array indexed by the
+// particle index so the solver passes only stream the data they touch.
+// ----------------------------------------------------------------------------
+
+class FluidParticleStore
+{
+public:
+
+	FluidParticleStore() {}
+
+	unsigned int AddParticle(const glm::vec2& position, const sf::Color& color);
+	void Reserve(unsigned int iCapacity);
+	void Clear();
+
+	// Explicit copy of all the per-particle arrays, used to snapshot and restore a simulation
+	void CopyFrom(const FluidParticleStore& other);
+
+	inline unsigned int Size() const { return Position.size(); }
+
+	// Permute all the per-particle arrays so that the new particle i is the old particle newToOld[i]
+	void Reorder(const std::vector<unsigned int>& newToOld);
+
+	// ------------------------------------------------------------------------
+	// Solver state - hot
+	// ------------------------------------------------------------------------
+
+	AlignedVector<glm::vec2> Position;
+	AlignedVector<glm::vec2> PredictedPosition;
+	AlignedVector<glm::vec2> Velocity;
+	AlignedVector<glm::vec2> PositionCorrection;
+
+	AlignedVector<float> SPHDensity;
+	AlignedVector<float> DensityConstraint;
+	AlignedVector<float> Lambda;
+
+	// ------------------------------------------------------------------------
+	// Soft body interaction
+	// ------------------------------------------------------------------------
+
+	AlignedVector<float> SignedDistance;
+	AlignedVector<glm::vec2> GradientSignedDistance;
+
+	// ------------------------------------------------------------------------
+	// Neighborhood and rendering - cold
+	// ------------------------------------------------------------------------
+
+	std::vector<CellIDList> CellIDs;
+
+	// Predicted position at the time the neighbor lists were built
+	AlignedVector<glm::vec2> NeighborListPosition;
+
+	std::vector<sf::Color> Color;
+
+private:
+
+	template <typename Container>
+	static void Permute(Container& container, const std::vector<unsigned int>& newToOld)
+	{
+		Container permuted(container.size());
+		for (unsigned int index = 0; index < newToOld.size(); index++)
+		{
+			permuted[index] = container[newToOld[index]];
+		}
+		container.swap(permuted);
+	}
+
+	// Prevent accidental copies of the whole particle system
+	FluidParticleStore(FluidParticleStore const&) = delete;
+	void operator=(FluidParticleStore const&) = delete;
+};
+
+#endif // FLUIDPARTICLESTORE_H
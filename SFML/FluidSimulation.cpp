@@ -1,257 +1,380 @@
 #include "FluidSimulation.h"
+#include "Profiler.h"
+#include "SimulationManager.h"
 
 #include <time.h>
+#include <stdlib.h>
 #include <memory>
+
+#ifndef HEADLESS
 #include "MarchingSquares.h"
+#endif // HEADLESS
 
 // ------------------------------------------------------------------------
 
-void FluidSimulation::Update(sf::RenderWindow& window, float dt)
+void FluidSimulation::Update(float dt)
 {
-	// Reset the spatial manager
-	SpatialPartition::GetInstance().ClearBuckets();
-	 
-	UpdateExternalForces(dt);
-	DampVelocities();
-	CalculatePredictedPositions(window, dt);
+	// Keep particles which are close in space close in memory
+	if (m_iReorderInterval > 0 && ++m_iStepsSinceReorder >= m_iReorderInterval)
+	{
+		PROFILE_SCOPE(ProfilePhase::FluidReorder);
 
-	// Project constraints
-	int iIteration = 0;
+		ReorderParticles();
+		m_iStepsSinceReorder = 0;
+	}
 
-	while (iIteration++ < SOLVER_ITERATIONS)
+	m_fTimeStep = dt;
+
+#ifdef MULTITHREADING
+
+	// Thread count changed since the last step
+	if (m_WorkerTeam == nullptr || m_WorkerTeam->GetThreadCount() != m_iThreadCount)
 	{
-		// ------------------------------------------------------------------------
-			
-		FindNeighborParticles();
+		SetupMultithread();
+	}
 
-		// ------------------------------------------------------------------------
+#endif // MULTITHREADING
 
-		// For the current particle get the lists of neighbors
-		for (unsigned int iParticleIndex = 0; iParticleIndex < m_ParticleList.size(); iParticleIndex++)
-		{
-			m_ParticleList[iParticleIndex]->UpdateNeighbors();
-		}
+	// Per thread accumulators of the deformable particle position corrections
+	unsigned int iGlobalParticleCount = m_ParticleManager->GlobalParticleListSize();
+	m_SoftPositionCorrections.resize(GetSolverThreadCount());
+	for (unsigned int i = 0; i < m_SoftPositionCorrections.size(); i++)
+	{
+		m_SoftPositionCorrections[i].assign(iGlobalParticleCount, glm::vec2(0.0f));
+	}
 
-		// ------------------------------------------------------------------------
+	m_ViscosityVelocity.resize(m_Particles.Size());
+	m_SolverDisplacements.resize(GetSolverThreadCount(), 0.0f);
 
-		// Particle constraint
-#ifdef MULTITHREADING
+	// Soft bodies are only tested by the fluid particles in the cells of their convex hull
+	SpatialPartition::GetInstance().BuildHullGrid(SimulationManager::GetInstance().GetSoftBodySimulationList());
 
-		for (unsigned int i = 0; i < ParticleConstraintTaskList.size(); i++)
-		{
-			m_ThreadPool->schedule(ParticleConstraintTaskList[i]);
-		}
+	// The whole step runs on the worker team, the phases are separated by barriers
+#ifdef MULTITHREADING
 
-		m_ThreadPool->wait();
+	m_WorkerTeam->Run(m_UpdateJob);
 
 #else
 
-		// For all particles calculate density constraint
-		for (unsigned int iParticleIndex = 0; iParticleIndex < m_ParticleList.size(); iParticleIndex++)
-		{
-			ComputeParticleConstraint(m_ParticleList[iParticleIndex]);
-		}
+	UpdateThread(0);
 
 #endif // MULTITHREADING
-			
-		// ------------------------------------------------------------------------
 
-		// Lambda
-#ifdef MULTITHREADING
+	if (!PBD_COLLISION)
+	{
+		ContainerCollisionUpdate();
+	}
+}
 
-		for (unsigned int i = 0; i < LambdaTaskList.size(); i++)
-		{
-			m_ThreadPool->schedule(LambdaTaskList[i]);
-		}
+// ------------------------------------------------------------------------
 
-		m_ThreadPool->wait();
-#else
+void FluidSimulation::UpdateThread(unsigned int iThread)
+{
+	// Static ranges for the phases with the same cost for every particle
+	unsigned int iStartIndex;
+	unsigned int iEndIndex;
+	GetParticleRange(iThread, iStartIndex, iEndIndex);
 
-		// For all particles calculate lambda
-		for (unsigned int iParticleIndex = 0; iParticleIndex < m_ParticleList.size(); iParticleIndex++)
-		{
-			ComputeLambda(m_ParticleList[iParticleIndex]);
-		}
+	// Chunks handed out by the work stealing scheduler for the phases whose cost depends on the neighbor count
+	unsigned int iChunk;
+	unsigned int iChunkStartIndex;
+	unsigned int iChunkEndIndex;
 
-#endif // MULTITHREADING
+	float dt = m_fTimeStep;
 
-			
+	{
+		PROFILE_THREAD_SCOPE(ProfilePhase::FluidPrediction, iThread);
 
-		// ------------------------------------------------------------------------
+		UpdateExternalForces(iStartIndex, iEndIndex, dt);
+		DampVelocities(iStartIndex, iEndIndex);
+		CalculatePredictedPositions(iStartIndex, iEndIndex, dt);
+	}
 
-		// Position correction
-#ifdef MULTITHREADING
+	{
+		PROFILE_THREAD_SCOPE(ProfilePhase::FluidMTD, iThread);
 
-		for (unsigned int i = 0; i < PositionCorrectionTaskList.size(); i++)
+		// Fluid particle MTD - it depends on the current positions and the convex hulls of the soft
+		// bodies, neither changes during the solver iterations
+		for (unsigned int iParticleIndex = iStartIndex; iParticleIndex < iEndIndex; iParticleIndex++)
 		{
-			m_ThreadPool->schedule(PositionCorrectionTaskList[i]);
+			FluidParticle(m_Particles, iParticleIndex).CalculateMinimumTranslationDistance();
 		}
+	}
 
-		m_ThreadPool->wait();
-#else
+	Synchronize(iThread);
 
-		// For all particles calculate the position correction - dp
-		for (unsigned int iParticleIndex = 0; iParticleIndex < m_ParticleList.size(); iParticleIndex++)
-		{
-			ComputePositionCorrection(m_ParticleList[iParticleIndex]);
-		}
+	// ------------------------------------------------------------------------
 
-#endif // MULTITHREADING
+	// Neighbor lists are built at most once per step and shared by all the solver iterations
+	if (iThread == 0)
+	{
+		m_bRebuildNeighborLists = NeighborListsExpired();
+		m_fGridBuildTime = 0.0;
+	}
 
-		// ------------------------------------------------------------------------
+	Synchronize(iThread);
 
-		// Fluid particle MTD
-#ifdef MULTITHREADING
+	if (m_bRebuildNeighborLists)
+	{
+		PROFILE_THREAD_SCOPE(ProfilePhase::FluidNeighborSearch, iThread);
 
-		for (unsigned int i = 0; i < MinTransDistanceTaskList.size(); i++)
+		double fGridBuildStartTime = GetHighResolutionTime();
+
+		FindNeighborParticles(iThread, iStartIndex, iEndIndex);
+
+		// All the threads are done with the grids after the last barrier of the build
+		if (iThread == 0)
 		{
-			m_ThreadPool->schedule(MinTransDistanceTaskList[i]);
+			m_fGridBuildTime = GetHighResolutionTime() - fGridBuildStartTime;
 		}
 
-		m_ThreadPool->wait();
+		// For the current particle get the lists of neighbors. Every chunk writes its own neighbor buffer.
+		m_Scheduler.Begin(iThread, m_Particles.Size());
+		while (m_Scheduler.Next(iThread, iChunk, iChunkStartIndex, iChunkEndIndex))
+		{
+			for (unsigned int iParticleIndex = iChunkStartIndex; iParticleIndex < iChunkEndIndex; iParticleIndex++)
+			{
+				UpdateNeighbors(iParticleIndex, iChunk);
+			}
+		}
 
-#else
+		Synchronize(iThread);
 
-		// For all particles calculate density constraint
-		for (unsigned int iParticleIndex = 0; iParticleIndex < m_ParticleList.size(); iParticleIndex++)
+		if (iThread == 0)
 		{
-			m_ParticleList[iParticleIndex]->CalculateMinimumTranslationDistance();
+			m_Neighbors.Finalize();
+
+			// Per-pair kernel cache shared by the density and position correction passes
+			m_PairGradient.resize(m_Neighbors.GetNeighborCount());
+			m_PairKernel.resize(m_Neighbors.GetNeighborCount());
 		}
 
-#endif // MULTITHREADING
+		Synchronize(iThread);
+	}
 
-		// ------------------------------------------------------------------------
+	// ------------------------------------------------------------------------
 
-		// Handle collision against deformable particles
+	// Project constraints
+	int iIteration = 0;
 
-		// Get global particle list size
-		unsigned int deformableParticlesCount = m_ParticleManager->GetDeformableParticles().size();
-			
-		// Particle-particle collision detection and response
-		for (unsigned int iFluidParticleIndex = 0; iFluidParticleIndex < m_ParticleList.size(); iFluidParticleIndex++)
+	while (iIteration++ < SOLVER_ITERATIONS)
+	{
+		// Density constraint and lambda - a single sweep over the neighbors
+		m_Scheduler.Begin(iThread, m_Particles.Size());
+		while (m_Scheduler.Next(iThread, iChunk, iChunkStartIndex, iChunkEndIndex))
 		{
-			// Get the current fluid particle
-			FluidParticle* pCurrentFluidParticle = m_ParticleList[iFluidParticleIndex];
-
-			// Get the no of deformable particles which are neighbors to the current fluid particle
-			unsigned int iDeformableParticleNeighborCount = m_ParticleList[iFluidParticleIndex]->GetSoftNeighbors().size();
-			std::vector<int>& deformableParticleNeighborList = m_ParticleList[iFluidParticleIndex]->GetSoftNeighbors();
+			PROFILE_THREAD_SCOPE(ProfilePhase::FluidLambda, iThread);
 
-			// -----------------------------------------------------------------------------------
-			// Push out
-
-			// Signed distance field used to keep the fluid particle from penetrating the soft body
-			if (pCurrentFluidParticle->SignedDistance > 0)
+			for (unsigned int iParticleIndex = iChunkStartIndex; iParticleIndex < iChunkEndIndex; iParticleIndex++)
 			{
-				glm::vec2 fOffset = glm::vec2(0.0f);
-				// Get collision normal
-				glm::vec2 collisionNormal = pCurrentFluidParticle->GradientSignedDistance;
-				// Calculate position adjustment
-				fOffset = 0.5f * pCurrentFluidParticle->SignedDistance * collisionNormal;
-				// Apply offset - Position correction due to interaction with soft body
-				pCurrentFluidParticle->PositionCorrection += fOffset * PBDSTIFFNESS_ADJUSTED;
+				ComputeDensityAndLambda(iParticleIndex);
 			}
+		}
 
-			// -----------------------------------------------------------------------------------
+		Synchronize(iThread);
 
-			// Go through all the deformable particles neighbors and check for collisions
-			for (unsigned iDeformableParticleIndex = 0; 
-				iDeformableParticleIndex < iDeformableParticleNeighborCount;
-				iDeformableParticleIndex++)
+		// Everything below only reads the lambda values of the other particles, so the rest
+		// of the iteration runs particle by particle without synchronization. The steps are
+		// done chunk by chunk so that each one can be timed on its own.
+		m_Scheduler.Begin(iThread, m_Particles.Size());
+		while (m_Scheduler.Next(iThread, iChunk, iChunkStartIndex, iChunkEndIndex))
+		{
 			{
-				// Get the current soft particle
-				DeformableParticle* pCurrentSoftParticle = (DeformableParticle*)m_ParticleManager->GetParticle(deformableParticleNeighborList[iDeformableParticleIndex]);
+				PROFILE_THREAD_SCOPE(ProfilePhase::FluidPositionCorrection, iThread);
 
-				// Check if there is a collision between particles
-				if (pCurrentSoftParticle->IsCollidingDynamic(*pCurrentFluidParticle))
+				// Position correction - dp
+				for (unsigned int iParticleIndex = iChunkStartIndex; iParticleIndex < iChunkEndIndex; iParticleIndex++)
 				{
-					// Particle-particle collision - Handle basic collision
-					glm::vec2 p1p2 = pCurrentSoftParticle->PredictedPosition - pCurrentFluidParticle->PredictedPosition;
-					float fDistance = glm::length(p1p2);
+					ComputePositionCorrection(iParticleIndex);
+				}
+			}
 
-					glm::vec2 fDp1 = -0.5f * (fDistance - SMOOTHING_DISTANCE) * (p1p2) / fDistance;
-					glm::vec2 fDp2 = -fDp1;
+			PROFILE_THREAD_SCOPE(ProfilePhase::FluidSoftCoupling, iThread);
 
-					// Apply offset - Position correction due to interaction with fluid particle
-					pCurrentSoftParticle->PositionCorrection += fDp1 * PBDSTIFFNESS_ADJUSTED;
-					pCurrentFluidParticle->PositionCorrection += fDp2 * PBDSTIFFNESS_ADJUSTED;
+			for (unsigned int iParticleIndex = iChunkStartIndex; iParticleIndex < iChunkEndIndex; iParticleIndex++)
+			{
+				// Handle collision against deformable particles
+				SolveDeformableCollisions(iParticleIndex, iThread);
+
+				// Update the predicted position
+				m_Particles.PredictedPosition[iParticleIndex] += m_Particles.PositionCorrection[iParticleIndex];
+
+				if (PBD_COLLISION)
+				{
+					SolveContainerConstraints(iParticleIndex);
 				}
 			}
 		}
 
-		// ------------------------------------------------------------------------
+		Synchronize(iThread);
+	}
 
-		// For all particles update the predicted position
-		for (auto it = m_ParticleList.begin(); it != m_ParticleList.end(); it++)
-		{
-			FluidParticle* pCurrentParticle = *it;
+	// ------------------------------------------------------------------------
 
-			pCurrentParticle->PredictedPosition += pCurrentParticle->PositionCorrection;
-		}
+	// Update the actual position and velocity of the particle
+	{
+		PROFILE_THREAD_SCOPE(ProfilePhase::FluidVelocityUpdate, iThread);
+
+		m_SolverDisplacements[iThread] = UpdateActualPosAndVelocities(iStartIndex, iEndIndex, dt);
+	}
 
-		// ------------------------------------------------------------------------
+	if (XSPH_VISCOSITY)
+	{
+		Synchronize(iThread);
 
-		if (PBD_COLLISION)
+		// Viscosity is computed from the velocities of all the neighbors before any is changed
+		m_Scheduler.Begin(iThread, m_Particles.Size());
+		while (m_Scheduler.Next(iThread, iChunk, iChunkStartIndex, iChunkEndIndex))
 		{
-			// Generate external collision constraints
-			GenerateCollisionConstraints();
+			PROFILE_THREAD_SCOPE(ProfilePhase::FluidVelocityUpdate, iThread);
 
-			// Update container constraints Position based
-			for each (auto container_constraint in m_ContainerConstraints)
+			for (unsigned int iParticleIndex = iChunkStartIndex; iParticleIndex < iChunkEndIndex; iParticleIndex++)
 			{
-				glm::vec2 particlePredictedPosition =
-					m_ParticleList[container_constraint.particleIndex]->PredictedPosition;
+				m_ViscosityVelocity[iParticleIndex] = XSPH_Viscosity(iParticleIndex);
+			}
+		}
 
-				float constraint = glm::dot(particlePredictedPosition - container_constraint.projectionPoint, container_constraint.normalVector);
+		Synchronize(iThread);
 
-				glm::vec2 gradientDescent = container_constraint.normalVector;
-				float gradienDescentLength = glm::length(gradientDescent);
+		PROFILE_THREAD_SCOPE(ProfilePhase::FluidVelocityUpdate, iThread);
 
-				glm::vec2 dp;
-				if (gradienDescentLength < EPS)
-				{
-					dp = glm::vec2(0.0f);
-				}
-				else
-				{
-					dp = -constraint / (gradienDescentLength * gradienDescentLength) * gradientDescent;
-				}
+		for (unsigned int iParticleIndex = iStartIndex; iParticleIndex < iEndIndex; iParticleIndex++)
+		{
+			m_Particles.Velocity[iParticleIndex] += m_ViscosityVelocity[iParticleIndex];
+		}
+	}
 
-				m_ParticleList[container_constraint.particleIndex]->PredictedPosition += dp * container_constraint.stiffness_adjusted;
-			}
+	PROFILE_THREAD_SCOPE(ProfilePhase::FluidSoftCoupling, iThread);
 
-			// Clear the constraint list
-			m_ContainerConstraints.clear();
+	// Apply the corrections accumulated by all the threads to the deformable particles
+	unsigned int iGlobalStartIndex;
+	unsigned int iGlobalEndIndex;
+	GetRange(iThread, m_ParticleManager->GlobalParticleListSize(), iGlobalStartIndex, iGlobalEndIndex);
+
+	for (unsigned int index = iGlobalStartIndex; index < iGlobalEndIndex; index++)
+	{
+		glm::vec2 correction = glm::vec2(0.0f);
+
+		for (unsigned int i = 0; i < m_SoftPositionCorrections.size(); i++)
+		{
+			correction += m_SoftPositionCorrections[i][index];
 		}
-		
-		// ------------------------------------------------------------------------
+
+		m_ParticleManager->GetParticle(index)->PositionCorrection += correction;
 	}
+}
 
-	// Update the actual position and velocity of the particle
-	UpdateActualPosAndVelocities(dt);
+// ------------------------------------------------------------------------
 
-	if (!PBD_COLLISION)
+void FluidSimulation::SolveDeformableCollisions(unsigned int iFluidParticleIndex, unsigned int iThread)
+{
+	// Get the current fluid particle
+	FluidParticle currentFluidParticle(m_Particles, iFluidParticleIndex);
+	std::vector<glm::vec2>& softPositionCorrections = m_SoftPositionCorrections[iThread];
+
+	// Get the no of deformable particles which are neighbors to the current fluid particle
+	NeighborSpan deformableParticleNeighborList = m_Neighbors.GetSoftNeighbors(iFluidParticleIndex);
+	unsigned int iDeformableParticleNeighborCount = deformableParticleNeighborList.size();
+
+	// -----------------------------------------------------------------------------------
+	// Push out
+
+	// Signed distance field used to keep the fluid particle from penetrating the soft body
+	if (currentFluidParticle.SignedDistance() > 0)
 	{
-		ContainerCollisionUpdate();
+		glm::vec2 fOffset = glm::vec2(0.0f);
+		// Get collision normal
+		glm::vec2 collisionNormal = currentFluidParticle.GradientSignedDistance();
+		// Calculate position adjustment
+		fOffset = 0.5f * currentFluidParticle.SignedDistance() * collisionNormal;
+		// Apply offset - Position correction due to interaction with soft body
+		currentFluidParticle.PositionCorrection() += fOffset * PBDSTIFFNESS_ADJUSTED;
 	}
 
-	// Fluid stats update
-	std::string velocityDamping = GetPropertyString(Settings::VelocityDamping);
-	std::string viscosity = GetPropertyString(Settings::Viscosity);
+	// -----------------------------------------------------------------------------------
+
+	// Go through all the deformable particles neighbors and check for collisions
+	for (unsigned iDeformableParticleIndex = 0; 
+		iDeformableParticleIndex < iDeformableParticleNeighborCount;
+		iDeformableParticleIndex++)
+	{
+		// Get the current soft particle
+		DeformableParticle* pCurrentSoftParticle = (DeformableParticle*)m_ParticleManager->GetParticle(deformableParticleNeighborList[iDeformableParticleIndex]);
+
+		// The neighbor list includes the skin - only consider particles within the smoothing distance
+		glm::vec2 softToFluid = pCurrentSoftParticle->Position - currentFluidParticle.PredictedPosition();
+		if (glm::dot(softToFluid, softToFluid) > SMOOTHING_DISTANCE2)
+		{
+			continue;
+		}
+
+		// Check if there is a collision between particles
+		if (pCurrentSoftParticle->IsCollidingDynamic(currentFluidParticle.Position()))
+		{
+			// Particle-particle collision - Handle basic collision
+			glm::vec2 p1p2 = pCurrentSoftParticle->PredictedPosition - currentFluidParticle.PredictedPosition();
+			float fDistance = glm::length(p1p2);
 
-	m_FluidStats->SetString(velocityDamping + viscosity);
+			glm::vec2 fDp1 = -0.5f * (fDistance - SMOOTHING_DISTANCE) * (p1p2) / fDistance;
+			glm::vec2 fDp2 = -fDp1;
+
+			// Apply offset - Position correction due to interaction with fluid particle. The deformable
+			// particle is shared with other threads so its correction is accumulated separately.
+			softPositionCorrections[deformableParticleNeighborList[iDeformableParticleIndex]] += fDp1 * PBDSTIFFNESS_ADJUSTED;
+			currentFluidParticle.PositionCorrection() += fDp2 * PBDSTIFFNESS_ADJUSTED;
+		}
+	}
+}
+
+// ------------------------------------------------------------------------
+
+void FluidSimulation::SolveContainerConstraints(unsigned int iParticleIndex)
+{
+	// Generate external collision constraints
+	ContainerConstraint constraints[4];
+	unsigned int iConstraintCount = GenerateCollisionConstraints(iParticleIndex, constraints);
+
+	// Update container constraints Position based
+	for (unsigned int i = 0; i < iConstraintCount; i++)
+	{
+		const ContainerConstraint& container_constraint = constraints[i];
+
+		glm::vec2 particlePredictedPosition =
+			m_Particles.PredictedPosition[container_constraint.particleIndex];
+
+		float constraint = glm::dot(particlePredictedPosition - container_constraint.projectionPoint, container_constraint.normalVector);
+
+		glm::vec2 gradientDescent = container_constraint.normalVector;
+		float gradienDescentLength = glm::length(gradientDescent);
+
+		glm::vec2 dp;
+		if (gradienDescentLength < EPS)
+		{
+			dp = glm::vec2(0.0f);
+		}
+		else
+		{
+			dp = -constraint / (gradienDescentLength * gradienDescentLength) * gradientDescent;
+		}
+
+		m_Particles.PredictedPosition[container_constraint.particleIndex] += dp * container_constraint.stiffness_adjusted;
+	}
 }
 
 // ------------------------------------------------------------------------
 
+#ifndef HEADLESS
+
 void FluidSimulation::Draw(sf::RenderWindow& window)
 {
 	if (FLUIDRENDERING_PARTICLE)
 	{
 		// Draw particles
-		for (unsigned int index = 0; index < m_ParticleList.size(); index++)
+		for (unsigned int index = 0; index < m_Particles.Size(); index++)
 		{
-			m_ParticleList[index]->Draw(window);
+			m_ParticleShape.setPosition(m_Particles.Position[index].x, m_Particles.Position[index].y);
+			m_ParticleShape.setFillColor(m_Particles.Color[index]);
+			window.draw(m_ParticleShape);
 		}
 	}
 	
@@ -261,9 +384,45 @@ void FluidSimulation::Draw(sf::RenderWindow& window)
 	}
 
 	// Fluid stats draw
-	m_FluidStats->Draw(window);
+	if (m_FluidStats)
+	{
+		UpdateStats();
+		m_FluidStats->Draw(window);
+	}
+}
+
+// ------------------------------------------------------------------------
+
+void FluidSimulation::UpdateStats()
+{
+	std::string velocityDamping = GetPropertyString(Settings::VelocityDamping);
+	std::string viscosity = GetPropertyString(Settings::Viscosity);
+	std::string neighborSkin = GetPropertyString(Settings::NeighborSkin);
+	std::string reorderInterval = GetPropertyString(Settings::ReorderInterval);
+
+	std::string threadTimings;
+
+#ifdef MULTITHREADING
+
+	threadTimings = GetPropertyString(Settings::ThreadCount);
+	threadTimings += "Grid build: " + std::to_string(m_fGridBuildTime * 1000.0) + "\n";
+
+	// Load balance of the last step
+	unsigned int iTeamSize = m_WorkerTeam != nullptr ? m_WorkerTeam->GetThreadCount() : 0;
+	for (unsigned int iThread = 0; iThread < iTeamSize; iThread++)
+	{
+		threadTimings += "Thread " + std::to_string(iThread) +
+			" busy: " + std::to_string(m_WorkerTeam->GetBusyTime(iThread) * 1000.0) +
+			" idle: " + std::to_string(m_WorkerTeam->GetIdleTime(iThread) * 1000.0) + "\n";
+	}
+
+#endif // MULTITHREADING
+
+	m_FluidStats->SetString(velocityDamping + viscosity + neighborSkin + reorderInterval + threadTimings);
 }
 
+#endif // HEADLESS
+
 // ------------------------------------------------------------------------
 
 void FluidSimulation::InputUpdate(float delta, int navigation)
@@ -284,6 +443,17 @@ void FluidSimulation::InputUpdate(float delta, int navigation)
 		case FluidSimulation::Settings::Viscosity:
 			m_fXSPHParam += delta;
 			break;
+		case FluidSimulation::Settings::NeighborSkin:
+			SetNeighborSkin(m_fNeighborSkin + 0.1f * delta);
+			break;
+		case FluidSimulation::Settings::ReorderInterval:
+			SetReorderInterval((unsigned int)std::max((int)m_iReorderInterval + (int)(10.0f * delta), 0));
+			break;
+#ifdef MULTITHREADING
+		case FluidSimulation::Settings::ThreadCount:
+			SetThreadCount((unsigned int)std::max((int)m_iThreadCount + (int)delta, 1));
+			break;
+#endif // MULTITHREADING
 		case FluidSimulation::Settings::Invalid:
 			break;
 		default:
@@ -306,6 +476,14 @@ glm::vec2 FluidSimulation::GetRandomPosWithinLimits()
 
 void FluidSimulation::BuildParticleSystem(const glm::vec2& startPosition, 
 	const sf::Color& color)
+{
+	BuildParticleSystem(startPosition, color, PARTICLE_WIDTH_COUNT, PARTICLE_HEIGHT_COUNT);
+}
+
+// ------------------------------------------------------------------------
+
+void FluidSimulation::BuildParticleSystem(const glm::vec2& startPosition,
+	const sf::Color& color, int iWidthCount, int iHeightCount)
 {
 	// Initialize the particle manager
 	m_ParticleManager = &ParticleManager::GetInstance();
@@ -315,20 +493,17 @@ void FluidSimulation::BuildParticleSystem(const glm::vec2& startPosition,
 
 	glm::vec2 currentPosition = glm::vec2(PARTICLE_LEFTLIMIT + startPosition.x, PARTICLE_TOPLIMIT + startPosition.y);
 
-	for (int iLine = 0; iLine < PARTICLE_WIDTH_COUNT; iLine++)
+	m_Particles.Reserve(m_Particles.Size() + iWidthCount * iHeightCount);
+
+	for (int iLine = 0; iLine < iHeightCount; iLine++)
 	{
-		for (int jColumn = 0; jColumn < PARTICLE_HEIGHT_COUNT; jColumn++)
+		for (int jColumn = 0; jColumn < iWidthCount; jColumn++)
 		{
-			FluidParticle* particle = new FluidParticle(currentPosition, color, GetSimulationIndex());
+			// Build particle list
+			m_Particles.AddParticle(currentPosition, color);
 
 			// Update current position X
 			currentPosition.x += fDx;
-
-			// Build particle list
-			m_ParticleList.push_back(particle);
-
-			// Add particle to the global list
-			m_ParticleManager->AddGlobalParticle(particle);
 		}
 
 		// Update current position Y
@@ -339,54 +514,48 @@ void FluidSimulation::BuildParticleSystem(const glm::vec2& startPosition,
 
 // ------------------------------------------------------------------------
 
+void FluidSimulation::RestoreParticleStore(const FluidParticleStore& particles)
+{
+	m_Particles.CopyFrom(particles);
+
+	// Indices and positions may not match the cached neighbor lists anymore
+	m_bNeighborListsValid = false;
+	m_iStepsSinceReorder = 0;
+}
+
+// ------------------------------------------------------------------------
+
 #ifdef MULTITHREADING
 
 void FluidSimulation::SetupMultithread()
 {
-	if (m_ThreadPool == nullptr)
+	// The particles are split between the threads every step, so adding particles
+	// does not require another setup
+	if (m_WorkerTeam == nullptr || m_WorkerTeam->GetThreadCount() != m_iThreadCount)
 	{
-		m_ThreadPool = std::make_unique<boost::threadpool::pool>(m_iThreadCount);
+		m_WorkerTeam.reset();
+		m_WorkerTeam = std::make_unique<WorkerTeam>(m_iThreadCount);
 	}
-	LambdaTaskList.clear();
-	PositionCorrectionTaskList.clear();
-	ParticleConstraintTaskList.clear();
-	MinTransDistanceTaskList.clear();
-
-	// Create a list of tasks
-	for (unsigned int iThreadIndex = 0; iThreadIndex < m_iThreadCount; iThreadIndex++)
-	{
-		// Calculate the start and end index to process for the current thread
-		int iStep = m_ParticleList.size() / m_iThreadCount;
-
-		int iStartIndex = iStep * iThreadIndex;
-		int iEndIndex = iStep * (iThreadIndex + 1);
 
-		if (iThreadIndex == m_iThreadCount - 1)
-		{
-			iEndIndex = m_ParticleList.size();
-		}
-
-		// Initialize task list for lambda calculation
-		LambdaTaskList.push_back(boost::bind(&FluidSimulation::ComputeLambdaMultithread,
-			this,
-			iStartIndex,
-			iEndIndex));
-
-		PositionCorrectionTaskList.push_back(boost::bind(&FluidSimulation::PositionCorrectionMultithread,
-			this,
-			iStartIndex,
-			iEndIndex));
+	m_Scheduler.Setup(m_iThreadCount);
+#ifdef PROFILING
+	Profiler::GetInstance().Setup(m_iThreadCount);
+#endif // PROFILING
+	m_UpdateJob = [this](unsigned int iThread) { UpdateThread(iThread); };
+}
 
-		ParticleConstraintTaskList.push_back(boost::bind(&FluidSimulation::ComputeParticleConstraintMultithread,
-			this,
-			iStartIndex,
-			iEndIndex));
+// ------------------------------------------------------------------------
 
-		MinTransDistanceTaskList.push_back(boost::bind(&FluidSimulation::ComputeMTDMultithread,
-			this,
-			iStartIndex,
-			iEndIndex));
+unsigned int FluidSimulation::GetDefaultThreadCount()
+{
+	const char* pThreadCount = getenv("PBD_THREAD_COUNT");
+	if (pThreadCount != nullptr && atoi(pThreadCount) > 0)
+	{
+		return (unsigned int)atoi(pThreadCount);
 	}
+
+	// hardware_concurrency returns 0 when it cannot tell
+	return std::max(std::thread::hardware_concurrency(), 1u);
 }
 
 #endif // MULTITHREADING
@@ -405,20 +574,17 @@ void FluidSimulation::AddFluidParticles(const glm::vec2& position, const sf::Col
 
 	glm::vec2 currentPosition = glm::vec2(position.x, position.y);
 
+	m_Particles.Reserve(m_Particles.Size() + PARTICLE_WIDTH_NEW * PARTICLE_HEIGHT_NEW);
+
 	for (int iLine = 0; iLine < PARTICLE_WIDTH_NEW; iLine++)
 	{
 		for (int jColumn = 0; jColumn < PARTICLE_HEIGHT_NEW; jColumn++)
 		{
-			FluidParticle* particle = new FluidParticle(currentPosition, color, GetSimulationIndex());
+			// Build particle list
+			m_Particles.AddParticle(currentPosition, color);
 
 			// Update current position X
 			currentPosition.x += fDx;
-
-			// Build particle list
-			m_ParticleList.push_back(particle);
-
-			// Add particle to the global list
-			m_ParticleManager->AddGlobalParticle(particle);
 		}
 
 		// Update current position Y
@@ -431,343 +597,464 @@ void FluidSimulation::AddFluidParticles(const glm::vec2& position, const sf::Col
 
 // ------------------------------------------------------------------------
 
-void FluidSimulation::UpdateExternalForces(float dt)
+void FluidSimulation::UpdateExternalForces(unsigned int iStartIndex, unsigned int iEndIndex, float dt)
 {
-	for (auto it = m_ParticleList.begin(); it != m_ParticleList.end(); it++)
+	for (unsigned int iParticleIndex = iStartIndex; iParticleIndex < iEndIndex; iParticleIndex++)
 	{
 		// Update particle velocity
 		if (GRAVITY_ON)
 		{
-			FluidParticle* pCurrentParticle = *it;
-
-			pCurrentParticle->Velocity += dt * pCurrentParticle->Mass * (GRAVITATIONAL_ACCELERATION * pCurrentParticle->Mass);
+			m_Particles.Velocity[iParticleIndex] += dt * PARTICLE_MASS * (GRAVITATIONAL_ACCELERATION * PARTICLE_MASS);
 		}
 	}
 }
 
 // ------------------------------------------------------------------------
 
-void FluidSimulation::DampVelocities()
+void FluidSimulation::DampVelocities(unsigned int iStartIndex, unsigned int iEndIndex)
 {
 	// Damp velocity
-	for (auto it = m_ParticleList.begin(); it != m_ParticleList.end(); it++)
+	for (unsigned int iParticleIndex = iStartIndex; iParticleIndex < iEndIndex; iParticleIndex++)
 	{
-		FluidParticle* pCurrentParticle = *it;
-
-		pCurrentParticle->Velocity = pCurrentParticle->Velocity * m_fVelocityDamping;
+		m_Particles.Velocity[iParticleIndex] = m_Particles.Velocity[iParticleIndex] * m_fVelocityDamping;
 	}
 }
 
 // ------------------------------------------------------------------------
 
-void FluidSimulation::CalculatePredictedPositions(sf::RenderWindow& window, float dt)
+void FluidSimulation::CalculatePredictedPositions(unsigned int iStartIndex, unsigned int iEndIndex, float dt)
 {
 	// Calculate the predicted positions
-	for (auto it = m_ParticleList.begin(); it != m_ParticleList.end(); it++)
+	for (unsigned int iParticleIndex = iStartIndex; iParticleIndex < iEndIndex; iParticleIndex++)
 	{
-		FluidParticle* pCurrentParticle = *it;
-
 		// Update position
-		pCurrentParticle->PredictedPosition += dt * pCurrentParticle->Velocity;
+		m_Particles.PredictedPosition[iParticleIndex] += dt * m_Particles.Velocity[iParticleIndex];
 	}
 }
 
 // ------------------------------------------------------------------------
 
-void FluidSimulation::UpdateActualPosAndVelocities(float dt)
+float FluidSimulation::UpdateActualPosAndVelocities(unsigned int iStartIndex, unsigned int iEndIndex, float dt)
 {
-	for (unsigned int iParticleIndex = 0; iParticleIndex < m_ParticleList.size(); iParticleIndex++)
+	float fMaxSolverDisplacement2 = 0.0f;
+
+	for (unsigned int iParticleIndex = iStartIndex; iParticleIndex < iEndIndex; iParticleIndex++)
 	{
-		FluidParticle& currentParticle = *m_ParticleList[iParticleIndex];
+		// The prediction moved the particle by its velocity, the rest was done by the solver
+		glm::vec2 solverDisplacement = m_Particles.PredictedPosition[iParticleIndex] - m_Particles.Position[iParticleIndex] -
+			dt * m_Particles.Velocity[iParticleIndex];
+		fMaxSolverDisplacement2 = std::max(fMaxSolverDisplacement2, glm::dot(solverDisplacement, solverDisplacement));
 
 		if (dt != 0.0f)
 		{
 			// Update velocity based on the distance offset (after correcting the position)
-			currentParticle.Velocity = (currentParticle.PredictedPosition - currentParticle.Position) / dt;
-		}
-
-		// Apply XSPH viscosity
-		if (XSPH_VISCOSITY)
-		{
-			XSPH_Viscosity(&currentParticle);
+			m_Particles.Velocity[iParticleIndex] = (m_Particles.PredictedPosition[iParticleIndex] - m_Particles.Position[iParticleIndex]) / dt;
 		}
 
 		// Update position
-		currentParticle.Position = currentParticle.PredictedPosition;
-
-		// Update local position
-		glm::vec2 localOffset(WALL_LEFTLIMIT, WALL_TOPLIMIT);
-		currentParticle.LocalPosition = currentParticle.Position - localOffset;
-
-		// Update the position of the particle shape
-		currentParticle.Update();
+		m_Particles.Position[iParticleIndex] = m_Particles.PredictedPosition[iParticleIndex];
 	}
+
+	return sqrt(fMaxSolverDisplacement2);
 }
 
 // ------------------------------------------------------------------------
 
-void FluidSimulation::GenerateCollisionConstraints()
+unsigned int FluidSimulation::GenerateCollisionConstraints(unsigned int iParticleIndex, ContainerConstraint* pConstraints)
 {
-	for (auto it = m_ParticleList.begin(); it != m_ParticleList.end(); it++)
-	{
-		FluidParticle* currentParticle = *it;
+	unsigned int iConstraintCount = 0;
 
-		float fIntersectionCoeff;
-		glm::vec2 intersectionPoint;
+	const glm::vec2& position = m_Particles.Position[iParticleIndex];
+	const glm::vec2& predictedPosition = m_Particles.PredictedPosition[iParticleIndex];
 
-		if (currentParticle->PredictedPosition.x < PARTICLE_LEFTLIMIT)
-		{
-			if (currentParticle->PredictedPosition.x - currentParticle->Position.x != 0.0f)
-			{
-				fIntersectionCoeff = (PARTICLE_LEFTLIMIT - currentParticle->Position.x) / (currentParticle->PredictedPosition.x - currentParticle->Position.x);
-				intersectionPoint = glm::vec2(PARTICLE_LEFTLIMIT, currentParticle->Position.y + fIntersectionCoeff * (currentParticle->PredictedPosition.y - currentParticle->Position.y));
+	float fIntersectionCoeff;
+	glm::vec2 intersectionPoint;
 
-				ContainerConstraint cc;
-				cc.particleIndex = currentParticle->Index;
-				cc.normalVector = glm::vec2(1.0f, 0.0f);
-				cc.projectionPoint = intersectionPoint;
-				cc.stiffness = PBDSTIFFNESSFLUIDCONTAINER;
-				cc.stiffness_adjusted = PBDSTIFFNESS_ADJUSTEDFLUIDCONTAINTER;
-				m_ContainerConstraints.push_back(cc);
-			}	
-		}
+	if (predictedPosition.x < PARTICLE_LEFTLIMIT)
+	{
+		if (predictedPosition.x - position.x != 0.0f)
+		{
+			fIntersectionCoeff = (PARTICLE_LEFTLIMIT - position.x) / (predictedPosition.x - position.x);
+			intersectionPoint = glm::vec2(PARTICLE_LEFTLIMIT, position.y + fIntersectionCoeff * (predictedPosition.y - position.y));
+
+			ContainerConstraint cc;
+			cc.particleIndex = iParticleIndex;
+			cc.normalVector = glm::vec2(1.0f, 0.0f);
+			cc.projectionPoint = intersectionPoint;
+			cc.stiffness = PBDSTIFFNESSFLUIDCONTAINER;
+			cc.stiffness_adjusted = PBDSTIFFNESS_ADJUSTEDFLUIDCONTAINTER;
+			pConstraints[iConstraintCount++] = cc;
+		}	
+	}
 
-		if (currentParticle->PredictedPosition.y < PARTICLE_TOPLIMIT)
+	if (predictedPosition.y < PARTICLE_TOPLIMIT)
+	{
+		if (predictedPosition.y - position.y != 0.0f)
 		{
-			if (currentParticle->PredictedPosition.y - currentParticle->Position.y != 0.0f)
-			{
-				fIntersectionCoeff = (PARTICLE_TOPLIMIT - currentParticle->Position.y) / (currentParticle->PredictedPosition.y - currentParticle->Position.y);
-				intersectionPoint = glm::vec2(currentParticle->Position.x + fIntersectionCoeff * (currentParticle->PredictedPosition.x - currentParticle->Position.x), PARTICLE_TOPLIMIT);
-
-				ContainerConstraint cc;
-				cc.particleIndex = currentParticle->Index;
-				cc.normalVector = glm::vec2(0.0f, 1.0f);
-				cc.projectionPoint = intersectionPoint;
-				cc.stiffness = PBDSTIFFNESSFLUIDCONTAINER;
-				cc.stiffness_adjusted = PBDSTIFFNESS_ADJUSTEDFLUIDCONTAINTER;
-				m_ContainerConstraints.push_back(cc);
-			}
+			fIntersectionCoeff = (PARTICLE_TOPLIMIT - position.y) / (predictedPosition.y - position.y);
+			intersectionPoint = glm::vec2(position.x + fIntersectionCoeff * (predictedPosition.x - position.x), PARTICLE_TOPLIMIT);
+
+			ContainerConstraint cc;
+			cc.particleIndex = iParticleIndex;
+			cc.normalVector = glm::vec2(0.0f, 1.0f);
+			cc.projectionPoint = intersectionPoint;
+			cc.stiffness = PBDSTIFFNESSFLUIDCONTAINER;
+			cc.stiffness_adjusted = PBDSTIFFNESS_ADJUSTEDFLUIDCONTAINTER;
+			pConstraints[iConstraintCount++] = cc;
 		}
+	}
 
-		if (currentParticle->PredictedPosition.x > PARTICLE_RIGHTLIMIT)
+	if (predictedPosition.x > PARTICLE_RIGHTLIMIT)
+	{
+		if (predictedPosition.x - position.x != 0.0f)
 		{
-			if (currentParticle->PredictedPosition.x - currentParticle->Position.x != 0.0f)
-			{
-				fIntersectionCoeff = (PARTICLE_RIGHTLIMIT - currentParticle->Position.x) / (currentParticle->PredictedPosition.x - currentParticle->Position.x);
-				intersectionPoint = glm::vec2(PARTICLE_RIGHTLIMIT, currentParticle->Position.y + fIntersectionCoeff * (currentParticle->PredictedPosition.y - currentParticle->Position.y));
-
-				ContainerConstraint cc;
-				cc.particleIndex = currentParticle->Index;
-				cc.normalVector = glm::vec2(-1.0f, 0.0f);
-				cc.projectionPoint = intersectionPoint;
-				cc.stiffness = PBDSTIFFNESSFLUIDCONTAINER;
-				cc.stiffness_adjusted = PBDSTIFFNESS_ADJUSTEDFLUIDCONTAINTER;
-				m_ContainerConstraints.push_back(cc);
-			}
+			fIntersectionCoeff = (PARTICLE_RIGHTLIMIT - position.x) / (predictedPosition.x - position.x);
+			intersectionPoint = glm::vec2(PARTICLE_RIGHTLIMIT, position.y + fIntersectionCoeff * (predictedPosition.y - position.y));
+
+			ContainerConstraint cc;
+			cc.particleIndex = iParticleIndex;
+			cc.normalVector = glm::vec2(-1.0f, 0.0f);
+			cc.projectionPoint = intersectionPoint;
+			cc.stiffness = PBDSTIFFNESSFLUIDCONTAINER;
+			cc.stiffness_adjusted = PBDSTIFFNESS_ADJUSTEDFLUIDCONTAINTER;
+			pConstraints[iConstraintCount++] = cc;
 		}
+	}
 
-		if (currentParticle->PredictedPosition.y > PARTICLE_BOTTOMLIMIT)
+	if (predictedPosition.y > PARTICLE_BOTTOMLIMIT)
+	{
+		if (predictedPosition.y - position.y != 0.0f)
 		{
-			if (currentParticle->PredictedPosition.y - currentParticle->Position.y != 0.0f)
-			{
-				fIntersectionCoeff = (PARTICLE_BOTTOMLIMIT - currentParticle->Position.y) / (currentParticle->PredictedPosition.y - currentParticle->Position.y);
-				intersectionPoint = glm::vec2(currentParticle->Position.x + fIntersectionCoeff * (currentParticle->PredictedPosition.x - currentParticle->Position.x), PARTICLE_BOTTOMLIMIT);
-
-				ContainerConstraint cc;
-				cc.particleIndex = currentParticle->Index;
-				cc.normalVector = glm::vec2(0.0f, -1.0f);
-				cc.projectionPoint = intersectionPoint;
-				cc.stiffness = PBDSTIFFNESSFLUIDCONTAINER;
-				cc.stiffness_adjusted = PBDSTIFFNESS_ADJUSTEDFLUIDCONTAINTER;
-				m_ContainerConstraints.push_back(cc);
-			}
+			fIntersectionCoeff = (PARTICLE_BOTTOMLIMIT - position.y) / (predictedPosition.y - position.y);
+			intersectionPoint = glm::vec2(position.x + fIntersectionCoeff * (predictedPosition.x - position.x), PARTICLE_BOTTOMLIMIT);
+
+			ContainerConstraint cc;
+			cc.particleIndex = iParticleIndex;
+			cc.normalVector = glm::vec2(0.0f, -1.0f);
+			cc.projectionPoint = intersectionPoint;
+			cc.stiffness = PBDSTIFFNESSFLUIDCONTAINER;
+			cc.stiffness_adjusted = PBDSTIFFNESS_ADJUSTEDFLUIDCONTAINTER;
+			pConstraints[iConstraintCount++] = cc;
 		}
 	}
+
+	return iConstraintCount;
 }
 
 // ------------------------------------------------------------------------
 
-void FluidSimulation::FindNeighborParticles()
+void FluidSimulation::FindNeighborParticles(unsigned int iThread, unsigned int iStartIndex, unsigned int iEndIndex)
 {
-	for (unsigned int index = 0; index < m_ParticleList.size(); index++)
+	SpatialPartition& spatialPartition = SpatialPartition::GetInstance();
+	UniformGrid& fluidGrid = spatialPartition.GetFluidGrid();
+
+	// Rebuild the fluid and the deformable grids: cell histogram, prefix sum, scatter.
+	// Every thread sorts its own chunk of fluid and deformable particles.
+	unsigned int iDeformableParticleCount = m_ParticleManager->GetDeformableParticles().size();
+
+	if (iThread == 0)
 	{
-		// Repopulate the spatial manager with the particles
-		SpatialPartition::GetInstance().RegisterObject(m_ParticleList[index]);
+		fluidGrid.Begin(GetSolverThreadCount());
+		spatialPartition.BeginRegistration(iDeformableParticleCount, GetSolverThreadCount());
+
+		m_SoftNeighborListPositions.resize(iDeformableParticleCount);
+	}
+
+	Synchronize(iThread);
+
+	glm::vec2 localOffset(WALL_LEFTLIMIT, WALL_TOPLIMIT);
+
+	for (unsigned int index = iStartIndex; index < iEndIndex; index++)
+	{
+		m_Particles.CellIDs[index].Count = 1;
+		m_Particles.CellIDs[index].IDs[0] = SpatialPartition::ComputeCellID(m_Particles.PredictedPosition[index] - localOffset);
+		m_Particles.NeighborListPosition[index] = m_Particles.PredictedPosition[index];
+	}
+
+	fluidGrid.Count(iThread, m_Particles.CellIDs.data(), iStartIndex, iEndIndex);
+
+	// Repopulate the spatial manager with the deformable particles
+	unsigned int iSoftStartIndex;
+	unsigned int iSoftEndIndex;
+	GetRange(iThread, iDeformableParticleCount, iSoftStartIndex, iSoftEndIndex);
+
+	for (unsigned int index = iSoftStartIndex; index < iSoftEndIndex; index++)
+	{
+		BaseParticle* pParticle = (BaseParticle*)m_ParticleManager->GetDeformableParticle(index);
+
+		spatialPartition.RegisterObject(index, pParticle);
+		m_SoftNeighborListPositions[index] = pParticle->Position;
 	}
 
-	for (unsigned int index = 0; index < ParticleManager::GetInstance().GetDeformableParticles().size(); index++)
+	spatialPartition.CountRegistered(iThread, iSoftStartIndex, iSoftEndIndex);
+
+	Synchronize(iThread);
+
+	if (iThread == 0)
 	{
-		// Repopulate the spatial manager with the particles
-		SpatialPartition::GetInstance().RegisterObject((BaseParticle*)m_ParticleManager->GetDeformableParticle(index));
+		fluidGrid.PrefixSum();
+		spatialPartition.PrefixSumRegistered();
+
+		m_Neighbors.Begin(m_Particles.Size(), m_Scheduler.GetChunkCount(m_Particles.Size()));
+
+		m_iNeighborListParticleCount = m_Particles.Size();
+		m_bNeighborListsValid = true;
 	}
+
+	Synchronize(iThread);
+
+	fluidGrid.Scatter(iThread, m_Particles.CellIDs.data(), nullptr, iStartIndex, iEndIndex);
+	spatialPartition.ScatterRegistered(iThread, iSoftStartIndex, iSoftEndIndex);
+
+	Synchronize(iThread);
 }
 
 // ------------------------------------------------------------------------
 
-void FluidSimulation::XSPH_Viscosity(FluidParticle* particle)
+void FluidSimulation::ReorderParticles()
 {
-	std::vector<int>& fluidNeighborList = particle->GetFluidNeighbors();
-	unsigned int fluidNeighborCount = fluidNeighborList.size();
+	unsigned int iParticleCount = m_Particles.Size();
+	glm::vec2 localOffset(WALL_LEFTLIMIT, WALL_TOPLIMIT);
 
-	// XSPH viscosity
+	// Sort key - Morton code of the particle cell in the high bits, current index in the low bits
+	// so that particles sharing a cell keep their relative order
+	m_ReorderKeys.resize(iParticleCount);
+	for (unsigned int index = 0; index < iParticleCount; index++)
+	{
+		unsigned long long iMortonCode = SpatialPartition::ComputeMortonCode(m_Particles.Position[index] - localOffset);
+		m_ReorderKeys[index] = (iMortonCode << 32) | index;
+	}
 
-	// Velocity accumulator
-	glm::vec2 accumulatorVelocity = glm::vec2(0.0f);
+	std::sort(m_ReorderKeys.begin(), m_ReorderKeys.end());
 
-	for (unsigned int i = 0; i < fluidNeighborCount; i++)
+	m_ReorderPermutation.resize(iParticleCount);
+	for (unsigned int index = 0; index < iParticleCount; index++)
 	{
-		// Get the current neighbor particle
-		FluidParticle* p = (FluidParticle*)m_ParticleManager->GetParticle(fluidNeighborList[i]);
-
-		// Use poly6 smoothing kernel
-		accumulatorVelocity += (Poly6Kernel(particle->PredictedPosition, p->PredictedPosition) * (particle->Velocity - p->Velocity));
+		m_ReorderPermutation[index] = (unsigned int)(m_ReorderKeys[index] & 0xffffffff);
 	}
 
-	// Add the accumulated velocity to implement XSPH
-	particle->Velocity += m_fXSPHParam * accumulatorVelocity;
+	m_Particles.Reorder(m_ReorderPermutation);
+
+	// The neighbor lists refer to the old indices
+	m_bNeighborListsValid = false;
 }
 
 // ------------------------------------------------------------------------
 
-void FluidSimulation::ComputeParticleConstraint(FluidParticle* particle)
+bool FluidSimulation::NeighborListsExpired()
 {
-	// Calculate the particle density using the standard SPH density estimator
-	float fAccFluid = 0.0f;
-	float fAccSoft = 0.0f;
-	float fSampleDensityDifference = 1.0;
+	if (!m_bNeighborListsValid || !m_bReuseNeighborLists)
+	{
+		return true;
+	}
 
-	std::vector<int>& fluidNeighborList = particle->GetFluidNeighbors();
-	std::vector<int>& softNeighborList = particle->GetSoftNeighbors();
-	unsigned int fluidNeighborCount = fluidNeighborList.size();
-	unsigned int softNeighborCount = softNeighborList.size();
+	// Particles were added or removed since the last build
+	if (m_iNeighborListParticleCount != m_Particles.Size() ||
+		m_SoftNeighborListPositions.size() != m_ParticleManager->GetDeformableParticles().size())
+	{
+		return true;
+	}
+
+	// The lists stay valid as long as no pair of particles got closer by more than the skin,
+	// i.e. no particle moved more than half the skin since the lists were built
+	float fHalfSkin = 0.5f * m_fNeighborSkin;
 
-	for (unsigned int i = 0; i < fluidNeighborCount; i++)
+	// The lists are used by the solver iterations after this check, and they move the fluid particles
+	// further. Keep as much of the half skin as they moved a particle in the last step for them.
+	float fSolverDisplacement = 0.0f;
+	for (unsigned int i = 0; i < m_SolverDisplacements.size(); i++)
 	{
-		fAccFluid += Poly6Kernel(particle->PredictedPosition, m_ParticleManager->GetParticle(fluidNeighborList[i])->PredictedPosition);
+		fSolverDisplacement = std::max(fSolverDisplacement, m_SolverDisplacements[i]);
 	}
 
-	for (unsigned int i = 0; i < softNeighborCount; i++)
+	float fMaxFluidDisplacement = fHalfSkin - fSolverDisplacement;
+	if (fMaxFluidDisplacement <= 0.0f)
 	{
-		fAccSoft += Poly6Kernel(particle->PredictedPosition, m_ParticleManager->GetParticle(softNeighborList[i])->PredictedPosition);
+		return true;
 	}
 
-	// Update the particle SPH density
-	particle->SPHDensity = fAccFluid + fSampleDensityDifference * fAccSoft;
+	float fMaxFluidDisplacement2 = fMaxFluidDisplacement * fMaxFluidDisplacement;
 
-	// Calculate and update the particle density constraint value
-	particle->DensityConstraint = particle->SPHDensity * INVERSE_WATER_RESTDENSITY - 1.0f;
+	for (unsigned int index = 0; index < m_Particles.Size(); index++)
+	{
+		glm::vec2 displacement = m_Particles.PredictedPosition[index] - m_Particles.NeighborListPosition[index];
+		if (glm::dot(displacement, displacement) > fMaxFluidDisplacement2)
+		{
+			return true;
+		}
+	}
+
+	// The deformable particles don't move during the fluid step
+	float fMaxSoftDisplacement2 = fHalfSkin * fHalfSkin;
+
+	for (unsigned int index = 0; index < m_SoftNeighborListPositions.size(); index++)
+	{
+		glm::vec2 displacement = m_ParticleManager->GetDeformableParticle(index)->Position - m_SoftNeighborListPositions[index];
+		if (glm::dot(displacement, displacement) > fMaxSoftDisplacement2)
+		{
+			return true;
+		}
+	}
+
+	return false;
 }
 
 // ------------------------------------------------------------------------
 
-glm::vec2 FluidSimulation::ComputeParticleGradientConstraint(FluidParticle* particle, FluidParticle* neighbor)
+void FluidSimulation::UpdateNeighbors(unsigned int iParticleIndex, unsigned int iChunk)
 {
-	// Calculate the gradient of the constraint function - Monaghan 1992
-	// SPH recipe for the gradient of the constraint function with respect
-	// to a particle k
+	// The row is appended to the staging buffer of the chunk: fluid neighbors first, then deformable ones
+	std::vector<int>& neighborBuffer = m_Neighbors.GetChunkBuffer(iChunk);
+	unsigned int iRowStart = neighborBuffer.size();
 
-	std::vector<int>& fluidNeighborList = particle->GetFluidNeighbors();
-	unsigned int fluidNeighborCount = fluidNeighborList.size();
+	const glm::vec2& position = m_Particles.PredictedPosition[iParticleIndex];
+	glm::vec2 localOffset(WALL_LEFTLIMIT, WALL_TOPLIMIT);
 
-	// If the particle k is a neighboring particle
-	if (particle->Index == neighbor->Index) // k = i
-	{
-		// Accumulator for the gradient
-		glm::vec2 acc = glm::vec2(0.0f);
+	// Search for particles within the smoothing distance plus the skin
+	float fSearchRadius = SMOOTHING_DISTANCE + m_fNeighborSkin;
+	float fSearchRadius2 = fSearchRadius * fSearchRadius;
+
+	int iMinColumn, iMaxColumn, iMinRow, iMaxRow;
+	SpatialPartition::ComputeCellRange(position - localOffset, fSearchRadius, iMinColumn, iMaxColumn, iMinRow, iMaxRow);
 
-		for (unsigned int i = 0; i < fluidNeighborCount; i++)
+	// Update neighbors
+	const UniformGrid& fluidGrid = SpatialPartition::GetInstance().GetFluidGrid();
+	const UniformGrid& softGrid = SpatialPartition::GetInstance().GetSoftGrid();
+
+	const int* pFluidEntries = fluidGrid.GetEntries();
+	const int* pSoftEntries = softGrid.GetEntries();
+
+	// Fluid particles
+	for (int iRow = iMinRow; iRow <= iMaxRow; iRow++)
+	{
+		for (int iColumn = iMinColumn; iColumn <= iMaxColumn; iColumn++)
 		{
-			// Get the current neighbor particle
-			FluidParticle* p = (FluidParticle*)m_ParticleManager->GetParticle(fluidNeighborList[i]);
+			int iCellID = iColumn + iRow * CELL_COLS;
 
-			// Calculate the sum of all gradients between the particle and its neighbors
-			acc += SpikyKernelGradient(particle->PredictedPosition, p->PredictedPosition);
+			unsigned int iFluidEnd = fluidGrid.GetCellEnd(iCellID);
+			for (unsigned int index = fluidGrid.GetCellStart(iCellID); index < iFluidEnd; index++)
+			{
+				int iNeighborIndex = pFluidEntries[index];
+				glm::vec2 r = m_Particles.PredictedPosition[iNeighborIndex] - position;
+
+				if (iNeighborIndex != (int)iParticleIndex && glm::dot(r, r) < fSearchRadius2)
+				{
+					neighborBuffer.push_back(iNeighborIndex);
+				}
+			}
 		}
+	}
 
-		acc *= INVERSE_WATER_RESTDENSITY;
+	unsigned int iFluidCount = neighborBuffer.size() - iRowStart;
 
-		return acc;
-	}
-	else // k = j Particle k is not a neighboring particle
+	// Deformable particles
+	for (int iRow = iMinRow; iRow <= iMaxRow; iRow++)
 	{
-		// Calculate the gradient 
-		glm::vec2 gradient = SpikyKernelGradient(particle->PredictedPosition, neighbor->PredictedPosition);
-		gradient *= (-1.0f * INVERSE_WATER_RESTDENSITY);
+		for (int iColumn = iMinColumn; iColumn <= iMaxColumn; iColumn++)
+		{
+			int iCellID = iColumn + iRow * CELL_COLS;
+
+			unsigned int iSoftEnd = softGrid.GetCellEnd(iCellID);
+			for (unsigned int index = softGrid.GetCellStart(iCellID); index < iSoftEnd; index++)
+			{
+				int iNeighborIndex = pSoftEntries[index];
+				glm::vec2 r = m_ParticleManager->GetParticle(iNeighborIndex)->Position - position;
 
-		return gradient;
+				if (glm::dot(r, r) < fSearchRadius2)
+				{
+					neighborBuffer.push_back(iNeighborIndex);
+				}
+			}
+		}
 	}
+
+	unsigned int iSoftCount = neighborBuffer.size() - iRowStart - iFluidCount;
+
+	m_Neighbors.SetRowCounts(iParticleIndex, iFluidCount, iSoftCount);
 }
 
 // ------------------------------------------------------------------------
 
-void FluidSimulation::ComputeLambda(FluidParticle* particle)
+glm::vec2 FluidSimulation::XSPH_Viscosity(unsigned int iParticleIndex)
 {
-	std::vector<int>& fluidNeighborList = particle->GetFluidNeighbors();
-	unsigned int fluidNeighborCount = fluidNeighborList.size();
+	NeighborSpan fluidNeighborList = m_Neighbors.GetFluidNeighbors(iParticleIndex);
 
-	float acc = 0.0f;
+	const glm::vec2& predictedPosition = m_Particles.PredictedPosition[iParticleIndex];
+	const glm::vec2& velocity = m_Particles.Velocity[iParticleIndex];
 
-	// k = i
-	glm::vec2 gradient = ComputeParticleGradientConstraint(particle, particle);
-	float fGradientLength = glm::length(gradient);
-	acc += fGradientLength * fGradientLength;
+	// XSPH viscosity - poly6 weighted sum of the velocity differences
+	glm::vec2 accumulatorVelocity = m_pKernels->XSPHViscosity(m_KernelParams, predictedPosition, velocity,
+		m_Particles.PredictedPosition.data(), m_Particles.Velocity.data(),
+		fluidNeighborList.begin(), fluidNeighborList.size());
 
-	// k = j
-	for (unsigned int i = 0; i < fluidNeighborCount; i++)
-	{
-		glm::vec2 grad = ComputeParticleGradientConstraint(particle, (FluidParticle*)m_ParticleManager->GetParticle(fluidNeighborList[i]));
-		float fGradLength = glm::length(grad);
-		acc += fGradLength * fGradLength;
-	}
-
-	// Calculate the lambda value for the current particle
-	particle->Lambda = (-1.0f) * particle->DensityConstraint / (acc + RELAXATION_PARAMETER);
+	// Velocity change which implements XSPH
+	return m_fXSPHParam * accumulatorVelocity;
 }
 
 // ------------------------------------------------------------------------
 
-void FluidSimulation::ComputePositionCorrection(FluidParticle* particle)
+void FluidSimulation::ComputeDensityAndLambda(unsigned int iParticleIndex)
 {
-	std::vector<int>& fluidNeighborList = particle->GetFluidNeighbors();
-	unsigned int fluidNeighborCount = fluidNeighborList.size();
+	// One sweep over the neighbors computes the SPH density, the gradient of the density constraint
+	// with respect to the particle itself (k = i) and the sum of the squared gradients with respect
+	// to each neighbor (k = j) - Monaghan 1992. The per-pair kernel values are cached for the
+	// position correction pass.
+	NeighborSpan fluidNeighborList = m_Neighbors.GetFluidNeighbors(iParticleIndex);
+	NeighborSpan softNeighborList = m_Neighbors.GetSoftNeighbors(iParticleIndex);
+	unsigned int softNeighborCount = softNeighborList.size();
 
-	glm::vec2 acc = glm::vec2(0.0f);
+	const glm::vec2& predictedPosition = m_Particles.PredictedPosition[iParticleIndex];
 
-	// Calculate the delta position using the gradient of the kernel and the lambda values for each particle
-	for (unsigned int i = 0; i < fluidNeighborCount; i++)
-	{
-		// Get the current particle
-		FluidParticle* pCurrentNeighborParticle = (FluidParticle*)m_ParticleManager->GetParticle(fluidNeighborList[i]);
+	glm::vec2* pPairGradient = m_PairGradient.data() + m_Neighbors.GetRowOffset(iParticleIndex);
+	float* pPairKernel = m_PairKernel.data() + m_Neighbors.GetRowOffset(iParticleIndex);
 
-		glm::vec2 gradient = SpikyKernelGradient(particle->PredictedPosition, pCurrentNeighborParticle->PredictedPosition);
+	float fAccSoft = 0.0f;
+	float fSampleDensityDifference = 1.0;
 
-		// Add an artificial pressure term which improves the particle distribution, creates surface tension, and
-		// lowers the neighborhood requirements of traditional SPH
-		if (ARTIFICIAL_PRESSURE_TERM)
-		{
-			float fArtifficialPressure = ComputeArtificialPressureTerm(particle, pCurrentNeighborParticle);
-			acc += gradient * (particle->Lambda + pCurrentNeighborParticle->Lambda + fArtifficialPressure);
-		}
-		else
-		{
-			acc += gradient * (particle->Lambda + pCurrentNeighborParticle->Lambda);
-		}
+	DensitySums sums;
+	m_pKernels->Density(m_KernelParams, predictedPosition, m_Particles.PredictedPosition.data(),
+		fluidNeighborList.begin(), fluidNeighborList.size(), pPairKernel, pPairGradient, sums);
+
+	// Deformable particles are stored as AoS and there are few of them
+	for (unsigned int i = 0; i < softNeighborCount; i++)
+	{
+		fAccSoft += Poly6Kernel(predictedPosition, m_ParticleManager->GetParticle(softNeighborList[i])->PredictedPosition);
 	}
 
-	// Scale the acc by the inverse of the rest density
-	particle->PositionCorrection = acc * INVERSE_WATER_RESTDENSITY * particle->Mass;
+	// Update the particle SPH density
+	m_Particles.SPHDensity[iParticleIndex] = sums.Density + fSampleDensityDifference * fAccSoft;
+
+	// Calculate and update the particle density constraint value
+	float fDensityConstraint = m_Particles.SPHDensity[iParticleIndex] * INVERSE_WATER_RESTDENSITY - 1.0f;
+	m_Particles.DensityConstraint[iParticleIndex] = fDensityConstraint;
+
+	// k = i
+	glm::vec2 selfGradient = sums.SelfGradient * INVERSE_WATER_RESTDENSITY;
+	float fGradientSum = glm::dot(selfGradient, selfGradient) + sums.GradientLength2;
+
+	// Calculate the lambda value for the current particle
+	m_Particles.Lambda[iParticleIndex] = (-1.0f) * fDensityConstraint / (fGradientSum + RELAXATION_PARAMETER);
 }
 
 // ------------------------------------------------------------------------
 
-float FluidSimulation::ComputeArtificialPressureTerm(const FluidParticle* p1, const FluidParticle* p2)
+void FluidSimulation::ComputePositionCorrection(unsigned int iParticleIndex)
 {
-	// Calculate an artificial pressure term which solves the problem of a particle having to few
-	// neighbors which results in negative pressure. The ARTIFICIAL_PRESSURE constant is the value
-	// of the kernel function at some fixed point inside the smoothing radius 
-	float fKernelValue = Poly6Kernel(p1->PredictedPosition, p2->PredictedPosition);
+	NeighborSpan fluidNeighborList = m_Neighbors.GetFluidNeighbors(iParticleIndex);
+
+	// Kernel values computed by the density pass - the predicted positions have not changed since
+	const glm::vec2* pPairGradient = m_PairGradient.data() + m_Neighbors.GetRowOffset(iParticleIndex);
+	const float* pPairKernel = m_PairKernel.data() + m_Neighbors.GetRowOffset(iParticleIndex);
 
-	return (-0.1f) * pow(fKernelValue * INVERSE_ARTIFICIAL_PRESSURE, 4.0f);
+	// Calculate the delta position using the gradient of the kernel and the lambda values for each particle.
+	// The artificial pressure term improves the particle distribution, creates surface tension, and
+	// lowers the neighborhood requirements of traditional SPH.
+	glm::vec2 acc = m_pKernels->PositionCorrection(m_KernelParams, m_Particles.Lambda[iParticleIndex],
+		m_Particles.Lambda.data(), fluidNeighborList.begin(), fluidNeighborList.size(),
+		pPairKernel, pPairGradient);
+
+	// Scale the acc by the inverse of the rest density
+	m_Particles.PositionCorrection[iParticleIndex] = acc * INVERSE_WATER_RESTDENSITY * PARTICLE_MASS;
 }
 
 // ------------------------------------------------------------------------
@@ -775,28 +1062,28 @@ float FluidSimulation::ComputeArtificialPressureTerm(const FluidParticle* p1, co
 void FluidSimulation::ContainerCollisionUpdate()
 {
 	// Collision detection against the container 
-	for (auto it = m_ParticleList.begin(); it != m_ParticleList.end(); it++)
+	for (unsigned int iParticleIndex = 0; iParticleIndex < m_Particles.Size(); iParticleIndex++)
 	{
-		FluidParticle* pCurrentParticle = *it;
+		FluidParticle currentParticle(m_Particles, iParticleIndex);
 
 		// Wall collision response
-		glm::vec2 currentVelocity = pCurrentParticle->Velocity;
+		glm::vec2 currentVelocity = currentParticle.Velocity();
 
-		if (pCurrentParticle->PredictedPosition.x < PARTICLE_LEFTLIMIT || pCurrentParticle->PredictedPosition.x > PARTICLE_RIGHTLIMIT)
+		if (currentParticle.PredictedPosition().x < PARTICLE_LEFTLIMIT || currentParticle.PredictedPosition().x > PARTICLE_RIGHTLIMIT)
 		{
-			pCurrentParticle->Velocity = glm::vec2(-currentVelocity.x, currentVelocity.y);
+			currentParticle.Velocity() = glm::vec2(-currentVelocity.x, currentVelocity.y);
 		}
 
-		if (pCurrentParticle->PredictedPosition.y < PARTICLE_TOPLIMIT || pCurrentParticle->PredictedPosition.y > PARTICLE_BOTTOMLIMIT)
+		if (currentParticle.PredictedPosition().y < PARTICLE_TOPLIMIT || currentParticle.PredictedPosition().y > PARTICLE_BOTTOMLIMIT)
 		{
-			pCurrentParticle->Velocity = glm::vec2(currentVelocity.x, -currentVelocity.y);
+			currentParticle.Velocity() = glm::vec2(currentVelocity.x, -currentVelocity.y);
 		}
 
 		// Clamp position inside the container
-		glm::vec2 currentPosition = pCurrentParticle->Position;
+		glm::vec2 currentPosition = currentParticle.Position();
 		currentPosition.x = glm::clamp(currentPosition.x, PARTICLE_LEFTLIMIT + 1.0f, PARTICLE_RIGHTLIMIT - 1.0f);
 		currentPosition.y = glm::clamp(currentPosition.y, PARTICLE_TOPLIMIT + 1.0f, PARTICLE_BOTTOMLIMIT - 1.0f);
-		pCurrentParticle->Position = currentPosition;
+		currentParticle.Position() = currentPosition;
 	}
 }
 
@@ -826,6 +1113,38 @@ std::string FluidSimulation::GetPropertyString(Settings property)
 			return "Viscosity: " + std::to_string(m_fXSPHParam) + "\n";
 		}
 		break;
+	case FluidSimulation::Settings::NeighborSkin:
+		if (m_iCurrentSetting == 2)
+		{
+			return "NEIGHBOR SKIN: " + std::to_string(m_fNeighborSkin) + "\n";
+		}
+		else
+		{
+			return "Neighbor skin: " + std::to_string(m_fNeighborSkin) + "\n";
+		}
+		break;
+	case FluidSimulation::Settings::ReorderInterval:
+		if (m_iCurrentSetting == 3)
+		{
+			return "REORDER INTERVAL: " + std::to_string(m_iReorderInterval) + "\n";
+		}
+		else
+		{
+			return "Reorder interval: " + std::to_string(m_iReorderInterval) + "\n";
+		}
+		break;
+#ifdef MULTITHREADING
+	case FluidSimulation::Settings::ThreadCount:
+		if (m_iCurrentSetting == 4)
+		{
+			return "THREAD COUNT: " + std::to_string(m_iThreadCount) + "\n";
+		}
+		else
+		{
+			return "Thread count: " + std::to_string(m_iThreadCount) + "\n";
+		}
+		break;
+#endif // MULTITHREADING
 	case FluidSimulation::Settings::Invalid:
 	default:
 		return std::string();
@@ -840,41 +1159,25 @@ std::string FluidSimulation::GetPropertyString(Settings property)
 // Multithreading helper methods ------------------------------------------
 // ------------------------------------------------------------------------
 
-#ifdef MULTITHREADING
-
-void FluidSimulation::ComputeLambdaMultithread(int iStartIndex, int iEndIndex)
+void FluidSimulation::GetRange(unsigned int iThread, unsigned int iCount, unsigned int& iStartIndex, unsigned int& iEndIndex)
 {
-	for (int i = iStartIndex; i < iEndIndex; i++)
-	{
-		ComputeLambda(m_ParticleList[i]);
-	}
-}
+	// Contiguous ranges, the last thread also takes the remainder
+	unsigned int iThreadCount = GetSolverThreadCount();
+	unsigned int iStep = iCount / iThreadCount;
 
-void FluidSimulation::PositionCorrectionMultithread(int iStartIndex, int iEndIndex)
-{
-	for (int i = iStartIndex; i < iEndIndex; i++)
-	{
-		ComputePositionCorrection(m_ParticleList[i]);
-	}
+	iStartIndex = iStep * iThread;
+	iEndIndex = (iThread == iThreadCount - 1) ? iCount : iStep * (iThread + 1);
 }
 
-void FluidSimulation::ComputeParticleConstraintMultithread(int iStartIndex, int iEndIndex)
-{
-	for (int i = iStartIndex; i < iEndIndex; i++)
-	{
-		ComputeParticleConstraint(m_ParticleList[i]);
-	}
-}
+// ------------------------------------------------------------------------
 
-void FluidSimulation::ComputeMTDMultithread(int iStartIndex, int iEndIndex)
+void FluidSimulation::Synchronize(unsigned int iThread)
 {
-	for (int i = iStartIndex; i < iEndIndex; i++)
-	{
-		m_ParticleList[i]->CalculateMinimumTranslationDistance();
-	}
-}
+#ifdef MULTITHREADING
+	PROFILE_THREAD_SCOPE(ProfilePhase::BarrierWait, iThread);
 
+	m_WorkerTeam->Barrier(iThread);
 #endif // MULTITHREADING
-
+}
 
 // ------------------------------------------------------------------------
\ No newline at end of file
@@ -4,17 +4,28 @@
 #include <iostream>
 #include <vector>
 #include <memory>
+#include <algorithm>
 
 #include "Common.h"
+#include "FluidParticleStore.h"
 #include "FluidParticle.h"
+#include "NeighborTable.h"
+#include "FluidKernels.h"
+#include "ChunkScheduler.h"
 #include "DeformableParticle.h"
+#include "ParticleManager.h"
 #include "SpatialPartition.h"
 #include "BaseSimulation.h"
+
+#ifndef HEADLESS
 #include "Stats.h"
+#endif // HEADLESS
 
 // Multithreading
 #ifdef MULTITHREADING
-#include <boost/threadpool.hpp>
+#include "WorkerTeam.h"
+#else
+class WorkerTeam;
 #endif // MULTITHREADING
 
 // Forward declaration
@@ -33,7 +44,7 @@ public:
 		glm::vec2 projectionPoint;
 	};
 
-	FluidSimulation(const sf::Font& font)
+	FluidSimulation()
 	{
 		srand((unsigned int)time(NULL));
 
@@ -44,15 +55,49 @@ public:
 		SimType = SimulationType::FluidSimulation;
 
 #ifdef MULTITHREADING
-		m_ThreadPool = nullptr;
+		m_WorkerTeam = nullptr;
+		m_iThreadCount = GetDefaultThreadCount();
 #endif // MULTITHREADING
 
-		m_FluidStats = new Stats(font, WindowResolution.x - 250.0f, 20.0f, 30, sf::Color::Red);
+#ifndef HEADLESS
+		m_FluidStats = nullptr;
+
+		// Shape used to draw all the fluid particles
+		m_ParticleShape.setRadius(PARTICLE_RADIUS);
+		m_ParticleShape.setOrigin(m_ParticleShape.getLocalBounds().width / 2.0f,
+			m_ParticleShape.getLocalBounds().height / 2.0f);
+		m_ParticleShape.setOutlineThickness(0.0f);
+#endif // HEADLESS
 		
 		m_Properties.push_back(Settings::VelocityDamping);
 		m_Properties.push_back(Settings::Viscosity);
+		m_Properties.push_back(Settings::NeighborSkin);
+		m_Properties.push_back(Settings::ReorderInterval);
+#ifdef MULTITHREADING
+		m_Properties.push_back(Settings::ThreadCount);
+#endif // MULTITHREADING
+
+		// Batch kernels
+		m_KernelParams.SmoothingDistance = SMOOTHING_DISTANCE;
+		m_KernelParams.SmoothingDistance2 = SMOOTHING_DISTANCE2;
+		m_KernelParams.Poly6Coeff = POLY6COEFF;
+		m_KernelParams.SpikyGradCoeff = SPIKYGRADCOEFF;
+		m_KernelParams.InverseRestDensity = INVERSE_WATER_RESTDENSITY;
+		m_KernelParams.InverseArtificialPressure = INVERSE_ARTIFICIAL_PRESSURE;
+		m_KernelParams.ArtificialPressure = ARTIFICIAL_PRESSURE_TERM;
+
+		m_pKernels = &GetFluidKernels();
 	};
 
+#ifndef HEADLESS
+
+	// Simulation with the stats overlay
+	explicit FluidSimulation(const sf::Font& font)
+		: FluidSimulation()
+	{
+		m_FluidStats = new Stats(font, WindowResolution.x - 250.0f, 20.0f, 30, sf::Color::Red);
+	}
+
 	~FluidSimulation()
 	{
 		if (m_FluidStats)
@@ -62,12 +107,20 @@ public:
 		}
 	}
 
-	void Update(sf::RenderWindow& window, float dt);
+#endif // HEADLESS
+
+	void Update(float dt);
+
+#ifndef HEADLESS
+	// Rendering only reads the particle state
 	void Draw(sf::RenderWindow& window);
+#endif // HEADLESS
 
 	void InputUpdate(float delta, int navigation) override;
 
 	void BuildParticleSystem(const glm::vec2& startPosition, const sf::Color& color);
+	// Block of iWidthCount particles per row and iHeightCount rows
+	void BuildParticleSystem(const glm::vec2& startPosition, const sf::Color& color, int iWidthCount, int iHeightCount);
 #ifdef MULTITHREADING
 	void SetupMultithread();
 
@@ -75,14 +128,63 @@ public:
 #endif // MULTITHREADING
 
 	glm::vec2 GetRandomPosWithinLimits();
-	inline const std::vector<FluidParticle*>& GetFluidParticleList() { return m_ParticleList; }
+	inline const FluidParticleStore& GetParticleStore() const { return m_Particles; }
+	void RestoreParticleStore(const FluidParticleStore& particles);
+	inline FluidParticle GetFluidParticle(unsigned int iIndex) { return FluidParticle(m_Particles, iIndex); }
 	
 #ifdef MULTITHREADING
 	inline const unsigned int GetThreadCount() { return m_iThreadCount; }
+
+	// Number of threads used by the solver. The worker team is resized at the start of the next step.
+	inline void SetThreadCount(unsigned int iThreadCount) { m_iThreadCount = std::max(iThreadCount, 1u); }
+
+	// PBD_THREAD_COUNT environment variable if set, the number of hardware threads otherwise
+	static unsigned int GetDefaultThreadCount();
+
+	// Time spent rebuilding the fluid and deformable grids during the last step (0 if they were reused), in seconds
+	inline double GetGridBuildTime() const { return m_fGridBuildTime; }
+
+	// Time each thread spent working and waiting during the last step, in seconds
+	inline double GetThreadBusyTime(unsigned int iThread) const { return m_WorkerTeam->GetBusyTime(iThread); }
+	inline double GetThreadIdleTime(unsigned int iThread) const { return m_WorkerTeam->GetIdleTime(iThread); }
+
+	// Team of the solver threads, the soft bodies are stepped on it too. Null before the first step.
+	inline WorkerTeam* GetWorkerTeam() { return m_WorkerTeam.get(); }
+#else
+	inline WorkerTeam* GetWorkerTeam() { return nullptr; }
 #endif // MULTITHREADING
-	inline const unsigned int GetPaticleCount() { return m_ParticleList.size(); }
+	inline const unsigned int GetPaticleCount() { return m_Particles.Size(); }
+
+	// Neighbor lists hold all the particles within the smoothing distance plus the skin.
+	// With reuse enabled they are kept across frames until a particle moves more than half the skin.
+	// The check runs before the solver iterations, which move the fluid particles further. The
+	// distance they moved them in the last step is kept out of the half skin for that, so the skin
+	// must be more than twice as large as it for the lists to be reused at all.
+	inline void SetNeighborSkin(float fSkin) { m_fNeighborSkin = std::max(fSkin, 0.0f); m_bNeighborListsValid = false; }
+	inline const float GetNeighborSkin() const { return m_fNeighborSkin; }
+	inline void SetNeighborListReuse(bool bReuse) { m_bReuseNeighborLists = bReuse; }
+
+	// Particles are sorted along a Z-order curve every given number of steps, 0 disables the reordering
+	inline void SetReorderInterval(unsigned int iInterval) { m_iReorderInterval = iInterval; }
+	inline const unsigned int GetReorderInterval() const { return m_iReorderInterval; }
+
+	// Deterministic mode - the chunks of the parallel phases are not stolen, so for a given
+	// thread count the per-thread sums, and the whole step, are the same from run to run
+	inline void SetDeterministic(bool bDeterministic) { m_Scheduler.SetStealing(!bDeterministic); }
+	inline bool IsDeterministic() const { return !m_Scheduler.IsStealing(); }
+
+	// SIMD implementation used by the density, position correction and viscosity passes
+	inline void SetKernels(const FluidKernelSet& kernels) { m_pKernels = &kernels; }
+	inline const FluidKernelSet& GetKernels() const { return *m_pKernels; }
+
+	inline const NeighborTable& GetNeighborTable() const { return m_Neighbors; }
+	inline NeighborSpan GetFluidNeighbors(unsigned int iIndex) const { return m_Neighbors.GetFluidNeighbors(iIndex); }
+	inline NeighborSpan GetSoftNeighbors(unsigned int iIndex) const { return m_Neighbors.GetSoftNeighbors(iIndex); }
 
 private:
+	// The microbenchmarks time the kernels and the neighbor search on their own
+	friend struct MicrobenchmarkAccess;
+
 
 	// -------------------------------------------------------------------------------
 	// Multithreading ----------------------------------------------------------------
@@ -90,14 +192,11 @@ private:
 
 #ifdef MULTITHREADING
 	
-	std::unique_ptr<boost::threadpool::pool> m_ThreadPool;
-	typedef boost::function<void()> Task;
-	std::vector<Task> LambdaTaskList;
-	std::vector<Task> PositionCorrectionTaskList;
-	std::vector<Task> ParticleConstraintTaskList;
-	std::vector<Task> MinTransDistanceTaskList;
+	// Persistent threads running the whole update, one phase after the other
+	std::unique_ptr<WorkerTeam> m_WorkerTeam;
+	WorkerTeam::Job m_UpdateJob;
 
-	unsigned int m_iThreadCount = 4;
+	unsigned int m_iThreadCount = 1;
 
 #endif // MULTITHREADING
 
@@ -105,6 +204,9 @@ private:
 	{
 		VelocityDamping,
 		Viscosity,
+		NeighborSkin,
+		ReorderInterval,
+		ThreadCount,
 
 		Invalid,
 	};
@@ -120,6 +222,24 @@ private:
 	float m_fVelocityDamping	= 0.999f;
 	float m_fXSPHParam			= -30.0f;
 
+	// Neighbor list cache
+	float m_fNeighborSkin			= PARTICLE_RADIUS;
+	bool m_bReuseNeighborLists		= true;
+	bool m_bNeighborListsValid		= false;
+	unsigned int m_iNeighborListParticleCount = 0;
+
+	// Deformable particle positions at the time the neighbor lists were built
+	std::vector<glm::vec2> m_SoftNeighborListPositions;
+
+	// Largest distance the solver iterations of the last step moved a particle, per thread
+	std::vector<float> m_SolverDisplacements;
+
+	// Spatial reordering of the particles
+	unsigned int m_iReorderInterval		= 60;
+	unsigned int m_iStepsSinceReorder	= 0;
+	std::vector<unsigned long long> m_ReorderKeys;
+	std::vector<unsigned int> m_ReorderPermutation;
+
 	// Constants
 	const bool XSPH_VISCOSITY = true;
 	const bool ARTIFICIAL_PRESSURE_TERM = true;
@@ -154,44 +274,80 @@ private:
 
 	// -------------------------------------------------------------------------------
 
-	std::vector<FluidParticle*> m_ParticleList;
-	std::vector<ContainerConstraint> m_ContainerConstraints;
+	// Fluid particle state - structure of arrays
+	FluidParticleStore m_Particles;
+	NeighborTable m_Neighbors;
+
+	// Spiky kernel gradient and poly6 kernel value of every fluid neighbor pair, laid out like the neighbor table
+	AlignedVector<glm::vec2> m_PairGradient;
+	AlignedVector<float> m_PairKernel;
+
+	FluidKernelParams m_KernelParams;
+	const FluidKernelSet* m_pKernels;
+
+	// Position corrections of the deformable particles accumulated by each thread, indexed by the global particle index
+	std::vector<std::vector<glm::vec2>> m_SoftPositionCorrections;
+
+	// XSPH velocity change of each particle
+	AlignedVector<glm::vec2> m_ViscosityVelocity;
+
+	// Distributes the particles of the neighbor dependent phases between the threads
+	ChunkScheduler m_Scheduler;
+
+	// State shared by the threads during the update
+	float m_fTimeStep = 0.0f;
+	double m_fGridBuildTime = 0.0;
+	bool m_bRebuildNeighborLists = false;
+
+#ifndef HEADLESS
+	sf::CircleShape m_ParticleShape;
 
 	Stats* m_FluidStats;
 
+	void UpdateStats();
+#endif // HEADLESS
+
 	ParticleManager* m_ParticleManager;
 
-	void DrawContainer(sf::RenderWindow& window);
+	// Update work of one thread - the particles in its range
+	void UpdateThread(unsigned int iThread);
 
-	void UpdateExternalForces(float dt);
-	void DampVelocities();
+	void UpdateExternalForces(unsigned int iStartIndex, unsigned int iEndIndex, float dt);
+	void DampVelocities(unsigned int iStartIndex, unsigned int iEndIndex);
 
-	void CalculatePredictedPositions(sf::RenderWindow& window, float dt);
+	void CalculatePredictedPositions(unsigned int iStartIndex, unsigned int iEndIndex, float dt);
 	
-	void FindNeighborParticles();
-
-	void UpdateActualPosAndVelocities(float dt);
-	void GenerateCollisionConstraints();
-	void XSPH_Viscosity(FluidParticle* particle);
+	void ReorderParticles();
+	bool NeighborListsExpired();
+	void FindNeighborParticles(unsigned int iThread, unsigned int iStartIndex, unsigned int iEndIndex);
+	void UpdateNeighbors(unsigned int iParticleIndex, unsigned int iChunk);
+
+	// Returns the largest distance the solver iterations moved a particle of the range
+	float UpdateActualPosAndVelocities(unsigned int iStartIndex, unsigned int iEndIndex, float dt);
+	unsigned int GenerateCollisionConstraints(unsigned int iParticleIndex, ContainerConstraint* pConstraints);
+	void SolveContainerConstraints(unsigned int iParticleIndex);
+	void SolveDeformableCollisions(unsigned int iFluidParticleIndex, unsigned int iThread);
+	glm::vec2 XSPH_Viscosity(unsigned int iParticleIndex);
 
 	// ------------------------------------------------------------------------
 
-	void ComputeParticleConstraint(FluidParticle* particle);
-	glm::vec2 ComputeParticleGradientConstraint(FluidParticle* particle, FluidParticle* neighbor);
-	void ComputeLambda(FluidParticle* particle);
-	void ComputePositionCorrection(FluidParticle* particle);
-	float ComputeArtificialPressureTerm(const FluidParticle* p1, const FluidParticle* p2);
+	void ComputeDensityAndLambda(unsigned int iParticleIndex);
+	void ComputePositionCorrection(unsigned int iParticleIndex);
 	void ContainerCollisionUpdate();
 
 	// ------------------------------------------------------------------------
 
-#ifdef MULTITHREADING
+	// Range of items processed by a thread
+	void GetRange(unsigned int iThread, unsigned int iCount, unsigned int& iStartIndex, unsigned int& iEndIndex);
+	inline void GetParticleRange(unsigned int iThread, unsigned int& iStartIndex, unsigned int& iEndIndex) { GetRange(iThread, m_Particles.Size(), iStartIndex, iEndIndex); }
 
-	void ComputeParticleConstraintMultithread(int iStartIndex, int iEndIndex);
-	void ComputeLambdaMultithread(int iStartIndex, int iEndIndex);
-	void PositionCorrectionMultithread(int iStartIndex, int iEndIndex);
-	void ComputeMTDMultithread(int iStartIndex, int iEndIndex);
+	// Barrier between two phases of the update
+	void Synchronize(unsigned int iThread);
 
+#ifdef MULTITHREADING
+	inline unsigned int GetSolverThreadCount() const { return m_WorkerTeam != nullptr ? m_WorkerTeam->GetThreadCount() : 1; }
+#else
+	inline unsigned int GetSolverThreadCount() const { return 1; }
 #endif // MULTITHREADING
 
 	// ------------------------------------------------------------------------
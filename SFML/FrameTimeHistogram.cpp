@@ -0,0 +1,190 @@
+#include "FrameTimeHistogram.h"
+
+#include <math.h>
+#include <algorithm>
+#include <limits>
+
+// ------------------------------------------------------------------------
+
+FrameTimeHistogram::FrameTimeHistogram()
+	: m_Buckets(BUCKET_COUNT, 0)
+{
+	Clear();
+}
+
+// ------------------------------------------------------------------------
+
+void FrameTimeHistogram::Clear()
+{
+	std::fill(m_Buckets.begin(), m_Buckets.end(), 0ULL);
+
+	m_iCount = 0;
+	m_iMin = std::numeric_limits<unsigned long long>::max();
+	m_iMax = 0;
+
+	m_fSum = 0.0;
+	m_fSumSquares = 0.0;
+	m_fSumDifferences = 0.0;
+	m_fLastFrameTime = 0.0;
+}
+
+// ------------------------------------------------------------------------
+
+unsigned int FrameTimeHistogram::GetBucketIndex(unsigned long long iValue)
+{
+	// Number of bits above the sub bucket resolution
+	unsigned int iMagnitude = 0;
+	while ((iValue >> iMagnitude) >= SUB_BUCKET_COUNT)
+	{
+		iMagnitude++;
+	}
+
+	// Above the first range the sub bucket is always in the upper half
+	return iMagnitude * SUB_BUCKET_HALF + (unsigned int)(iValue >> iMagnitude);
+}
+
+// ------------------------------------------------------------------------
+
+unsigned long long FrameTimeHistogram::GetBucketLowerBound(unsigned int iIndex)
+{
+	if (iIndex < SUB_BUCKET_COUNT)
+	{
+		return iIndex;
+	}
+
+	unsigned int iMagnitude = (iIndex - SUB_BUCKET_HALF) / SUB_BUCKET_HALF;
+	unsigned long long iSubBucket = iIndex - iMagnitude * SUB_BUCKET_HALF;
+
+	return iSubBucket << iMagnitude;
+}
+
+// ------------------------------------------------------------------------
+
+unsigned long long FrameTimeHistogram::GetBucketUpperBound(unsigned int iIndex)
+{
+	if (iIndex < SUB_BUCKET_COUNT)
+	{
+		return iIndex;
+	}
+
+	unsigned int iMagnitude = (iIndex - SUB_BUCKET_HALF) / SUB_BUCKET_HALF;
+
+	return GetBucketLowerBound(iIndex) + (1ULL << iMagnitude) - 1;
+}
+
+// ------------------------------------------------------------------------
+
+void FrameTimeHistogram::Record(double fFrameTime)
+{
+	// Microseconds, clamped to the range of the histogram before the conversion so that it can't overflow
+	unsigned long long iMaxValue = ((unsigned long long)SUB_BUCKET_COUNT << MAGNITUDE_COUNT) - 1;
+	double fMicroseconds = fFrameTime * 1000000.0;
+	fMicroseconds = fMicroseconds > 0.0 ? std::min(fMicroseconds, (double)iMaxValue) : 0.0;
+	unsigned long long iValue = std::min((unsigned long long)(fMicroseconds + 0.5), iMaxValue);
+
+	m_Buckets[GetBucketIndex(iValue)]++;
+
+	if (m_iCount > 0)
+	{
+		m_fSumDifferences += fabs(fFrameTime - m_fLastFrameTime);
+	}
+
+	m_iCount++;
+	m_iMin = std::min(m_iMin, iValue);
+	m_iMax = std::max(m_iMax, iValue);
+
+	m_fSum += fFrameTime;
+	m_fSumSquares += fFrameTime * fFrameTime;
+	m_fLastFrameTime = fFrameTime;
+}
+
+// ------------------------------------------------------------------------
+
+double FrameTimeHistogram::GetMaxRecordableTime()
+{
+	return (((unsigned long long)SUB_BUCKET_COUNT << MAGNITUDE_COUNT) - 1) / 1000000.0;
+}
+
+// ------------------------------------------------------------------------
+
+double FrameTimeHistogram::GetPercentile(double fPercentile) const
+{
+	if (m_iCount == 0)
+	{
+		return 0.0;
+	}
+
+	// Nearest rank
+	unsigned long long iRank = (unsigned long long)ceil(fPercentile / 100.0 * m_iCount);
+	iRank = std::min(std::max(iRank, 1ULL), m_iCount);
+
+	unsigned long long iCumulativeCount = 0;
+	for (unsigned int iIndex = 0; iIndex < BUCKET_COUNT; iIndex++)
+	{
+		iCumulativeCount += m_Buckets[iIndex];
+
+		if (iCumulativeCount >= iRank)
+		{
+			return std::min(GetBucketUpperBound(iIndex), m_iMax) / 1000000.0;
+		}
+	}
+
+	return m_iMax / 1000000.0;
+}
+
+// ------------------------------------------------------------------------
+
+double FrameTimeHistogram::GetMin() const
+{
+	return m_iCount > 0 ? m_iMin / 1000000.0 : 0.0;
+}
+
+// ------------------------------------------------------------------------
+
+double FrameTimeHistogram::GetMax() const
+{
+	return m_iMax / 1000000.0;
+}
+
+// ------------------------------------------------------------------------
+
+double FrameTimeHistogram::GetMean() const
+{
+	return m_iCount > 0 ? m_fSum / m_iCount : 0.0;
+}
+
+// ------------------------------------------------------------------------
+
+double FrameTimeHistogram::GetStandardDeviation() const
+{
+	if (m_iCount == 0)
+	{
+		return 0.0;
+	}
+
+	double fMean = GetMean();
+	return sqrt(std::max(m_fSumSquares / m_iCount - fMean * fMean, 0.0));
+}
+
+// ------------------------------------------------------------------------
+
+double FrameTimeHistogram::GetJitter() const
+{
+	return m_iCount > 1 ? m_fSumDifferences / (m_iCount - 1) : 0.0;
+}
+
+// ------------------------------------------------------------------------
+
+void FrameTimeHistogram::PrintBuckets(std::ostream& out) const
+{
+	for (unsigned int iIndex = 0; iIndex < BUCKET_COUNT; iIndex++)
+	{
+		if (m_Buckets[iIndex] > 0)
+		{
+			out << GetBucketLowerBound(iIndex) / 1000.0 << " - " << (GetBucketUpperBound(iIndex) + 1) / 1000.0 <<
+				" ms: " << m_Buckets[iIndex] << std::endl;
+		}
+	}
+}
+
+// ------------------------------------------------------------------------
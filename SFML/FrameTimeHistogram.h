@@ -0,0 +1,71 @@
+#ifndef FRAMETIMEHISTOGRAM_H
+#define FRAMETIMEHISTOGRAM_H
+
+#include <vector>
+#include <ostream>
+
+// ----------------------------------------------------------------------------
+// Fixed size histogram of frame times with a constant relative precision, in
+// the manner of HdrHistogram. Times are counted in microseconds: below 128 us
+// every microsecond has its own bucket, above that each power of two range is
+// split in 64 buckets, so a bucket is never wider than 1/64 of its values.
+// Recording is a few shifts and an increment, whatever the number of frames.
+// ----------------------------------------------------------------------------
+
+class FrameTimeHistogram
+{
+public:
+	FrameTimeHistogram();
+
+	void Clear();
+
+	// Frame time in seconds
+	void Record(double fFrameTime);
+
+	inline unsigned long long GetCount() const { return m_iCount; }
+
+	// In seconds. The percentiles are the upper bound of the bucket holding the
+	// nearest rank frame, so they are at most 1/64 above the actual frame time.
+	double GetPercentile(double fPercentile) const;
+	double GetMin() const;
+	double GetMax() const;
+	double GetMean() const;
+	double GetStandardDeviation() const;
+
+	// Mean absolute difference between consecutive frame times, in seconds
+	double GetJitter() const;
+
+	// One line per non empty bucket: lower and upper bound in milliseconds and frame count
+	void PrintBuckets(std::ostream& out) const;
+
+	// Longest frame time recorded as itself, longer ones are clamped to it. In seconds.
+	static double GetMaxRecordableTime();
+
+private:
+	static const unsigned int SUB_BUCKET_BITS = 7;
+	static const unsigned int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+	static const unsigned int SUB_BUCKET_HALF = SUB_BUCKET_COUNT / 2;
+
+	// Largest time is SUB_BUCKET_COUNT << MAGNITUDE_COUNT microseconds, about 35 minutes. Magnitude 0
+	// takes the whole first range, every magnitude up to MAGNITUDE_COUNT then adds half a range.
+	static const unsigned int MAGNITUDE_COUNT = 24;
+	static const unsigned int BUCKET_COUNT = (MAGNITUDE_COUNT + 2) * SUB_BUCKET_HALF;
+
+	static unsigned int GetBucketIndex(unsigned long long iValue);
+	static unsigned long long GetBucketLowerBound(unsigned int iIndex);
+	static unsigned long long GetBucketUpperBound(unsigned int iIndex);
+
+	std::vector<unsigned long long> m_Buckets;
+
+	unsigned long long m_iCount;
+	unsigned long long m_iMin;
+	unsigned long long m_iMax;
+
+	// Exact sums for the mean, standard deviation and jitter
+	double m_fSum;
+	double m_fSumSquares;
+	double m_fSumDifferences;
+	double m_fLastFrameTime;
+};
+
+#endif // FRAMETIMEHISTOGRAM_H
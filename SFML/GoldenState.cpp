@@ -0,0 +1,195 @@
+#include "GoldenState.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <math.h>
+#include <limits>
+
+#include "FluidSimulation.h"
+#include "ParticleManager.h"
+
+// ------------------------------------------------------------------------
+
+static const char* GOLDEN_STATE_VERSION = "PBD golden state 1";
+
+// ------------------------------------------------------------------------
+
+bool WriteGoldenState(const std::string& fileName, const Scenario& scenario, unsigned int iStepCount, FluidSimulation& fluidSim)
+{
+	std::ofstream outFile(fileName);
+	if (!outFile.is_open())
+	{
+		return false;
+	}
+
+	const FluidParticleStore& particles = fluidSim.GetParticleStore();
+	std::vector<DeformableParticle*>& deformableParticles = ParticleManager::GetInstance().GetDeformableParticles();
+
+	// The thread count is only informative - other counts sum the soft body corrections in another order
+	outFile << GOLDEN_STATE_VERSION << std::endl;
+	outFile << "scenario " << scenario.Name << std::endl;
+	outFile << "steps " << iStepCount << std::endl;
+	outFile << "seed " << scenario.Seed << std::endl;
+#ifdef MULTITHREADING
+	outFile << "threads " << fluidSim.GetThreadCount() << std::endl;
+#else
+	outFile << "threads 1" << std::endl;
+#endif // MULTITHREADING
+
+	// 9 significant digits read back to the same float
+	outFile << std::setprecision(9);
+
+	outFile << "fluid " << particles.Size() << std::endl;
+	for (unsigned int i = 0; i < particles.Size(); i++)
+	{
+		outFile << particles.Position[i].x << " " << particles.Position[i].y << " " <<
+			particles.Velocity[i].x << " " << particles.Velocity[i].y << std::endl;
+	}
+
+	outFile << "soft " << deformableParticles.size() << std::endl;
+	for (DeformableParticle* pParticle : deformableParticles)
+	{
+		outFile << pParticle->Position.x << " " << pParticle->Position.y << " " <<
+			pParticle->Velocity.x << " " << pParticle->Velocity.y << std::endl;
+	}
+
+	return true;
+}
+
+// ------------------------------------------------------------------------
+
+// Expect "key value" on the next line
+static bool ReadField(std::istream& in, const std::string& key, std::string& value)
+{
+	std::string line;
+	if (!std::getline(in, line))
+	{
+		return false;
+	}
+
+	std::stringstream lineStream(line);
+	std::string readKey;
+	lineStream >> readKey >> value;
+
+	return readKey == key;
+}
+
+// Compare the next particle of the snapshot with the current state
+static bool CompareParticle(std::istream& in, const char* pKind, unsigned int iIndex,
+	const glm::vec2& currentPosition, const glm::vec2& currentVelocity, GoldenStateComparison& comparison)
+{
+	glm::vec2 position;
+	glm::vec2 velocity;
+	if (!(in >> position.x >> position.y >> velocity.x >> velocity.y))
+	{
+		comparison.Error = std::string("Truncated ") + pKind + " particle list";
+		return false;
+	}
+
+	float fPositionError = std::max(fabs(currentPosition.x - position.x), fabs(currentPosition.y - position.y));
+	float fVelocityError = std::max(fabs(currentVelocity.x - velocity.x), fabs(currentVelocity.y - velocity.y));
+
+	// NaN never compares, count it as the largest error
+	if (fPositionError != fPositionError)
+	{
+		fPositionError = std::numeric_limits<float>::infinity();
+	}
+	if (fVelocityError != fVelocityError)
+	{
+		fVelocityError = std::numeric_limits<float>::infinity();
+	}
+
+	if (fPositionError > comparison.MaxPositionError || comparison.WorstParticle.empty())
+	{
+		comparison.MaxPositionError = fPositionError;
+		comparison.WorstParticle = std::string(pKind) + " " + std::to_string(iIndex);
+	}
+
+	comparison.MaxVelocityError = std::max(comparison.MaxVelocityError, fVelocityError);
+
+	return true;
+}
+
+// ------------------------------------------------------------------------
+
+GoldenStateComparison CompareGoldenState(const std::string& fileName, const Scenario& scenario, unsigned int iStepCount,
+	FluidSimulation& fluidSim, float fTolerance)
+{
+	GoldenStateComparison comparison;
+	comparison.Valid = false;
+	comparison.MaxPositionError = 0.0f;
+	comparison.MaxVelocityError = 0.0f;
+	comparison.Matches = false;
+
+	std::ifstream inFile(fileName);
+	if (!inFile.is_open())
+	{
+		comparison.Error = "Failed to open " + fileName;
+		return comparison;
+	}
+
+	std::string line;
+	if (!std::getline(inFile, line) || line != GOLDEN_STATE_VERSION)
+	{
+		comparison.Error = fileName + " is not a golden state file";
+		return comparison;
+	}
+
+	const FluidParticleStore& particles = fluidSim.GetParticleStore();
+	std::vector<DeformableParticle*>& deformableParticles = ParticleManager::GetInstance().GetDeformableParticles();
+
+	std::string name, steps, seed, threads, fluidCount, softCount;
+	if (!ReadField(inFile, "scenario", name) || !ReadField(inFile, "steps", steps) ||
+		!ReadField(inFile, "seed", seed) || !ReadField(inFile, "threads", threads) ||
+		!ReadField(inFile, "fluid", fluidCount))
+	{
+		comparison.Error = "Invalid header in " + fileName;
+		return comparison;
+	}
+
+	if (name != scenario.Name || steps != std::to_string(iStepCount) || seed != std::to_string(scenario.Seed) ||
+		fluidCount != std::to_string(particles.Size()))
+	{
+		comparison.Error = "The snapshot is for " + name + ", " + steps + " steps, seed " + seed + ", " + fluidCount + " fluid particles";
+		return comparison;
+	}
+
+	for (unsigned int i = 0; i < particles.Size(); i++)
+	{
+		if (!CompareParticle(inFile, "fluid", i, particles.Position[i], particles.Velocity[i], comparison))
+		{
+			return comparison;
+		}
+	}
+
+	inFile >> std::ws;
+	if (!ReadField(inFile, "soft", softCount))
+	{
+		comparison.Error = "Invalid soft body particle list in " + fileName;
+		return comparison;
+	}
+
+	if (softCount != std::to_string(deformableParticles.size()))
+	{
+		comparison.Error = "The snapshot has " + softCount + " soft body particles";
+		return comparison;
+	}
+
+	for (unsigned int i = 0; i < deformableParticles.size(); i++)
+	{
+		if (!CompareParticle(inFile, "soft", i, deformableParticles[i]->Position, deformableParticles[i]->Velocity, comparison))
+		{
+			return comparison;
+		}
+	}
+
+	comparison.Valid = true;
+	// A velocity error moves the particle by its value times the time step
+	comparison.Matches = comparison.MaxPositionError <= fTolerance && comparison.MaxVelocityError * FIXED_DELTA <= fTolerance;
+
+	return comparison;
+}
+
+// ------------------------------------------------------------------------
@@ -0,0 +1,44 @@
+#ifndef GOLDENSTATE_H
+#define GOLDENSTATE_H
+
+#include <string>
+
+#include "Scenario.h"
+
+class FluidSimulation;
+
+// ----------------------------------------------------------------------------
+// Golden snapshots of the particle state of a scenario after a number of
+// steps: the position and velocity of every fluid particle, in the order of
+// the particle store, then of every deformable particle. A snapshot written
+// by a known good build is the reference a solver change must reproduce.
+// The scenario has to run in deterministic mode for the comparison to be
+// meaningful, the values are written with enough digits to read back the
+// exact floats.
+// ----------------------------------------------------------------------------
+
+struct GoldenStateComparison
+{
+	// False if the snapshot can't be read or is for another scene
+	bool Valid;
+	std::string Error;
+
+	// Largest difference of a position and of a velocity coordinate, in pixels and pixels per second
+	float MaxPositionError;
+	float MaxVelocityError;
+
+	// Particle with the largest position error - "fluid 12" or "soft 3"
+	std::string WorstParticle;
+
+	bool Matches;
+};
+
+// Write the state of the simulation after iStepCount steps of the scenario, returns false if the file can't be written
+bool WriteGoldenState(const std::string& fileName, const Scenario& scenario, unsigned int iStepCount, FluidSimulation& fluidSim);
+
+// Compare the state of the simulation with a snapshot. It matches when every position coordinate is within
+// fTolerance and every velocity coordinate within fTolerance per fixed time step.
+GoldenStateComparison CompareGoldenState(const std::string& fileName, const Scenario& scenario, unsigned int iStepCount,
+	FluidSimulation& fluidSim, float fTolerance);
+
+#endif // GOLDENSTATE_H
@@ -0,0 +1,193 @@
+#include <iostream>
+#include <string>
+#include <stdlib.h>
+
+#include "Common.h"
+#include "FluidSimulation.h"
+#include "SoftBody.h"
+#include "SimulationManager.h"
+#include "Scenario.h"
+#include "GoldenState.h"
+#include "FluidKernels.h"
+
+// ----------------------------------------------------------------------------
+// Runs the default scene of the application without a window, or the scene
+// of a preset, and prints the time per step. The final particle state can be
+// written to a golden snapshot or compared with one, the tests of CMake do
+// the latter with the snapshots of tests/golden.
+// ----------------------------------------------------------------------------
+
+static void PrintUsage()
+{
+	std::cout << "Usage: PBDHeadless [options]" << std::endl;
+	std::cout << "  --steps N              number of fixed steps to simulate (default: 600)" << std::endl;
+	std::cout << "  --threads N            solver thread count, overrides PBD_THREAD_COUNT" << std::endl;
+	std::cout << "  --preset NAME          scene of a benchmark preset instead" << std::endl;
+	std::cout << "  --seed N               random seed of the scene" << std::endl;
+	std::cout << "  --kernels sse2|avx2    batch SPH kernels (default: the best the CPU supports)" << std::endl;
+	std::cout << "  --deterministic        same state after every run for a given seed and thread count" << std::endl;
+	std::cout << "  --write-golden FILE    write the final particle state to FILE" << std::endl;
+	std::cout << "  --check-golden FILE    compare the final particle state with FILE, exit code 1 if it differs" << std::endl;
+	std::cout << "  --tolerance T          largest position difference in pixels accepted by --check-golden (default: 0.001)" << std::endl;
+	std::cout << "The golden state options run in deterministic mode. The kernel sets round differently, a snapshot" << std::endl;
+	std::cout << "is only reproduced exactly with the kernels it was written with." << std::endl;
+}
+
+// ------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+	unsigned int iStepCount = 600;
+	unsigned int iThreadCount = 0;
+	std::string writeGoldenFileName;
+	std::string checkGoldenFileName;
+	float fTolerance = 0.001f;
+	const FluidKernelSet* pKernels = nullptr;
+
+	// Same scene as the application unless a preset is given
+	Scenario scenario;
+
+	for (int iArg = 1; iArg < argc; iArg++)
+	{
+		std::string arg = argv[iArg];
+
+		if (arg == "--help")
+		{
+			PrintUsage();
+			return 0;
+		}
+		else if (arg == "--steps" && iArg + 1 < argc)
+		{
+			iStepCount = (unsigned int)std::max(atoi(argv[++iArg]), 1);
+		}
+		else if (arg == "--threads" && iArg + 1 < argc)
+		{
+			iThreadCount = (unsigned int)std::max(atoi(argv[++iArg]), 1);
+		}
+		else if (arg == "--preset" && iArg + 1 < argc)
+		{
+			if (!GetScenarioPreset(argv[++iArg], scenario))
+			{
+				std::cout << "Unknown preset: " << argv[iArg] << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--seed" && iArg + 1 < argc)
+		{
+			scenario.Seed = (unsigned int)strtoul(argv[++iArg], nullptr, 10);
+		}
+		else if (arg == "--deterministic")
+		{
+			scenario.Deterministic = true;
+		}
+		else if (arg == "--write-golden" && iArg + 1 < argc)
+		{
+			writeGoldenFileName = argv[++iArg];
+		}
+		else if (arg == "--check-golden" && iArg + 1 < argc)
+		{
+			checkGoldenFileName = argv[++iArg];
+		}
+		else if (arg == "--tolerance" && iArg + 1 < argc)
+		{
+			fTolerance = std::max((float)atof(argv[++iArg]), 0.0f);
+		}
+		else if (arg == "--kernels" && iArg + 1 < argc)
+		{
+			std::string kernels = argv[++iArg];
+			if (kernels == "sse2")
+			{
+				pKernels = &GetSSE2FluidKernels();
+			}
+			else if (kernels == "avx2" && IsAVX2Supported())
+			{
+				pKernels = &GetAVX2FluidKernels();
+			}
+			else
+			{
+				std::cerr << "Unknown or unsupported kernels: " << kernels << std::endl;
+				return 1;
+			}
+		}
+		else
+		{
+			std::cerr << "Unknown argument: " << arg << std::endl;
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (iThreadCount > 0)
+	{
+		scenario.ThreadCount = iThreadCount;
+	}
+
+	if (!writeGoldenFileName.empty() || !checkGoldenFileName.empty())
+	{
+		scenario.Deterministic = true;
+	}
+
+	FluidSimulation* fluidSim = BuildScenario(scenario);
+	if (pKernels != nullptr)
+	{
+		fluidSim->SetKernels(*pKernels);
+	}
+
+	// ---------------------------------------------------------------------------
+	// Simulation loop
+	double fStartTime = GetHighResolutionTime();
+
+	for (unsigned int iStep = 0; iStep < iStepCount; iStep++)
+	{
+		fluidSim->Update(FIXED_DELTA);
+
+		SimulationManager::GetInstance().UpdateSoftBodies(FIXED_DELTA, fluidSim->GetWorkerTeam());
+	}
+
+	double fTotalTime = GetHighResolutionTime() - fStartTime;
+
+#ifdef MULTITHREADING
+	std::cout << "Thread count: " << fluidSim->GetThreadCount() << std::endl;
+#else
+	std::cout << "Single threaded." << std::endl;
+#endif // MULTITHREADING
+	std::cout << "Fluid particle count: " << fluidSim->GetPaticleCount() << std::endl;
+	std::cout << "Soft body particle count: " << ParticleManager::GetInstance().GetDeformableParticles().size() << std::endl;
+	std::cout << "Steps: " << iStepCount << std::endl;
+	std::cout << "Total time: " << fTotalTime << std::endl;
+	std::cout << "Average time per step: " << fTotalTime / iStepCount << std::endl;
+
+	// ---------------------------------------------------------------------------
+	// Golden state
+	if (!writeGoldenFileName.empty())
+	{
+		if (!WriteGoldenState(writeGoldenFileName, scenario, iStepCount, *fluidSim))
+		{
+			std::cout << "Failed to write " << writeGoldenFileName << std::endl;
+			return 1;
+		}
+
+		std::cout << "Golden state written to " << writeGoldenFileName << std::endl;
+	}
+
+	if (!checkGoldenFileName.empty())
+	{
+		GoldenStateComparison comparison = CompareGoldenState(checkGoldenFileName, scenario, iStepCount, *fluidSim, fTolerance);
+		if (!comparison.Valid)
+		{
+			std::cout << comparison.Error << std::endl;
+			return 1;
+		}
+
+		std::cout << "Golden state " << (comparison.Matches ? "matches" : "DIFFERS") <<
+			": max position error " << comparison.MaxPositionError << " (" << comparison.WorstParticle <<
+			"), max velocity error " << comparison.MaxVelocityError << std::endl;
+
+		if (!comparison.Matches)
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,52 @@
+#ifndef HEADLESSTYPES_H
+#define HEADLESSTYPES_H
+
+// ----------------------------------------------------------------------------
+// Plain data stand-ins for the few SFML value types the simulation keeps in
+// its state when it is built without SFML (HEADLESS). They have the same
+// names and members as the SFML types so the solver code is shared by both
+// builds. Nothing here draws.
+// ----------------------------------------------------------------------------
+
+namespace sf
+{
+	typedef unsigned char Uint8;
+
+	class Color
+	{
+	public:
+		Color() : r(0), g(0), b(0), a(255) {}
+		Color(Uint8 red, Uint8 green, Uint8 blue, Uint8 alpha = 255) : r(red), g(green), b(blue), a(alpha) {}
+
+		static const Color Black;
+		static const Color White;
+		static const Color Red;
+		static const Color Green;
+		static const Color Blue;
+		static const Color Yellow;
+		static const Color Magenta;
+		static const Color Cyan;
+
+		Uint8 r;
+		Uint8 g;
+		Uint8 b;
+		Uint8 a;
+	};
+
+	template <typename T>
+	class Vector2
+	{
+	public:
+		Vector2() : x(0), y(0) {}
+		Vector2(T X, T Y) : x(X), y(Y) {}
+
+		T x;
+		T y;
+	};
+
+	typedef Vector2<int> Vector2i;
+	typedef Vector2<unsigned int> Vector2u;
+	typedef Vector2<float> Vector2f;
+}
+
+#endif // HEADLESSTYPES_H
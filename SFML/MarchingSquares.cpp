@@ -4,19 +4,21 @@
 
 float MarchingSquares::SamplePoint(FluidSimulation* sim, unsigned int x, unsigned int y)
 {
-	const std::vector<FluidParticle*>& fluidParticleList = sim->GetFluidParticleList();
+	const AlignedVector<glm::vec2>& fluidParticlePositions = sim->GetParticleStore().Position;
 	// Reset the summation
 	float fSum = 0;
 
 	// Iterate through every Metaball in the world 
-	for (unsigned int i = 0; i < fluidParticleList.size(); i++)
+	for (unsigned int i = 0; i < fluidParticlePositions.size(); i++)
 	{
-		fSum += CalculateEquation(fluidParticleList[i], x, y);
+		fSum += CalculateEquation(fluidParticlePositions[i], x, y);
 	}
 
 	return fSum;
 }
 
+#ifndef HEADLESS
+
 void MarchingSquares::ProcessMarchingSquares(FluidSimulation* fluidSim, sf::RenderWindow& window)
 {
 	// Go through all the boxes
@@ -132,4 +134,6 @@ void MarchingSquares::ProcessMarchingSquares(FluidSimulation* fluidSim, sf::Rend
 			}
 		}
 	}
-}
\ No newline at end of file
+}
+
+#endif // HEADLESS
@@ -32,10 +32,15 @@ public:
 		return instance;
 	}
 
+#ifndef HEADLESS
 	// Update and draw marching squares
 	void ProcessMarchingSquares(FluidSimulation* fluidSim, sf::RenderWindow& window);
+#endif // HEADLESS
 
 private:
+	// The microbenchmarks time the sampling on its own
+	friend struct MicrobenchmarkAccess;
+
 	// --------------------------------------------------------------------------------
 
 	// Hide constructor for singleton implementation
@@ -67,13 +72,13 @@ private:
 		x = x * (1.5f - xhalf * x * x);     // One round of Newton's method 
 		return x;
 	}
-	inline float CalculateEquation(const FluidParticle* particle, unsigned int x, unsigned int y)
+	inline float CalculateEquation(const glm::vec2& particlePosition, unsigned int x, unsigned int y)
 	{
-		float fParticleX = particle->Position.x;
-		float fParticleY = particle->Position.y;
+		float fParticleX = particlePosition.x;
+		float fParticleY = particlePosition.y;
 
 		float invSqrt = InvSqrt((x - fParticleX) * (x - fParticleX) + (y - fParticleY) * (y - fParticleY));
-		return 0.5f * particle->Radius * invSqrt;
+		return 0.5f * PARTICLE_RADIUS * invSqrt;
 	}
 
 	// Members
@@ -0,0 +1,632 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <stdlib.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "Common.h"
+#include "FluidSimulation.h"
+#include "FluidKernels.h"
+#include "UniformGrid.h"
+#include "SpatialPartition.h"
+#include "SoftBody.h"
+#include "ConvexHull.h"
+#include "Mat2Utility.h"
+#include "MarchingSquares.h"
+
+// ----------------------------------------------------------------------------
+// Microbenchmarks of the hot functions of the solver on synthetic inputs of
+// a few sizes. Each case reports the time per item (particle, pair or call)
+// and the throughput. A case is repeated until a sample lasts --min-time
+// seconds and the median of the samples is reported, with the fastest one.
+// ----------------------------------------------------------------------------
+
+// Private members of the solver classes timed by the benchmarks
+struct MicrobenchmarkAccess
+{
+	static inline float Poly6Kernel(FluidSimulation& fluidSim, const glm::vec2& pi, const glm::vec2& pj)
+	{
+		return fluidSim.Poly6Kernel(pi, pj);
+	}
+
+	static inline glm::vec2 SpikyKernelGradient(FluidSimulation& fluidSim, const glm::vec2& pi, const glm::vec2& pj)
+	{
+		return fluidSim.SpikyKernelGradient(pi, pj);
+	}
+
+	static inline const FluidKernelParams& GetKernelParams(FluidSimulation& fluidSim)
+	{
+		return fluidSim.m_KernelParams;
+	}
+
+	// Neighbor rows of every particle against the grids of the last step, as the solver builds them
+	static void UpdateNeighbors(FluidSimulation& fluidSim)
+	{
+		unsigned int iParticleCount = fluidSim.m_Particles.Size();
+		unsigned int iChunkSize = fluidSim.m_Scheduler.GetChunkSize();
+
+		fluidSim.m_Neighbors.Begin(iParticleCount, fluidSim.m_Scheduler.GetChunkCount(iParticleCount));
+
+		for (unsigned int iParticleIndex = 0; iParticleIndex < iParticleCount; iParticleIndex++)
+		{
+			fluidSim.UpdateNeighbors(iParticleIndex, iParticleIndex / iChunkSize);
+		}
+	}
+
+	static inline void ShapeMatching(SoftBody& softBody, float dt)
+	{
+		softBody.ShapeMatching(dt);
+	}
+
+	static inline float SamplePoint(FluidSimulation& fluidSim, unsigned int x, unsigned int y)
+	{
+		return MarchingSquares::GetInstance().SamplePoint(&fluidSim, x, y);
+	}
+};
+
+// ------------------------------------------------------------------------
+
+struct MicrobenchResult
+{
+	std::string Name;
+	unsigned int Size;
+	std::string Unit;
+
+	// Nanoseconds per item - median and fastest sample
+	double Median;
+	double Min;
+};
+
+// Results are added here so that the compiler can't drop the timed work
+static volatile float s_fSink = 0.0f;
+
+static const unsigned int SAMPLE_COUNT = 5;
+
+class Microbenchmarks
+{
+public:
+	Microbenchmarks(const std::string& filter, double fMinTime)
+		: m_Filter(filter),
+		m_fMinTime(fMinTime)
+	{
+	}
+
+	inline bool IsEnabled(const std::string& name) const
+	{
+		return m_Filter.empty() || name.find(m_Filter) != std::string::npos;
+	}
+
+	// Time a function processing iItemCount items per call
+	template <typename Function>
+	void Run(const std::string& name, unsigned int iSize, const char* pUnit, unsigned long long iItemCount, Function function)
+	{
+		if (!IsEnabled(name))
+		{
+			return;
+		}
+
+		// Calls per sample, doubled until a sample lasts long enough
+		unsigned long long iCallCount = 1;
+		while (true)
+		{
+			double fStartTime = GetHighResolutionTime();
+			for (unsigned long long iCall = 0; iCall < iCallCount; iCall++)
+			{
+				function();
+			}
+			double fElapsedTime = GetHighResolutionTime() - fStartTime;
+
+			if (fElapsedTime >= m_fMinTime || iCallCount >= (1ULL << 40))
+			{
+				break;
+			}
+
+			iCallCount *= 2;
+		}
+
+		std::vector<double> samples;
+		for (unsigned int iSample = 0; iSample < SAMPLE_COUNT; iSample++)
+		{
+			double fStartTime = GetHighResolutionTime();
+			for (unsigned long long iCall = 0; iCall < iCallCount; iCall++)
+			{
+				function();
+			}
+			double fElapsedTime = GetHighResolutionTime() - fStartTime;
+
+			samples.push_back(fElapsedTime * 1e9 / ((double)iCallCount * iItemCount));
+		}
+
+		MicrobenchResult result;
+		result.Name = name;
+		result.Size = iSize;
+		result.Unit = pUnit;
+		result.Median = NearestRankPercentile(samples, 50.0);
+		result.Min = *std::min_element(samples.begin(), samples.end());
+
+		std::cerr << name << " " << iSize << ": " << result.Median << " ns/" << pUnit << std::endl;
+
+		m_Results.push_back(result);
+	}
+
+	inline const std::vector<MicrobenchResult>& GetResults() const { return m_Results; }
+
+private:
+	std::string m_Filter;
+	double m_fMinTime;
+
+	std::vector<MicrobenchResult> m_Results;
+};
+
+// ------------------------------------------------------------------------
+
+static inline float RandomFloat(float fMin, float fMax)
+{
+	return fMin + (fMax - fMin) * (float)rand() / (float)RAND_MAX;
+}
+
+// Random point in a disc around the origin
+static glm::vec2 RandomPointInDisc(float fRadius)
+{
+	float fAngle = RandomFloat(0.0f, 6.2831853f);
+	float fDistance = fRadius * sqrt(RandomFloat(0.0f, 1.0f));
+
+	return glm::vec2(cos(fAngle), sin(fAngle)) * fDistance;
+}
+
+// Random point inside the container
+static glm::vec2 RandomPointInContainer()
+{
+	return glm::vec2(RandomFloat(WALL_LEFTLIMIT, WALL_LEFTLIMIT + CONTAINER_WIDTH),
+		RandomFloat(WALL_TOPLIMIT, WALL_TOPLIMIT + CONTAINER_HEIGHT));
+}
+
+// Square block of fluid particles settled under gravity for a number of steps, on one thread
+static FluidSimulation* CreateSettledFluid(int iSize, unsigned int iSettleSteps)
+{
+	FluidSimulation* fluidSim = new FluidSimulation();
+	fluidSim->BuildParticleSystem(glm::vec2(100.0f, 150.0f), sf::Color::Blue, iSize, iSize);
+
+#ifdef MULTITHREADING
+	fluidSim->SetThreadCount(1);
+	fluidSim->SetupMultithread();
+#endif // MULTITHREADING
+
+	for (unsigned int iStep = 0; iStep < iSettleSteps; iStep++)
+	{
+		fluidSim->Update(FIXED_DELTA);
+	}
+
+	return fluidSim;
+}
+
+// ------------------------------------------------------------------------
+
+// Scalar kernels of the solver and the batch density kernels
+static void RunKernelBenchmarks(Microbenchmarks& benchmarks, unsigned int iSeed)
+{
+	// The simulation seeds with the time in its constructor
+	FluidSimulation fluidSim;
+	const FluidKernelParams& params = MicrobenchmarkAccess::GetKernelParams(fluidSim);
+
+	srand(iSeed);
+
+	// Pairs closer than the smoothing distance, a few of them just outside
+	unsigned int pairCounts[] = { 256, 4096, 65536 };
+	for (unsigned int iPairCount : pairCounts)
+	{
+		std::vector<glm::vec2> positionsA(iPairCount);
+		std::vector<glm::vec2> positionsB(iPairCount);
+		for (unsigned int i = 0; i < iPairCount; i++)
+		{
+			positionsA[i] = RandomPointInContainer();
+			positionsB[i] = positionsA[i] + RandomPointInDisc(1.1f * params.SmoothingDistance);
+		}
+
+		benchmarks.Run("poly6_kernel", iPairCount, "pair", iPairCount, [&]()
+		{
+			float fSum = 0.0f;
+			for (unsigned int i = 0; i < iPairCount; i++)
+			{
+				fSum += MicrobenchmarkAccess::Poly6Kernel(fluidSim, positionsA[i], positionsB[i]);
+			}
+			s_fSink += fSum;
+		});
+
+		benchmarks.Run("spiky_kernel_gradient", iPairCount, "pair", iPairCount, [&]()
+		{
+			glm::vec2 sum(0.0f);
+			for (unsigned int i = 0; i < iPairCount; i++)
+			{
+				sum += MicrobenchmarkAccess::SpikyKernelGradient(fluidSim, positionsA[i], positionsB[i]);
+			}
+			s_fSink += sum.x + sum.y;
+		});
+	}
+
+	// Density pass of 256 particles with a given neighbor count, the neighbors are picked in a shared position array
+	std::vector<const FluidKernelSet*> kernelSets;
+	kernelSets.push_back(&GetSSE2FluidKernels());
+	if (IsAVX2Supported())
+	{
+		kernelSets.push_back(&GetAVX2FluidKernels());
+	}
+
+	const unsigned int iParticleCount = 256;
+	const unsigned int iPositionCount = 4096;
+
+	std::vector<glm::vec2> positions(iPositionCount);
+	for (unsigned int i = 0; i < iPositionCount; i++)
+	{
+		positions[i] = RandomPointInDisc(1.1f * params.SmoothingDistance);
+	}
+
+	unsigned int neighborCounts[] = { 8, 24, 64 };
+	for (unsigned int iNeighborCount : neighborCounts)
+	{
+		std::vector<int> neighbors(iParticleCount * iNeighborCount);
+		for (unsigned int i = 0; i < neighbors.size(); i++)
+		{
+			neighbors[i] = rand() % iPositionCount;
+		}
+
+		std::vector<float> pairKernel(iNeighborCount);
+		std::vector<glm::vec2> pairGradient(iNeighborCount);
+
+		for (const FluidKernelSet* pKernels : kernelSets)
+		{
+			std::string name = std::string("density_batch_") + pKernels->Name;
+			std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+			benchmarks.Run(name, iNeighborCount, "pair", (unsigned long long)iParticleCount * iNeighborCount, [&]()
+			{
+				float fSum = 0.0f;
+				for (unsigned int i = 0; i < iParticleCount; i++)
+				{
+					DensitySums sums;
+					pKernels->Density(params, glm::vec2(0.0f), positions.data(), &neighbors[i * iNeighborCount], iNeighborCount,
+						pairKernel.data(), pairGradient.data(), sums);
+					fSum += sums.Density;
+				}
+				s_fSink += fSum;
+			});
+		}
+	}
+}
+
+// ------------------------------------------------------------------------
+
+// Counting sort of the fluid particles into the grid and registration of the deformable particles
+static void RunGridBenchmarks(Microbenchmarks& benchmarks, unsigned int iSeed)
+{
+	srand(iSeed);
+
+	glm::vec2 localOffset(WALL_LEFTLIMIT, WALL_TOPLIMIT);
+
+	unsigned int particleCounts[] = { 1024, 4096, 16384 };
+	for (unsigned int iParticleCount : particleCounts)
+	{
+		std::vector<glm::vec2> positions(iParticleCount);
+		for (unsigned int i = 0; i < iParticleCount; i++)
+		{
+			positions[i] = RandomPointInContainer();
+		}
+
+		UniformGrid grid;
+		grid.Setup(TOTAL_CELLS);
+		std::vector<CellIDList> cellIDs(iParticleCount);
+
+		benchmarks.Run("grid_build", iParticleCount, "particle", iParticleCount, [&]()
+		{
+			grid.Begin(1);
+			for (unsigned int i = 0; i < iParticleCount; i++)
+			{
+				cellIDs[i].Count = 1;
+				cellIDs[i].IDs[0] = SpatialPartition::ComputeCellID(positions[i] - localOffset);
+			}
+			grid.Count(0, cellIDs.data(), 0, iParticleCount);
+			grid.PrefixSum();
+			grid.Scatter(0, cellIDs.data(), nullptr, 0, iParticleCount);
+			s_fSink += (float)grid.GetEntries()[0];
+		});
+
+		if (!benchmarks.IsEnabled("soft_registration"))
+		{
+			continue;
+		}
+
+		// Deformable particles outside any soft body, only their positions matter
+		std::vector<std::unique_ptr<DeformableParticle>> deformableParticles;
+		for (unsigned int i = 0; i < iParticleCount; i++)
+		{
+			deformableParticles.push_back(std::unique_ptr<DeformableParticle>(new DeformableParticle(positions[i], sf::Color::Red, 0)));
+		}
+
+		SpatialPartition& spatialPartition = SpatialPartition::GetInstance();
+		spatialPartition.Setup();
+
+		benchmarks.Run("soft_registration", iParticleCount, "particle", iParticleCount, [&]()
+		{
+			spatialPartition.BeginRegistration(iParticleCount, 1);
+			for (unsigned int i = 0; i < iParticleCount; i++)
+			{
+				spatialPartition.RegisterObject(i, deformableParticles[i].get());
+			}
+			spatialPartition.CountRegistered(0, 0, iParticleCount);
+			spatialPartition.PrefixSumRegistered();
+			spatialPartition.ScatterRegistered(0, 0, iParticleCount);
+			s_fSink += (float)spatialPartition.GetSoftGrid().GetEntries()[0];
+		});
+	}
+}
+
+// ------------------------------------------------------------------------
+
+// Neighbor search and marching squares sampling of settled fluid blocks
+static void RunFluidBenchmarks(Microbenchmarks& benchmarks)
+{
+	if (!benchmarks.IsEnabled("neighbor_search") && !benchmarks.IsEnabled("marching_squares_sample"))
+	{
+		return;
+	}
+
+	int sizes[] = { 30, 50, 70 };
+	for (int iSize : sizes)
+	{
+		std::unique_ptr<FluidSimulation> fluidSim(CreateSettledFluid(iSize, 100));
+		unsigned int iParticleCount = fluidSim->GetPaticleCount();
+
+		benchmarks.Run("neighbor_search", iParticleCount, "particle", iParticleCount, [&]()
+		{
+			MicrobenchmarkAccess::UpdateNeighbors(*fluidSim);
+		});
+
+		// A row of samples across the container, every sample visits every particle
+		const unsigned int iSampleCount = 16;
+		benchmarks.Run("marching_squares_sample", iParticleCount, "pair", (unsigned long long)iSampleCount * iParticleCount, [&]()
+		{
+			float fSum = 0.0f;
+			for (unsigned int i = 0; i < iSampleCount; i++)
+			{
+				unsigned int x = (unsigned int)(WALL_LEFTLIMIT + CONTAINER_WIDTH * i / iSampleCount);
+				fSum += MicrobenchmarkAccess::SamplePoint(*fluidSim, x, (unsigned int)(WALL_TOPLIMIT + CONTAINER_HEIGHT * 0.75f));
+			}
+			s_fSink += fSum;
+		});
+	}
+}
+
+// ------------------------------------------------------------------------
+
+// Shape matching of single soft bodies, polar decomposition of random matrices and hulls of random points
+static void RunSoftBodyBenchmarks(Microbenchmarks& benchmarks, unsigned int iSeed)
+{
+	srand(iSeed);
+
+	int sizes[] = { 6, 12, 24 };
+
+	if (benchmarks.IsEnabled("shape_matching"))
+	{
+		for (int iSize : sizes)
+		{
+			// The soft body particles are added to the global list, like in the application
+			SoftBody* pSoftBody = new SoftBody();
+			for (int iLine = 0; iLine < iSize; iLine++)
+			{
+				for (int iColumn = 0; iColumn < iSize; iColumn++)
+				{
+					glm::vec2 position(300.0f + iColumn * (PARTICLE_RADIUS * 2.0f + 0.1f), 200.0f + iLine * (PARTICLE_RADIUS * 2.0f + 0.1f));
+
+					DeformableParticle* pParticle = new DeformableParticle(position, sf::Color::Red, pSoftBody->GetSimulationIndex());
+					pParticle->SetParentRef(pSoftBody);
+
+					// Deformed configuration, the shape matching pulls it back
+					pParticle->PredictedPosition += RandomPointInDisc(PARTICLE_RADIUS);
+
+					pSoftBody->AddSoftBodyParticle(*pParticle);
+				}
+			}
+			pSoftBody->BuildSoftBody();
+
+			unsigned int iParticleCount = pSoftBody->GetParticleCount();
+
+			benchmarks.Run("shape_matching", iParticleCount, "particle", iParticleCount, [&]()
+			{
+				MicrobenchmarkAccess::ShapeMatching(*pSoftBody, FIXED_DELTA);
+			});
+		}
+	}
+
+	unsigned int matrixCounts[] = { 256, 4096 };
+	for (unsigned int iMatrixCount : matrixCounts)
+	{
+		// Rotation and scale with some shear, as the moment matrices of the shape matching
+		std::vector<glm::mat2> matrices(iMatrixCount);
+		for (unsigned int i = 0; i < iMatrixCount; i++)
+		{
+			float fAngle = RandomFloat(0.0f, 6.2831853f);
+			glm::mat2 rotation(cos(fAngle), sin(fAngle), -sin(fAngle), cos(fAngle));
+			glm::mat2 stretch(RandomFloat(0.5f, 2.0f), RandomFloat(-0.3f, 0.3f), RandomFloat(-0.3f, 0.3f), RandomFloat(0.5f, 2.0f));
+			matrices[i] = rotation * stretch;
+		}
+
+		benchmarks.Run("polar_decomposition", iMatrixCount, "call", iMatrixCount, [&]()
+		{
+			float fSum = 0.0f;
+			for (unsigned int i = 0; i < iMatrixCount; i++)
+			{
+				glm::mat2 R, S;
+				PolarDecomposition(matrices[i], R, S);
+				fSum += R[0][0];
+			}
+			s_fSink += fSum;
+		});
+	}
+
+	for (int iSize : sizes)
+	{
+		unsigned int iPointCount = iSize * iSize;
+
+		std::vector<std::unique_ptr<DeformableParticle>> particles;
+		std::vector<DeformableParticle*> pointList;
+		for (unsigned int i = 0; i < iPointCount; i++)
+		{
+			particles.push_back(std::unique_ptr<DeformableParticle>(new DeformableParticle(
+				glm::vec2(300.0f, 300.0f) + RandomPointInDisc(iSize * PARTICLE_RADIUS), sf::Color::Red, 0)));
+			pointList.push_back(particles.back().get());
+		}
+
+		// A hull updated every call keeps its order like the hull of a body at rest, a new one sorts from scratch
+		ConvexHull convexHull;
+
+		benchmarks.Run("convex_hull", iPointCount, "particle", iPointCount, [&]()
+		{
+			convexHull.Update(pointList);
+			s_fSink += (float)convexHull.GetEdgeList().size();
+		});
+
+		benchmarks.Run("convex_hull_unsorted", iPointCount, "particle", iPointCount, [&]()
+		{
+			ConvexHull newHull;
+			newHull.Update(pointList);
+			s_fSink += (float)newHull.GetEdgeList().size();
+		});
+	}
+}
+
+// ------------------------------------------------------------------------
+
+static void WriteText(std::ostream& out, const std::vector<MicrobenchResult>& results)
+{
+	out << std::left << std::setw(28) << "benchmark" << std::right << std::setw(8) << "size" <<
+		std::setw(14) << "ns/item" << std::setw(14) << "min ns/item" << std::setw(16) << "Mitems/s" << "  item" << std::endl;
+
+	out << std::fixed << std::setprecision(3);
+
+	for (const MicrobenchResult& result : results)
+	{
+		out << std::left << std::setw(28) << result.Name << std::right << std::setw(8) << result.Size <<
+			std::setw(14) << result.Median << std::setw(14) << result.Min << std::setw(16) << 1000.0 / result.Median <<
+			"  " << result.Unit << std::endl;
+	}
+}
+
+static void WriteCSV(std::ostream& out, const std::vector<MicrobenchResult>& results)
+{
+	out << "benchmark,size,unit,ns_per_item,min_ns_per_item,items_per_second" << std::endl;
+
+	for (const MicrobenchResult& result : results)
+	{
+		out << result.Name << "," << result.Size << "," << result.Unit << "," << result.Median << "," <<
+			result.Min << "," << 1e9 / result.Median << std::endl;
+	}
+}
+
+// ------------------------------------------------------------------------
+
+static void PrintUsage()
+{
+	std::cout << "Usage: PBDMicrobench [options]" << std::endl;
+	std::cout << "  --filter TEXT              only run the benchmarks whose name contains TEXT" << std::endl;
+	std::cout << "  --min-time SECONDS         shortest sample (default: 0.05)" << std::endl;
+	std::cout << "  --format text|csv          output format (default: text)" << std::endl;
+	std::cout << "  --output FILE              output file (default: standard output)" << std::endl;
+	std::cout << "  --seed N                   random seed of the inputs" << std::endl;
+	std::cout << "Benchmarks: poly6_kernel, spiky_kernel_gradient, density_batch_sse2/avx2, grid_build," << std::endl;
+	std::cout << "soft_registration, neighbor_search, marching_squares_sample, shape_matching," << std::endl;
+	std::cout << "polar_decomposition, convex_hull, convex_hull_unsorted" << std::endl;
+}
+
+// ------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+	std::string filter;
+	std::string format = "text";
+	std::string outFileName;
+	double fMinTime = 0.05;
+	unsigned int iSeed = 1;
+
+	for (int iArg = 1; iArg < argc; iArg++)
+	{
+		std::string arg = argv[iArg];
+		bool bHasValue = iArg + 1 < argc;
+
+		if (arg == "--help")
+		{
+			PrintUsage();
+			return 0;
+		}
+		else if (arg == "--filter" && bHasValue)
+		{
+			filter = argv[++iArg];
+		}
+		else if (arg == "--min-time" && bHasValue)
+		{
+			fMinTime = std::max(atof(argv[++iArg]), 0.001);
+		}
+		else if (arg == "--format" && bHasValue)
+		{
+			format = argv[++iArg];
+			if (format != "text" && format != "csv")
+			{
+				std::cerr << "Unknown format: " << format << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--output" && bHasValue)
+		{
+			outFileName = argv[++iArg];
+		}
+		else if (arg == "--seed" && bHasValue)
+		{
+			iSeed = (unsigned int)strtoul(argv[++iArg], nullptr, 10);
+		}
+		else
+		{
+			std::cerr << "Unknown argument: " << arg << std::endl;
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	// ---------------------------------------------------------------------------
+
+	Microbenchmarks benchmarks(filter, fMinTime);
+
+	RunKernelBenchmarks(benchmarks, iSeed);
+	RunGridBenchmarks(benchmarks, iSeed);
+	RunFluidBenchmarks(benchmarks);
+	RunSoftBodyBenchmarks(benchmarks, iSeed);
+
+	// ---------------------------------------------------------------------------
+
+	std::ofstream outFile;
+	if (!outFileName.empty())
+	{
+		outFile.open(outFileName);
+		if (!outFile.is_open())
+		{
+			std::cerr << "Failed to open " << outFileName << std::endl;
+			return 1;
+		}
+	}
+
+	std::ostream& out = outFileName.empty() ? std::cout : outFile;
+
+	if (format == "csv")
+	{
+		WriteCSV(out, benchmarks.GetResults());
+	}
+	else
+	{
+		WriteText(out, benchmarks.GetResults());
+	}
+
+	return 0;
+}
@@ -0,0 +1,62 @@
+#include "NeighborTable.h"
+
+#include <algorithm>
+
+// ------------------------------------------------------------------------
+
+void NeighborTable::Begin(unsigned int iParticleCount, unsigned int iChunkCount)
+{
+	// Rows not written by any chunk stay empty
+	m_Offsets.assign(iParticleCount + 1, 0);
+	m_SoftOffsets.assign(iParticleCount, 0);
+
+	// Keep the capacity of the staging buffers between rebuilds
+	m_ChunkIndices.resize(iChunkCount);
+	for (unsigned int iChunk = 0; iChunk < iChunkCount; iChunk++)
+	{
+		m_ChunkIndices[iChunk].clear();
+	}
+}
+
+// ------------------------------------------------------------------------
+
+void NeighborTable::SetRowCounts(unsigned int iParticleIndex, unsigned int iFluidCount, unsigned int iSoftCount)
+{
+	// Counts are kept in the offset arrays until Finalize
+	m_SoftOffsets[iParticleIndex] = iFluidCount;
+	m_Offsets[iParticleIndex + 1] = iSoftCount;
+}
+
+// ------------------------------------------------------------------------
+
+void NeighborTable::Finalize()
+{
+	unsigned int iParticleCount = m_SoftOffsets.size();
+	unsigned int iOffset = 0;
+
+	// Exclusive scan of the row sizes. m_Offsets[i + 1] is read before it gets overwritten by the next row.
+	for (unsigned int index = 0; index < iParticleCount; index++)
+	{
+		unsigned int iFluidCount = m_SoftOffsets[index];
+		unsigned int iSoftCount = m_Offsets[index + 1];
+
+		m_Offsets[index] = iOffset;
+		m_SoftOffsets[index] = iOffset + iFluidCount;
+
+		iOffset += iFluidCount + iSoftCount;
+	}
+
+	m_Offsets[iParticleCount] = iOffset;
+
+	// Chunks hold consecutive particles so their rows are already in order
+	m_Indices.resize(iOffset);
+
+	unsigned int iWriteIndex = 0;
+	for (unsigned int iChunk = 0; iChunk < m_ChunkIndices.size(); iChunk++)
+	{
+		std::copy(m_ChunkIndices[iChunk].begin(), m_ChunkIndices[iChunk].end(), m_Indices.begin() + iWriteIndex);
+		iWriteIndex += m_ChunkIndices[iChunk].size();
+	}
+}
+
+// ------------------------------------------------------------------------
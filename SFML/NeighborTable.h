@@ -0,0 +1,78 @@
+#ifndef NEIGHBORTABLE_H
+#define NEIGHBORTABLE_H
+
+#include <vector>
+
+// Read only view over a contiguous range of particle indices
+class NeighborSpan
+{
+public:
+	NeighborSpan(const int* pBegin, const int* pEnd) : m_pBegin(pBegin), m_pEnd(pEnd) {}
+
+	inline unsigned int size() const { return (unsigned int)(m_pEnd - m_pBegin); }
+	inline bool empty() const { return m_pBegin == m_pEnd; }
+	inline int operator[](unsigned int iIndex) const { return m_pBegin[iIndex]; }
+
+	inline const int* begin() const { return m_pBegin; }
+	inline const int* end() const { return m_pEnd; }
+
+private:
+	const int* m_pBegin;
+	const int* m_pEnd;
+};
+
+// ----------------------------------------------------------------------------
+// Compressed sparse row table with the neighbors of every fluid particle.
+// The row of particle i holds its fluid neighbors followed by its deformable
+// neighbors:
+//   Indices[Offsets[i]     .. SoftOffsets[i]) - fluid store indices
+//   Indices[SoftOffsets[i] .. Offsets[i + 1]) - global particle indices
+// Rows are built in chunks of consecutive particles which can run
+// concurrently. Each chunk appends its rows to its own staging buffer and
+// Finalize lays the chunks out back to back.
+// ----------------------------------------------------------------------------
+
+class NeighborTable
+{
+public:
+	NeighborTable() {}
+
+	// Start a rebuild for the given number of particles split in chunks
+	void Begin(unsigned int iParticleCount, unsigned int iChunkCount);
+
+	// Staging buffer of a chunk - append the fluid then the deformable neighbors of each row, in particle order
+	inline std::vector<int>& GetChunkBuffer(unsigned int iChunk) { return m_ChunkIndices[iChunk]; }
+	void SetRowCounts(unsigned int iParticleIndex, unsigned int iFluidCount, unsigned int iSoftCount);
+
+	// Compute the row offsets and gather the chunks into the flat index array
+	void Finalize();
+
+	inline NeighborSpan GetFluidNeighbors(unsigned int iParticleIndex) const
+	{
+		return NeighborSpan(m_Indices.data() + m_Offsets[iParticleIndex], m_Indices.data() + m_SoftOffsets[iParticleIndex]);
+	}
+
+	inline NeighborSpan GetSoftNeighbors(unsigned int iParticleIndex) const
+	{
+		return NeighborSpan(m_Indices.data() + m_SoftOffsets[iParticleIndex], m_Indices.data() + m_Offsets[iParticleIndex + 1]);
+	}
+
+	// Position of the first fluid neighbor of a particle in the flat index array
+	inline unsigned int GetRowOffset(unsigned int iParticleIndex) const { return m_Offsets[iParticleIndex]; }
+
+	inline unsigned int GetParticleCount() const { return m_SoftOffsets.size(); }
+	inline unsigned int GetNeighborCount() const { return m_Indices.size(); }
+
+private:
+	// Prevent accidental copies of the table
+	NeighborTable(NeighborTable const&) = delete;
+	void operator=(NeighborTable const&) = delete;
+
+	std::vector<unsigned int> m_Offsets;
+	std::vector<unsigned int> m_SoftOffsets;
+	std::vector<int> m_Indices;
+
+	std::vector<std::vector<int>> m_ChunkIndices;
+};
+
+#endif // NEIGHBORTABLE_H
@@ -7,7 +7,6 @@
 #include "BaseParticle.h"
 
 class DeformableParticle;
-class FluidParticle;
 
 class ParticleManager
 {
@@ -36,18 +35,11 @@ public:
 		{
 			m_DeformableParticleList.push_back((DeformableParticle*)pParticle);
 		}
-		if (pParticle->ParticleType == ParticleType::FluidParticle)
-		{
-			m_FluidParticleList.push_back((FluidParticle*)pParticle);
-		}
 	}
 	inline std::vector<BaseParticle*>& GetParticles() { return m_ParticleList; }
 	inline unsigned int GlobalParticleListSize() { return m_ParticleList.size(); }	
 	inline BaseParticle* GetParticle(int iIndex) { return m_ParticleList[iIndex]; }
 
-	inline std::vector<FluidParticle*>& GetFluidParticles() { return m_FluidParticleList; }
-	inline FluidParticle* GetFluidParticle(int iIndex) { return m_FluidParticleList[iIndex]; }
-
 	inline std::vector<DeformableParticle*>& GetDeformableParticles() { return m_DeformableParticleList; }
 	inline DeformableParticle* GetDeformableParticle(int iIndex) { return m_DeformableParticleList[iIndex]; }
 
@@ -67,7 +59,6 @@ private:
 
 	std::vector<BaseParticle*> m_ParticleList;
 	std::vector<DeformableParticle*> m_DeformableParticleList;
-	std::vector<FluidParticle*> m_FluidParticleList;
 };
 
 #endif // PARTICLEMANAGER_H
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include "PerfCounters.h"
+
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif // __linux__
+
+// ------------------------------------------------------------------------
+
+PerfCounterGroup::PerfCounterGroup()
+	: m_iOpenCount(0)
+{
+	for (unsigned int i = 0; i < PERF_COUNTER_COUNT; i++)
+	{
+		m_FileDescriptors[i] = -1;
+		m_GroupOrder[i] = 0;
+	}
+}
+
+// ------------------------------------------------------------------------
+
+PerfCounterGroup::~PerfCounterGroup()
+{
+	Close();
+}
+
+// ------------------------------------------------------------------------
+
+#ifdef __linux__
+
+static int OpenCounter(PerfCounter counter, int iGroupFileDescriptor)
+{
+	perf_event_attr attributes;
+	memset(&attributes, 0, sizeof(attributes));
+	attributes.size = sizeof(attributes);
+
+	switch (counter)
+	{
+		case PerfCounter::Cycles:
+			attributes.type = PERF_TYPE_HARDWARE;
+			attributes.config = PERF_COUNT_HW_CPU_CYCLES;
+			break;
+		case PerfCounter::Instructions:
+			attributes.type = PERF_TYPE_HARDWARE;
+			attributes.config = PERF_COUNT_HW_INSTRUCTIONS;
+			break;
+		case PerfCounter::L1DMisses:
+			attributes.type = PERF_TYPE_HW_CACHE;
+			attributes.config = PERF_COUNT_HW_CACHE_L1D |
+				(PERF_COUNT_HW_CACHE_OP_READ << 8) |
+				(PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+			break;
+		case PerfCounter::LLCMisses:
+			attributes.type = PERF_TYPE_HARDWARE;
+			attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+			break;
+		case PerfCounter::BranchMisses:
+			attributes.type = PERF_TYPE_HARDWARE;
+			attributes.config = PERF_COUNT_HW_BRANCH_MISSES;
+			break;
+		default:
+			return -1;
+	}
+
+	// User space of the calling thread on any CPU. The leader starts disabled and
+	// enables the whole group once every member has joined.
+	attributes.disabled = iGroupFileDescriptor < 0 ? 1 : 0;
+	attributes.exclude_kernel = 1;
+	attributes.exclude_hv = 1;
+	attributes.read_format = PERF_FORMAT_GROUP;
+
+	return (int)syscall(SYS_perf_event_open, &attributes, 0, -1, iGroupFileDescriptor, 0);
+}
+
+#endif // __linux__
+
+// ------------------------------------------------------------------------
+
+bool PerfCounterGroup::Open()
+{
+	Close();
+
+#ifdef __linux__
+
+	int iLeader = -1;
+
+	for (unsigned int i = 0; i < PERF_COUNTER_COUNT; i++)
+	{
+		int iFileDescriptor = OpenCounter((PerfCounter)i, iLeader);
+		if (iFileDescriptor < 0)
+		{
+			continue;
+		}
+
+		if (iLeader < 0)
+		{
+			iLeader = iFileDescriptor;
+		}
+
+		m_FileDescriptors[i] = iFileDescriptor;
+		m_GroupOrder[m_iOpenCount++] = i;
+	}
+
+	if (iLeader >= 0)
+	{
+		ioctl(iLeader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(iLeader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+
+#endif // __linux__
+
+	return IsOpen();
+}
+
+// ------------------------------------------------------------------------
+
+void PerfCounterGroup::Close()
+{
+#ifdef __linux__
+	for (unsigned int i = 0; i < PERF_COUNTER_COUNT; i++)
+	{
+		if (m_FileDescriptors[i] >= 0)
+		{
+			close(m_FileDescriptors[i]);
+		}
+	}
+#endif // __linux__
+
+	for (unsigned int i = 0; i < PERF_COUNTER_COUNT; i++)
+	{
+		m_FileDescriptors[i] = -1;
+	}
+
+	m_iOpenCount = 0;
+}
+
+// ------------------------------------------------------------------------
+
+bool PerfCounterGroup::Read(PerfCounterValues& values) const
+{
+	memset(&values, 0, sizeof(values));
+
+	if (!IsOpen())
+	{
+		return false;
+	}
+
+#ifdef __linux__
+
+	// Group read format - the number of counters followed by their values
+	unsigned long long buffer[PERF_COUNTER_COUNT + 1];
+	ssize_t iSize = read(m_FileDescriptors[m_GroupOrder[0]], buffer, sizeof(buffer));
+	if (iSize < (ssize_t)sizeof(unsigned long long) || buffer[0] != m_iOpenCount)
+	{
+		return false;
+	}
+
+	for (unsigned int i = 0; i < m_iOpenCount; i++)
+	{
+		values.Value[m_GroupOrder[i]] = buffer[i + 1];
+	}
+
+	return true;
+
+#else
+
+	return false;
+
+#endif // __linux__
+}
+
+// ------------------------------------------------------------------------
+
+const char* PerfCounterGroup::GetCounterName(PerfCounter counter)
+{
+	switch (counter)
+	{
+		case PerfCounter::Cycles:		return "cycles";
+		case PerfCounter::Instructions:	return "instructions";
+		case PerfCounter::L1DMisses:	return "l1d_misses";
+		case PerfCounter::LLCMisses:	return "llc_misses";
+		case PerfCounter::BranchMisses:	return "branch_misses";
+		default:						return "invalid";
+	}
+}
+
+// ------------------------------------------------------------------------
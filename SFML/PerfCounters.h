@@ -0,0 +1,61 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include "Common.h"
+
+// ----------------------------------------------------------------------------
+// Hardware performance counters of the calling thread, read with Linux
+// perf_event. The counters are opened as a single group so that they are
+// scheduled on the PMU together and read with one system call. Counters the
+// machine does not support are left out of the group; on other platforms
+// nothing can be opened.
+// ----------------------------------------------------------------------------
+
+enum class PerfCounter
+{
+	Cycles,
+	Instructions,
+	L1DMisses,
+	LLCMisses,
+	BranchMisses,
+
+	Count
+};
+
+const unsigned int PERF_COUNTER_COUNT = (unsigned int)PerfCounter::Count;
+
+struct PerfCounterValues
+{
+	unsigned long long Value[PERF_COUNTER_COUNT];
+};
+
+class PerfCounterGroup
+{
+public:
+	PerfCounterGroup();
+	~PerfCounterGroup();
+
+	// Open the counters for the calling thread, returns false if none could be opened
+	bool Open();
+	void Close();
+
+	inline bool IsOpen() const { return m_iOpenCount > 0; }
+	inline bool IsAvailable(PerfCounter counter) const { return m_FileDescriptors[(unsigned int)counter] >= 0; }
+
+	// Current values, the counters which are not available read 0
+	bool Read(PerfCounterValues& values) const;
+
+	static const char* GetCounterName(PerfCounter counter);
+
+private:
+	PerfCounterGroup(const PerfCounterGroup&);
+	PerfCounterGroup& operator=(const PerfCounterGroup&);
+
+	int m_FileDescriptors[PERF_COUNTER_COUNT];
+
+	// Counter of each value of a group read, in the order they joined the group
+	unsigned int m_GroupOrder[PERF_COUNTER_COUNT];
+	unsigned int m_iOpenCount;
+};
+
+#endif // PERFCOUNTERS_H
@@ -0,0 +1,305 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <string.h>
+
+// ------------------------------------------------------------------------
+
+Profiler::Profiler()
+	: m_FrameTimes(WINDOW_SIZE * PROFILE_PHASE_COUNT, 0.0),
+	m_iFrameCount(0),
+	m_iLastFrame(0),
+	m_bTracing(false),
+	m_fTraceStartTime(0.0),
+	m_iTraceMask(0),
+	m_bCounters(false)
+{
+	memset(m_FrameCounters, 0, sizeof(m_FrameCounters));
+
+	Setup(1);
+}
+
+// ------------------------------------------------------------------------
+
+void Profiler::Setup(unsigned int iThreadCount)
+{
+	// Never shrinks so a slot stays valid for a thread which is still running
+	if (iThreadCount > m_ThreadTimes.size())
+	{
+		ThreadTimes times = {};
+		m_ThreadTimes.resize(iThreadCount, times);
+
+		TraceBuffer buffer = {};
+		buffer.Events.resize(m_bTracing ? (size_t)m_iTraceMask + 1 : 0);
+		m_TraceBuffers.resize(iThreadCount, buffer);
+	}
+
+	while (m_ThreadCounters.size() < iThreadCount)
+	{
+		std::unique_ptr<ThreadCounters> pCounters(new ThreadCounters());
+		pCounters->OpenAttempted = false;
+		memset(pCounters->Count, 0, sizeof(pCounters->Count));
+		m_ThreadCounters.push_back(std::move(pCounters));
+	}
+
+	// The counters belong to the thread which opened them and the team may have new threads
+	for (unsigned int iThread = 0; iThread < m_ThreadCounters.size(); iThread++)
+	{
+		m_ThreadCounters[iThread]->Group.Close();
+		m_ThreadCounters[iThread]->OpenAttempted = false;
+	}
+}
+
+// ------------------------------------------------------------------------
+
+void Profiler::EndFrame()
+{
+	m_iLastFrame = m_iFrameCount % WINDOW_SIZE;
+	double* pFrame = &m_FrameTimes[m_iLastFrame * PROFILE_PHASE_COUNT];
+
+	for (unsigned int iPhase = 0; iPhase < PROFILE_PHASE_COUNT; iPhase++)
+	{
+		// The phases run in parallel, the slowest thread sets the pace
+		double fTime = 0.0;
+		for (unsigned int iThread = 0; iThread < m_ThreadTimes.size(); iThread++)
+		{
+			fTime = std::max(fTime, m_ThreadTimes[iThread].Time[iPhase]);
+			m_ThreadTimes[iThread].Time[iPhase] = 0.0;
+		}
+
+		pFrame[iPhase] = fTime;
+
+		// Events add up over the threads
+		for (unsigned int iCounter = 0; iCounter < PERF_COUNTER_COUNT; iCounter++)
+		{
+			unsigned long long iCount = 0;
+			for (unsigned int iThread = 0; iThread < m_ThreadCounters.size(); iThread++)
+			{
+				iCount += m_ThreadCounters[iThread]->Count[iPhase][iCounter];
+				m_ThreadCounters[iThread]->Count[iPhase][iCounter] = 0;
+			}
+
+			m_FrameCounters[iPhase][iCounter] = iCount;
+		}
+	}
+
+	m_iFrameCount++;
+}
+
+// ------------------------------------------------------------------------
+
+double Profiler::GetLastFrameTime(ProfilePhase phase) const
+{
+	return m_iFrameCount > 0 ? m_FrameTimes[m_iLastFrame * PROFILE_PHASE_COUNT + (unsigned int)phase] : 0.0;
+}
+
+// ------------------------------------------------------------------------
+
+std::vector<double> Profiler::GetWindow(ProfilePhase phase) const
+{
+	unsigned int iFrameCount = std::min(m_iFrameCount, WINDOW_SIZE);
+
+	std::vector<double> times(iFrameCount);
+	for (unsigned int iFrame = 0; iFrame < iFrameCount; iFrame++)
+	{
+		times[iFrame] = m_FrameTimes[iFrame * PROFILE_PHASE_COUNT + (unsigned int)phase];
+	}
+
+	return times;
+}
+
+// ------------------------------------------------------------------------
+
+double Profiler::GetAverageTime(ProfilePhase phase) const
+{
+	std::vector<double> times = GetWindow(phase);
+
+	double fSum = 0.0;
+	for (unsigned int i = 0; i < times.size(); i++)
+	{
+		fSum += times[i];
+	}
+
+	return times.empty() ? 0.0 : fSum / times.size();
+}
+
+// ------------------------------------------------------------------------
+
+double Profiler::GetPercentileTime(ProfilePhase phase, double fPercentile) const
+{
+	std::vector<double> times = GetWindow(phase);
+	std::sort(times.begin(), times.end());
+
+	return NearestRankPercentile(times, fPercentile);
+}
+
+// ------------------------------------------------------------------------
+
+const char* Profiler::GetPhaseName(ProfilePhase phase)
+{
+	switch (phase)
+	{
+		case ProfilePhase::FluidReorder:			return "Reorder";
+		case ProfilePhase::FluidPrediction:			return "Prediction";
+		case ProfilePhase::FluidNeighborSearch:		return "Neighbor search";
+		case ProfilePhase::FluidLambda:				return "Lambda";
+		case ProfilePhase::FluidPositionCorrection:	return "Position correction";
+		case ProfilePhase::FluidMTD:				return "Fluid MTD";
+		case ProfilePhase::FluidSoftCoupling:		return "Soft body coupling";
+		case ProfilePhase::FluidVelocityUpdate:		return "Velocity update";
+		case ProfilePhase::SoftBodyShapeMatching:	return "Shape matching";
+		case ProfilePhase::SoftBodyCollisions:		return "Soft body collisions";
+		case ProfilePhase::SoftBodyIntegrate:		return "Soft body integrate";
+		case ProfilePhase::Draw:					return "Draw";
+		case ProfilePhase::BarrierWait:				return "Barrier wait";
+		default:									return "Invalid";
+	}
+}
+
+// ------------------------------------------------------------------------
+
+std::string Profiler::GetBreakdownString() const
+{
+	std::string breakdown = "Phase: avg p50 p99 (ms)\n";
+
+	for (unsigned int iPhase = 0; iPhase < PROFILE_PHASE_COUNT; iPhase++)
+	{
+		ProfilePhase phase = (ProfilePhase)iPhase;
+
+		breakdown += std::string(GetPhaseName(phase)) + ": " +
+			std::to_string(GetAverageTime(phase) * 1000.0) + " " +
+			std::to_string(GetPercentileTime(phase, 50.0) * 1000.0) + " " +
+			std::to_string(GetPercentileTime(phase, 99.0) * 1000.0) + "\n";
+	}
+
+	return breakdown;
+}
+
+// ------------------------------------------------------------------------
+
+void Profiler::StartTrace(unsigned int iEventsPerThread)
+{
+	// Power of two capacity so that the ring buffer index is a mask
+	unsigned int iCapacity = 1;
+	while (iCapacity < iEventsPerThread)
+	{
+		iCapacity <<= 1;
+	}
+
+	m_iTraceMask = iCapacity - 1;
+	m_fTraceStartTime = GetHighResolutionTime();
+
+	for (unsigned int iThread = 0; iThread < m_TraceBuffers.size(); iThread++)
+	{
+		m_TraceBuffers[iThread].Events.resize(iCapacity);
+		m_TraceBuffers[iThread].EventCount = 0;
+	}
+
+	m_bTracing = true;
+}
+
+// ------------------------------------------------------------------------
+
+void Profiler::StopTrace()
+{
+	m_bTracing = false;
+}
+
+// ------------------------------------------------------------------------
+
+bool Profiler::WriteTrace(const std::string& fileName) const
+{
+	std::ofstream outFile(fileName);
+	if (!outFile.is_open())
+	{
+		return false;
+	}
+
+	// Microseconds with a fixed precision, the default one switches to exponents
+	outFile << std::fixed << std::setprecision(3);
+
+	outFile << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl;
+
+	bool bFirstEvent = true;
+
+	for (unsigned int iThread = 0; iThread < m_TraceBuffers.size(); iThread++)
+	{
+		const TraceBuffer& buffer = m_TraceBuffers[iThread];
+
+		// Thread 0 is the main thread, it also updates the soft bodies and draws
+		outFile << (bFirstEvent ? "" : ",\n") <<
+			"{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << iThread <<
+			", \"args\": {\"name\": \"" << (iThread == 0 ? "Main thread" : "Worker " + std::to_string(iThread)) << "\"}}";
+		bFirstEvent = false;
+
+		// Oldest event first
+		unsigned long long iCapacity = buffer.Events.size();
+		unsigned long long iFirstEvent = buffer.EventCount > iCapacity ? buffer.EventCount - iCapacity : 0;
+
+		for (unsigned long long iEvent = iFirstEvent; iEvent < buffer.EventCount; iEvent++)
+		{
+			const TraceEvent& event = buffer.Events[iEvent & m_iTraceMask];
+
+			// Complete events, times in microseconds since the start of the trace
+			outFile << ",\n{\"name\": \"" << GetPhaseName(event.Phase) << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << iThread <<
+				", \"ts\": " << (event.StartTime - m_fTraceStartTime) * 1000000.0 <<
+				", \"dur\": " << (event.EndTime - event.StartTime) * 1000000.0 << "}";
+		}
+	}
+
+	outFile << std::endl << "]}" << std::endl;
+
+	return true;
+}
+
+// ------------------------------------------------------------------------
+
+void Profiler::EnableCounters(bool bEnable)
+{
+	m_bCounters = bEnable;
+}
+
+// ------------------------------------------------------------------------
+
+bool Profiler::ReadCounters(unsigned int iThread, PerfCounterValues& values)
+{
+	ThreadCounters& counters = *m_ThreadCounters[iThread];
+
+	if (!counters.OpenAttempted)
+	{
+		counters.OpenAttempted = true;
+		counters.Group.Open();
+	}
+
+	return counters.Group.Read(values);
+}
+
+// ------------------------------------------------------------------------
+
+void Profiler::AddCounters(unsigned int iThread, ProfilePhase phase, const PerfCounterValues& startValues, const PerfCounterValues& endValues)
+{
+	unsigned long long* pCount = m_ThreadCounters[iThread]->Count[(unsigned int)phase];
+
+	for (unsigned int iCounter = 0; iCounter < PERF_COUNTER_COUNT; iCounter++)
+	{
+		pCount[iCounter] += endValues.Value[iCounter] - startValues.Value[iCounter];
+	}
+}
+
+// ------------------------------------------------------------------------
+
+unsigned long long Profiler::GetLastFrameCounter(ProfilePhase phase, PerfCounter counter) const
+{
+	return m_FrameCounters[(unsigned int)phase][(unsigned int)counter];
+}
+
+// ------------------------------------------------------------------------
+
+bool Profiler::IsCounterAvailable(PerfCounter counter) const
+{
+	return m_ThreadCounters[0]->Group.IsAvailable(counter);
+}
+
+// ------------------------------------------------------------------------
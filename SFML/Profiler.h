@@ -0,0 +1,227 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "Common.h"
+#include "AlignedAllocator.h"
+#include "PerfCounters.h"
+
+// ----------------------------------------------------------------------------
+// Per phase timers of the simulation step and of the draw. Each thread adds
+// the time it spends in a phase to its own slot, EndFrame then keeps the
+// slowest thread's time of every phase in a rolling window of frames.
+//
+// While tracing, every timed scope is also recorded as an event in a ring
+// buffer owned by its thread and the events can be written as a Chrome
+// trace (chrome://tracing or ui.perfetto.dev).
+//
+// With the hardware counters enabled each thread also opens its own
+// perf_event counters and every scope adds their change to its phase.
+// Reading them costs a system call per scope, which shows in the timings.
+//
+// The PROFILE_SCOPE macros compile to nothing without PROFILING (Common.h).
+// ----------------------------------------------------------------------------
+
+enum class ProfilePhase
+{
+	FluidReorder,				// Z-order sort of the fluid particles
+	FluidPrediction,			// External forces, damping and predicted positions
+	FluidNeighborSearch,		// Grids and neighbor lists
+	FluidLambda,				// Density constraint and lambda
+	FluidPositionCorrection,	// Position correction from the lambda values
+	FluidMTD,					// Fluid particles inside the soft body hulls
+	FluidSoftCoupling,			// Fluid-deformable collisions, container constraints and the deformable corrections
+	FluidVelocityUpdate,		// Velocities and XSPH viscosity
+	SoftBodyShapeMatching,		// External forces and shape matching
+	SoftBodyCollisions,			// Deformable particle MTD and collisions
+	SoftBodyIntegrate,			// Integration, convex hull and bezier curve
+	Draw,
+	BarrierWait,				// Threads waiting for each other between two phases
+
+	Count
+};
+
+const unsigned int PROFILE_PHASE_COUNT = (unsigned int)ProfilePhase::Count;
+
+class Profiler
+{
+public:
+
+	static Profiler& GetInstance()
+	{
+		static Profiler instance;
+		return instance;
+	}
+
+	// Make room for iThreadCount threads. Not thread safe.
+	void Setup(unsigned int iThreadCount);
+
+	inline void AddTime(unsigned int iThread, ProfilePhase phase, double fTime) { m_ThreadTimes[iThread].Time[(unsigned int)phase] += fTime; }
+
+	// Close the current frame - called once per frame by the thread which runs the simulations
+	void EndFrame();
+
+	// Times in seconds. The average and percentiles are computed over the frames in the window.
+	double GetLastFrameTime(ProfilePhase phase) const;
+	double GetAverageTime(ProfilePhase phase) const;
+	double GetPercentileTime(ProfilePhase phase, double fPercentile) const;
+
+	inline unsigned int GetFrameCount() const { return m_iFrameCount; }
+
+	static const char* GetPhaseName(ProfilePhase phase);
+
+	// One line per phase with the average, p50 and p99 in milliseconds
+	std::string GetBreakdownString() const;
+
+	// Start recording events, keeping the last iEventsPerThread of each thread. Start, stop and write
+	// the trace between frames, while no thread is timing a phase.
+	void StartTrace(unsigned int iEventsPerThread = 1 << 18);
+	void StopTrace();
+	inline bool IsTracing() const { return m_bTracing; }
+
+	// Write the recorded events in the Chrome trace event format, returns false if the file can't be opened
+	bool WriteTrace(const std::string& fileName) const;
+
+	inline void RecordEvent(unsigned int iThread, ProfilePhase phase, double fStartTime, double fEndTime)
+	{
+		// Only the thread itself writes to its buffer
+		TraceBuffer& buffer = m_TraceBuffers[iThread];
+		TraceEvent& event = buffer.Events[buffer.EventCount++ & m_iTraceMask];
+		event.StartTime = fStartTime;
+		event.EndTime = fEndTime;
+		event.Phase = phase;
+	}
+
+	// Start or stop counting hardware events. Not thread safe.
+	void EnableCounters(bool bEnable);
+	inline bool IsCountingEvents() const { return m_bCounters; }
+
+	// Counters of the calling thread, opened the first time the thread reads them
+	bool ReadCounters(unsigned int iThread, PerfCounterValues& values);
+	void AddCounters(unsigned int iThread, ProfilePhase phase, const PerfCounterValues& startValues, const PerfCounterValues& endValues);
+
+	// Events counted during the last frame by all the threads
+	unsigned long long GetLastFrameCounter(ProfilePhase phase, PerfCounter counter) const;
+
+	// The counters of the main thread, the machine or the permissions may not allow all of them
+	bool IsCounterAvailable(PerfCounter counter) const;
+
+private:
+
+	Profiler();
+
+	// Each thread accumulates on its own cache lines
+	struct CACHE_ALIGNED ThreadTimes
+	{
+		double Time[PROFILE_PHASE_COUNT];
+	};
+
+	struct ThreadCounters
+	{
+		PerfCounterGroup Group;
+		bool OpenAttempted;
+		unsigned long long Count[PROFILE_PHASE_COUNT][PERF_COUNTER_COUNT];
+	};
+
+	struct TraceEvent
+	{
+		double StartTime;
+		double EndTime;
+		ProfilePhase Phase;
+	};
+
+	// Ring buffer of the events of a thread. The event count keeps growing, the oldest
+	// events are overwritten once it exceeds the capacity.
+	struct CACHE_ALIGNED TraceBuffer
+	{
+		std::vector<TraceEvent> Events;
+		unsigned long long EventCount;
+	};
+
+	static const unsigned int WINDOW_SIZE = 120;
+
+	CacheAlignedVector<ThreadTimes> m_ThreadTimes;
+
+	// Ring buffer of the last WINDOW_SIZE frames, phase after phase
+	std::vector<double> m_FrameTimes;
+	unsigned int m_iFrameCount;
+	unsigned int m_iLastFrame;
+
+	// Tracing
+	bool m_bTracing;
+	double m_fTraceStartTime;
+	unsigned long long m_iTraceMask;
+	CacheAlignedVector<TraceBuffer> m_TraceBuffers;
+
+	// Hardware counters
+	bool m_bCounters;
+	std::vector<std::unique_ptr<ThreadCounters>> m_ThreadCounters;
+	unsigned long long m_FrameCounters[PROFILE_PHASE_COUNT][PERF_COUNTER_COUNT];
+
+	std::vector<double> GetWindow(ProfilePhase phase) const;
+};
+
+// ----------------------------------------------------------------------------
+
+// Adds the time between its construction and destruction to a phase
+class ProfileScope
+{
+public:
+	ProfileScope(ProfilePhase phase, unsigned int iThread)
+		: m_Phase(phase),
+		m_iThread(iThread),
+		m_bCounters(Profiler::GetInstance().IsCountingEvents())
+	{
+		// The counters are read outside of the timed part
+		if (m_bCounters)
+		{
+			Profiler::GetInstance().ReadCounters(m_iThread, m_StartCounters);
+		}
+
+		m_fStartTime = GetHighResolutionTime();
+	}
+
+	~ProfileScope()
+	{
+		double fEndTime = GetHighResolutionTime();
+
+		Profiler& profiler = Profiler::GetInstance();
+		profiler.AddTime(m_iThread, m_Phase, fEndTime - m_fStartTime);
+
+		if (profiler.IsTracing())
+		{
+			profiler.RecordEvent(m_iThread, m_Phase, m_fStartTime, fEndTime);
+		}
+
+		if (m_bCounters)
+		{
+			PerfCounterValues endCounters;
+			profiler.ReadCounters(m_iThread, endCounters);
+			profiler.AddCounters(m_iThread, m_Phase, m_StartCounters, endCounters);
+		}
+	}
+
+private:
+	ProfilePhase m_Phase;
+	unsigned int m_iThread;
+	bool m_bCounters;
+	double m_fStartTime;
+	PerfCounterValues m_StartCounters;
+};
+
+#ifdef PROFILING
+#define PROFILE_CONCATENATE_INNER(a, b) a##b
+#define PROFILE_CONCATENATE(a, b) PROFILE_CONCATENATE_INNER(a, b)
+#define PROFILE_SCOPE(phase) ProfileScope PROFILE_CONCATENATE(profileScope, __LINE__)(phase, 0)
+#define PROFILE_THREAD_SCOPE(phase, iThread) ProfileScope PROFILE_CONCATENATE(profileScope, __LINE__)(phase, iThread)
+#define PROFILE_END_FRAME() Profiler::GetInstance().EndFrame()
+#else
+#define PROFILE_SCOPE(phase)
+#define PROFILE_THREAD_SCOPE(phase, iThread)
+#define PROFILE_END_FRAME()
+#endif // PROFILING
+
+#endif // PROFILER_H
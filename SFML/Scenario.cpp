@@ -0,0 +1,189 @@
+#include "Scenario.h"
+
+#include <stdlib.h>
+
+#include "FluidSimulation.h"
+#include "SoftBody.h"
+#include "SimulationManager.h"
+
+// ------------------------------------------------------------------------
+
+Scenario::Scenario()
+	: Name("default"),
+	FluidWidthCount(40),
+	FluidHeightCount(40),
+	SoftBodyCount(5),
+	SoftBodyWidth(6),
+	SoftBodyHeight(6),
+	ThreadCount(0),
+	ReorderInterval(60),
+	StepCount(1000),
+	WarmUpSteps(100),
+	Seed(1),
+	Deterministic(false)
+{
+}
+
+// ------------------------------------------------------------------------
+
+static Scenario MakePreset(const std::string& name, int iFluidSize, int iSoftBodyCount, unsigned int iThreadCount)
+{
+	Scenario scenario;
+	scenario.Name = name;
+	scenario.FluidWidthCount = iFluidSize;
+	scenario.FluidHeightCount = iFluidSize;
+	scenario.SoftBodyCount = iSoftBodyCount;
+	scenario.ThreadCount = iThreadCount;
+	return scenario;
+}
+
+// Presets:
+//   default            - the scene of the application, 1600 fluid particles and 5 soft bodies
+//   fluid900..4900     - benchmarkFluid.txt, fluid only. The file sweeps the thread count, use --threads.
+//   interaction900..   - benchmarkInteraction*.txt, 6 threads and the largest recorded soft body count
+//                        (22 bodies of 6x6 particles). The files sweep the soft body count, use --soft-bodies.
+//   reorder            - single threaded fluid with reordering every 60 steps, the largest block that fits
+//                        the container. Compare against --reorder-interval 0, with --counters for the misses.
+//   softbody160        - 160 soft bodies of 6x6 particles stacked in rows over a small block of fluid
+static std::vector<Scenario> GetPresets()
+{
+	std::vector<Scenario> presets;
+
+	presets.push_back(MakePreset("default", 40, 5, 0));
+
+	presets.push_back(MakePreset("fluid900", 30, 0, 0));
+	presets.push_back(MakePreset("fluid2500", 50, 0, 0));
+	presets.push_back(MakePreset("fluid4900", 70, 0, 0));
+
+	presets.push_back(MakePreset("interaction900", 30, 22, 6));
+	presets.push_back(MakePreset("interaction2500", 50, 22, 6));
+	presets.push_back(MakePreset("interaction4900", 70, 22, 6));
+
+	presets.push_back(MakePreset("softbody160", 30, 160, 0));
+
+	Scenario reorder = MakePreset("reorder", 70, 0, 1);
+	reorder.WarmUpSteps = 600;
+	reorder.StepCount = 600;
+	presets.push_back(reorder);
+
+	return presets;
+}
+
+// ------------------------------------------------------------------------
+
+bool GetScenarioPreset(const std::string& name, Scenario& scenario)
+{
+	std::vector<Scenario> presets = GetPresets();
+
+	for (unsigned int i = 0; i < presets.size(); i++)
+	{
+		if (presets[i].Name == name)
+		{
+			scenario = presets[i];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// ------------------------------------------------------------------------
+
+std::vector<std::string> GetScenarioPresetNames()
+{
+	std::vector<Scenario> presets = GetPresets();
+	std::vector<std::string> names;
+
+	for (unsigned int i = 0; i < presets.size(); i++)
+	{
+		names.push_back(presets[i].Name);
+	}
+
+	return names;
+}
+
+// ------------------------------------------------------------------------
+
+FluidSimulation* BuildScenario(const Scenario& scenario)
+{
+	FluidSimulation* fluidSim = new FluidSimulation();
+
+	// The simulation seeds with the time in its constructor
+	srand(scenario.Seed);
+
+	fluidSim->BuildParticleSystem(glm::vec2(100.0f, 150.0f), sf::Color::Blue, scenario.FluidWidthCount, scenario.FluidHeightCount);
+	fluidSim->SetReorderInterval(scenario.ReorderInterval);
+	fluidSim->SetDeterministic(scenario.Deterministic);
+
+#ifdef MULTITHREADING
+	if (scenario.ThreadCount > 0)
+	{
+		fluidSim->SetThreadCount(scenario.ThreadCount);
+	}
+
+	fluidSim->SetupMultithread();
+#endif // MULTITHREADING
+
+	SimulationManager::GetInstance().AddSimulation(fluidSim);
+
+	// ---------------------------------------------------------------------------
+	// Soft bodies - spread over the width of the container like in the application,
+	// starting a new row when they would overlap
+	int width = scenario.SoftBodyWidth;
+	int height = scenario.SoftBodyHeight;
+
+	float dt = 0.1f;
+	float fBodyWidth = width * ((PARTICLE_RADIUS * 2.0f) + dt);
+	float fBodyHeight = height * ((PARTICLE_RADIUS * 2.0f) + dt);
+
+	int iBodiesPerRow = std::max(scenario.SoftBodyCount, 1);
+	while (iBodiesPerRow > 1 &&
+		(CONTAINER_WIDTH - (float)(width * iBodiesPerRow)) / ((float)(iBodiesPerRow + 1)) < fBodyWidth + PARTICLE_RADIUS_TWO)
+	{
+		iBodiesPerRow--;
+	}
+
+	sf::Color randomColor = GetRandomColor();
+
+	for (int i = 0; i < scenario.SoftBodyCount; i++)
+	{
+		int iRow = i / iBodiesPerRow;
+		int iColumn = i % iBodiesPerRow;
+		int iRowCount = std::min(scenario.SoftBodyCount - iRow * iBodiesPerRow, iBodiesPerRow);
+
+		float fSeparatingOffset = (CONTAINER_WIDTH - (float)(width * iRowCount)) / ((float)(iRowCount + 1));
+		glm::vec2 startPosition = glm::vec2(WALL_LEFTLIMIT + fSeparatingOffset * (iColumn + 1),
+			200.0f + iRow * (fBodyHeight + PARTICLE_RADIUS_TWO * 2.0f));
+
+		SoftBody* softBodyInstance = new SoftBody();
+		SimulationManager::GetInstance().AddSimulation(softBodyInstance);
+
+		float startPosX = startPosition.x - width * PARTICLE_RADIUS;
+		float startPosY = startPosition.y - height * PARTICLE_RADIUS;
+		glm::vec2 currentPosition = glm::vec2(startPosX, startPosY);
+
+		for (int iLine = 0; iLine < height; iLine++)
+		{
+			currentPosition.x = startPosX;
+
+			for (int jColumn = 0; jColumn < width; jColumn++)
+			{
+				DeformableParticle* sbParticle = new DeformableParticle(glm::vec2(currentPosition.x,
+					currentPosition.y), randomColor, softBodyInstance->GetSimulationIndex());
+
+				sbParticle->SetParentRef(softBodyInstance);
+				softBodyInstance->AddSoftBodyParticle(*sbParticle);
+
+				currentPosition.x += (PARTICLE_RADIUS * 2.0f) + dt;
+			}
+
+			currentPosition.y += (PARTICLE_RADIUS * 2.0f) + dt;
+		}
+
+		softBodyInstance->BuildSoftBody();
+	}
+
+	return fluidSim;
+}
+
+// ------------------------------------------------------------------------
@@ -0,0 +1,52 @@
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <string>
+#include <vector>
+
+#include "Common.h"
+
+class FluidSimulation;
+
+// ----------------------------------------------------------------------------
+// Description of a scene run without a window: a block of fluid particles,
+// a number of soft bodies and the solver settings. The presets reproduce the
+// scenes recorded in the Benchmarks directory.
+// ----------------------------------------------------------------------------
+
+struct Scenario
+{
+	Scenario();
+
+	std::string Name;
+
+	// Block of fluid particles, FluidWidthCount particles per row
+	int FluidWidthCount;
+	int FluidHeightCount;
+
+	// Soft bodies of SoftBodyWidth x SoftBodyHeight particles
+	int SoftBodyCount;
+	int SoftBodyWidth;
+	int SoftBodyHeight;
+
+	// 0 keeps the default thread count (PBD_THREAD_COUNT or the hardware threads)
+	unsigned int ThreadCount;
+	unsigned int ReorderInterval;
+
+	unsigned int StepCount;
+	unsigned int WarmUpSteps;
+	unsigned int Seed;
+
+	// Reproducible steps for a given seed and thread count, see FluidSimulation::SetDeterministic
+	bool Deterministic;
+};
+
+// Fill the scenario with the named preset, returns false for an unknown name
+bool GetScenarioPreset(const std::string& name, Scenario& scenario);
+std::vector<std::string> GetScenarioPresetNames();
+
+// Create the fluid simulation and the soft bodies of the scenario and register them with
+// the simulation manager. The managers are singletons so a process builds a single scenario.
+FluidSimulation* BuildScenario(const Scenario& scenario);
+
+#endif // SCENARIO_H
@@ -0,0 +1,120 @@
+#include "SignedDistanceField.h"
+
+#include <math.h>
+#include <algorithm>
+#include <limits>
+
+// ------------------------------------------------------------------------
+
+void SignedDistanceField::Build(const std::vector<Edge>& edgeList, const glm::vec2& boundsMin, const glm::vec2& boundsMax)
+{
+	m_BoundsMin = boundsMin;
+	m_BoundsMax = boundsMax;
+
+	if (edgeList.size() < 3 || boundsMin.x > boundsMax.x || boundsMin.y > boundsMax.y)
+	{
+		m_iColumns = 0;
+		m_iRows = 0;
+		return;
+	}
+
+	// The hull may run clockwise or counterclockwise, the sign of its area tells which way is out
+	float fArea = 0.0f;
+	for (const Edge& e : edgeList)
+	{
+		fArea += e.Start->Position.x * e.End->Position.y - e.End->Position.x * e.Start->Position.y;
+	}
+	float fOrientation = fArea < 0.0f ? -1.0f : 1.0f;
+
+	m_EdgeNormals.clear();
+	m_EdgePoints.clear();
+
+	for (const Edge& e : edgeList)
+	{
+		glm::vec2 direction = e.End->Position - e.Start->Position;
+		float fLength = glm::length(direction);
+
+		// Particles on top of each other
+		if (fLength < EPS)
+		{
+			continue;
+		}
+
+		m_EdgeNormals.push_back(fOrientation * glm::vec2(direction.y, -direction.x) / fLength);
+		m_EdgePoints.push_back(e.Start->Position);
+	}
+
+	// At least two samples per axis to interpolate between
+	m_iColumns = std::max((int)ceil((boundsMax.x - boundsMin.x) * INVERSE_SIGNED_DISTANCE_CELL_SIZE) + 1, 2);
+	m_iRows = std::max((int)ceil((boundsMax.y - boundsMin.y) * INVERSE_SIGNED_DISTANCE_CELL_SIZE) + 1, 2);
+
+	m_Distance.resize(m_iColumns * m_iRows);
+	m_Gradient.resize(m_iColumns * m_iRows);
+
+	for (int iRow = 0; iRow < m_iRows; iRow++)
+	{
+		for (int iColumn = 0; iColumn < m_iColumns; iColumn++)
+		{
+			glm::vec2 samplePosition = boundsMin + glm::vec2((float)iColumn, (float)iRow) * SIGNED_DISTANCE_CELL_SIZE;
+
+			// The closest edge line, out through that edge
+			float fDistance = std::numeric_limits<float>::max();
+			glm::vec2 gradient(0.0f);
+
+			for (unsigned int i = 0; i < m_EdgeNormals.size(); i++)
+			{
+				float fEdgeDistance = -glm::dot(m_EdgeNormals[i], samplePosition - m_EdgePoints[i]);
+				if (fEdgeDistance < fDistance)
+				{
+					fDistance = fEdgeDistance;
+					gradient = m_EdgeNormals[i];
+				}
+			}
+
+			m_Distance[iColumn + iRow * m_iColumns] = fDistance;
+			m_Gradient[iColumn + iRow * m_iColumns] = gradient;
+		}
+	}
+}
+
+// ------------------------------------------------------------------------
+
+bool SignedDistanceField::Sample(const glm::vec2& position, float& fDistance, glm::vec2& gradient) const
+{
+	if (m_iColumns == 0 ||
+		position.x < m_BoundsMin.x || position.x > m_BoundsMax.x || position.y < m_BoundsMin.y || position.y > m_BoundsMax.y)
+	{
+		return false;
+	}
+
+	glm::vec2 cellPosition = (position - m_BoundsMin) * INVERSE_SIGNED_DISTANCE_CELL_SIZE;
+
+	int iColumn = std::min((int)cellPosition.x, m_iColumns - 2);
+	int iRow = std::min((int)cellPosition.y, m_iRows - 2);
+
+	float fx = cellPosition.x - iColumn;
+	float fy = cellPosition.y - iRow;
+
+	int iIndex = iColumn + iRow * m_iColumns;
+
+	float fTop = m_Distance[iIndex] + (m_Distance[iIndex + 1] - m_Distance[iIndex]) * fx;
+	float fBottom = m_Distance[iIndex + m_iColumns] + (m_Distance[iIndex + m_iColumns + 1] - m_Distance[iIndex + m_iColumns]) * fx;
+	fDistance = fTop + (fBottom - fTop) * fy;
+
+	if (fDistance <= 0.0f)
+	{
+		return false;
+	}
+
+	glm::vec2 top = m_Gradient[iIndex] + (m_Gradient[iIndex + 1] - m_Gradient[iIndex]) * fx;
+	glm::vec2 bottom = m_Gradient[iIndex + m_iColumns] + (m_Gradient[iIndex + m_iColumns + 1] - m_Gradient[iIndex + m_iColumns]) * fx;
+	gradient = top + (bottom - top) * fy;
+
+	// Opposite directions cancel out in the middle of a thin shape
+	float fLength = glm::length(gradient);
+	gradient = fLength > EPS ? gradient / fLength : glm::vec2(0.0f);
+
+	return true;
+}
+
+// ------------------------------------------------------------------------
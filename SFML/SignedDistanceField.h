@@ -0,0 +1,47 @@
+#ifndef SIGNEDDISTANCEFIELD_H
+#define SIGNEDDISTANCEFIELD_H
+
+#include <vector>
+
+#include "Common.h"
+#include "DeformableParticle.h"
+
+// ----------------------------------------------------------------------------
+// Signed distance to the outline of a soft body sampled on a grid over its
+// bounds, SIGNED_DISTANCE_CELL_SIZE apart: positive inside, negative outside.
+// Every sample also stores the direction out of the shape (the convention of
+// the GradientSignedDistance of the particles), a lookup interpolates both
+// bilinearly so the push out of a particle costs the same whatever the
+// shape. The field is rebuilt from the convex hull of the body every step,
+// where the distance of a sample is the smallest distance to the lines of
+// the edges - exact inside a convex polygon.
+// ----------------------------------------------------------------------------
+
+class SignedDistanceField
+{
+public:
+	SignedDistanceField() : m_iColumns(0), m_iRows(0) {}
+
+	// Sample the distance to a convex polygon over its bounds, fewer than 3 edges give an empty field
+	void Build(const std::vector<Edge>& edgeList, const glm::vec2& boundsMin, const glm::vec2& boundsMax);
+
+	// Distance to the outline and direction out of the shape at the position, false outside the shape
+	bool Sample(const glm::vec2& position, float& fDistance, glm::vec2& gradient) const;
+
+private:
+	glm::vec2 m_BoundsMin;
+	glm::vec2 m_BoundsMax;
+
+	int m_iColumns;
+	int m_iRows;
+
+	// Samples row by row, [column + row * m_iColumns]
+	std::vector<float> m_Distance;
+	std::vector<glm::vec2> m_Gradient;
+
+	// Outward normal and a point of every edge line
+	std::vector<glm::vec2> m_EdgeNormals;
+	std::vector<glm::vec2> m_EdgePoints;
+};
+
+#endif // SIGNEDDISTANCEFIELD_H
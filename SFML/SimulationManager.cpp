@@ -1 +1,135 @@
-#include "SimulationManager.h"
\ No newline at end of file
+#include "SimulationManager.h"
+
+#include "SoftBody.h"
+#include "SpatialPartition.h"
+#include "Profiler.h"
+
+// ------------------------------------------------------------------------
+
+void SimulationManager::UpdateSoftBodies(float dt, WorkerTeam* pWorkerTeam)
+{
+	m_ReadySoftBodies.clear();
+	for (SoftBody* pSoftBody : m_SoftBodyList)
+	{
+		if (pSoftBody->IsReady())
+		{
+			m_ReadySoftBodies.push_back(pSoftBody);
+		}
+	}
+
+	if (m_ReadySoftBodies.empty())
+	{
+		return;
+	}
+
+	m_fSoftBodyTimeStep = dt;
+
+	// The contacts of all the bodies are found in the same grid
+	SpatialPartition::GetInstance().UpdateSoftBodyGrid();
+
+#ifdef MULTITHREADING
+
+	if (pWorkerTeam != nullptr && pWorkerTeam->GetThreadCount() > 1 && m_ReadySoftBodies.size() > 1)
+	{
+		if (m_iSoftBodyThreadCount != pWorkerTeam->GetThreadCount())
+		{
+			m_iSoftBodyThreadCount = pWorkerTeam->GetThreadCount();
+			m_SoftBodyScheduler.Setup(m_iSoftBodyThreadCount);
+		}
+
+		pWorkerTeam->Run([this, pWorkerTeam](unsigned int iThread) { UpdateSoftBodiesThread(iThread, pWorkerTeam); });
+		return;
+	}
+
+#endif // MULTITHREADING
+
+	{
+		PROFILE_SCOPE(ProfilePhase::SoftBodyShapeMatching);
+
+		for (SoftBody* pSoftBody : m_ReadySoftBodies)
+		{
+			pSoftBody->PredictPositions(dt);
+		}
+	}
+
+	{
+		PROFILE_SCOPE(ProfilePhase::SoftBodyCollisions);
+
+		for (SoftBody* pSoftBody : m_ReadySoftBodies)
+		{
+			pSoftBody->SolveCollisions();
+		}
+	}
+
+	{
+		PROFILE_SCOPE(ProfilePhase::SoftBodyIntegrate);
+
+		for (SoftBody* pSoftBody : m_ReadySoftBodies)
+		{
+			pSoftBody->Finalize(dt);
+		}
+	}
+}
+
+// ------------------------------------------------------------------------
+
+void SimulationManager::UpdateSoftBodiesThread(unsigned int iThread, WorkerTeam* pWorkerTeam)
+{
+#ifdef MULTITHREADING
+	unsigned int iChunk, iStartIndex, iEndIndex;
+	unsigned int iBodyCount = m_ReadySoftBodies.size();
+
+	// Predicted positions of every body, the contacts are read from them
+	{
+		PROFILE_THREAD_SCOPE(ProfilePhase::SoftBodyShapeMatching, iThread);
+
+		m_SoftBodyScheduler.Begin(iThread, iBodyCount);
+		while (m_SoftBodyScheduler.Next(iThread, iChunk, iStartIndex, iEndIndex))
+		{
+			for (unsigned int i = iStartIndex; i < iEndIndex; i++)
+			{
+				m_ReadySoftBodies[i]->PredictPositions(m_fSoftBodyTimeStep);
+			}
+		}
+	}
+
+	{
+		PROFILE_THREAD_SCOPE(ProfilePhase::BarrierWait, iThread);
+		pWorkerTeam->Barrier(iThread);
+	}
+
+	// Collisions, the hulls and positions of the other bodies are only read until all of them are done
+	{
+		PROFILE_THREAD_SCOPE(ProfilePhase::SoftBodyCollisions, iThread);
+
+		m_SoftBodyScheduler.Begin(iThread, iBodyCount);
+		while (m_SoftBodyScheduler.Next(iThread, iChunk, iStartIndex, iEndIndex))
+		{
+			for (unsigned int i = iStartIndex; i < iEndIndex; i++)
+			{
+				m_ReadySoftBodies[i]->SolveCollisions();
+			}
+		}
+	}
+
+	{
+		PROFILE_THREAD_SCOPE(ProfilePhase::BarrierWait, iThread);
+		pWorkerTeam->Barrier(iThread);
+	}
+
+	{
+		PROFILE_THREAD_SCOPE(ProfilePhase::SoftBodyIntegrate, iThread);
+
+		m_SoftBodyScheduler.Begin(iThread, iBodyCount);
+		while (m_SoftBodyScheduler.Next(iThread, iChunk, iStartIndex, iEndIndex))
+		{
+			for (unsigned int i = iStartIndex; i < iEndIndex; i++)
+			{
+				m_ReadySoftBodies[i]->Finalize(m_fSoftBodyTimeStep);
+			}
+		}
+	}
+#endif // MULTITHREADING
+}
+
+// ------------------------------------------------------------------------
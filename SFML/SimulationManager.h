@@ -3,6 +3,13 @@
 
 #include "Common.h"
 #include "BaseSimulation.h"
+#include "ChunkScheduler.h"
+
+#ifdef MULTITHREADING
+#include "WorkerTeam.h"
+#else
+class WorkerTeam;
+#endif // MULTITHREADING
 
 class FluidSimulation;
 class SoftBody;
@@ -37,10 +44,15 @@ public:
 	inline std::vector<FluidSimulation*>&	GetFluidSimulationList()	{ return m_FluidSimulationList; }
 	inline std::vector<SoftBody*>&			GetSoftBodySimulationList() { return m_SoftBodyList; }
 
+	// Step all the ready soft bodies. With a worker team the bodies are spread over its threads, every stage
+	// of the step is done for all the bodies before the next one starts. A body only writes to its own
+	// particles so the result doesn't depend on the thread count.
+	void UpdateSoftBodies(float dt, WorkerTeam* pWorkerTeam);
+
 private:
 	// -----------------------------------------------------------------------------
 	// Hide constructor for singleton implementation
-	SimulationManager() {};
+	SimulationManager() : m_SoftBodyScheduler(1), m_iSoftBodyThreadCount(1), m_fSoftBodyTimeStep(0.0f) {};
 
 	// Delete unneeded copy constructor and assignment operator
 	SimulationManager(SimulationManager const&) = delete;
@@ -50,6 +62,15 @@ private:
 	std::vector<BaseSimulation*>	m_SimulationList;
 	std::vector<FluidSimulation*>	m_FluidSimulationList;
 	std::vector<SoftBody*>			m_SoftBodyList;
+
+	// Soft body step
+	void UpdateSoftBodiesThread(unsigned int iThread, WorkerTeam* pWorkerTeam);
+
+	std::vector<SoftBody*>			m_ReadySoftBodies;
+	// One body per chunk, the bodies are few and expensive
+	ChunkScheduler					m_SoftBodyScheduler;
+	unsigned int					m_iSoftBodyThreadCount;
+	float							m_fSoftBodyTimeStep;
 };
 
 #endif // SIMULATIONMANAGER_H
\ No newline at end of file
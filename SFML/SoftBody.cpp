@@ -29,105 +29,95 @@ SoftBody::SoftBody()
 	SimType = SimulationType::SoftBodySimulation;
 }
 
-void SoftBody::Update(float dt)
+void SoftBody::PredictPositions(float dt)
 {
-	if (m_bReady)
+	if (m_bBezierCurve)
 	{
-		if (m_bBezierCurve)
-		{
-			// Calculate the array of points which form the bezier curve
-			m_BezierCurve.CalculateMulticurveBezierPoints(m_BezierPoints);
-		}
+		// Calculate the array of points which form the bezier curve
+		m_BezierCurve.CalculateMulticurveBezierPoints(m_BezierPoints);
+	}
 
-		// Update external forces
-		UpdateForces(dt);
+	// Update external forces
+	UpdateForces(dt);
 
-		// Project positions
-		ShapeMatching(dt);
+	// Project positions
+	ShapeMatching(dt);
+}
 
-		// Project constraints
-		int iIteration = 0;
-		while (iIteration++ < SOLVER_ITERATIONS)
-		{
-			unsigned int deformableListSize = ParticleManager::GetInstance().GetDeformableParticles().size();
+void SoftBody::SolveCollisions()
+{
+	// The positions don't change during the iterations, neither do the contacts
+	// nor the distances into the other bodies
+	FindContacts();
 
-			// Update all particles in the soft body
-			for (unsigned int iIndex = 0; iIndex < m_iParticleListSize; iIndex++)
-			{
-				// Get the current particle in the soft body instance
-				DeformableParticle* pSoftParticle1 = m_ParticlesList[iIndex];
+	for (unsigned int iIndex = 0; iIndex < m_iParticleListSize; iIndex++)
+	{
+		m_ParticlesList[iIndex]->CalculateMinimumTranslationDistance();
+	}
 
-				// -----------------------------------------------------------------------------------
-				// Push out
+	// Project constraints
+	int iIteration = 0;
+	while (iIteration++ < SOLVER_ITERATIONS)
+	{
+		// Update all particles in the soft body
+		for (unsigned int iIndex = 0; iIndex < m_iParticleListSize; iIndex++)
+		{
+			// Get the current particle in the soft body instance
+			DeformableParticle* pSoftParticle1 = m_ParticlesList[iIndex];
 
-				pSoftParticle1->CalculateMinimumTranslationDistance();
-				// Signed distance field used to keep the deformable particle from penetrating the soft body
-				if (pSoftParticle1->SignedDistance > 0)
-				{
-					glm::vec2 fOffset = glm::vec2(0.0f);
-					// Get collision normal
-					glm::vec2 collisionNormal = pSoftParticle1->GradientSignedDistance;
-					// Calculate position adjustment
-					fOffset = 0.5f * pSoftParticle1->SignedDistance * collisionNormal;
-					// Apply offset - Position correction due to interaction with soft body
-					pSoftParticle1->PredictedPosition += fOffset * PBDSTIFFNESS_ADJUSTED;
-				}
-				
-				// -----------------------------------------------------------------------------------
+			// -----------------------------------------------------------------------------------
+			// Push out
 
-				// Check the current deformable particle against all other deformable particles
-				for (unsigned int iDeformableParticleIndex = 0; iDeformableParticleIndex < deformableListSize; iDeformableParticleIndex++)
-				{
-					// Get the instance of the other particle
-					DeformableParticle* pOtherParticle = ParticleManager::GetInstance().GetDeformableParticle(iDeformableParticleIndex);
+			// Signed distance field used to keep the deformable particle from penetrating the soft body
+			if (pSoftParticle1->SignedDistance > 0)
+			{
+				glm::vec2 fOffset = glm::vec2(0.0f);
+				// Get collision normal
+				glm::vec2 collisionNormal = pSoftParticle1->GradientSignedDistance;
+				// Calculate position adjustment
+				fOffset = 0.5f * pSoftParticle1->SignedDistance * collisionNormal;
+				// Apply offset - Position correction due to interaction with soft body
+				pSoftParticle1->PredictedPosition += fOffset * PBDSTIFFNESS_ADJUSTED;
+			}
+			
+			// -----------------------------------------------------------------------------------
 
-					// Make sure it's not within the same simulation
-					if (pSoftParticle1->GetParentIndex() != pOtherParticle->GetParentIndex())
-					{
-						if (pOtherParticle->GetParent()->IsReady())
-						{
-							// Check if there is a collision between particles
-							if (pSoftParticle1->IsCollidingStatic(*pOtherParticle))
-							{
-								// Particle-particle collision
-								glm::vec2 p1p2 = pSoftParticle1->Position - pOtherParticle->Position;
-								float fDistance = glm::length(p1p2);
-
-								glm::vec2 fDp1(0.0f);
-								glm::vec2 fDp2(0.0f);
-
-								if (fDistance != 0.0f)
-								{
-									fDp1 = -0.5f * (fDistance - PARTICLE_RADIUS_TWO) * (p1p2) / fDistance;
-									fDp2 = -fDp1;
-								}
-								
-								// Apply offset
-								pSoftParticle1->PositionCorrection += fDp1 * PBDSTIFFNESS_ADJUSTEDSB;
-								pOtherParticle->PositionCorrection += fDp2 * PBDSTIFFNESS_ADJUSTEDSB;
-							}
-						}
-					}
-				}
+			// Particle-particle collisions with the other soft bodies. The other body finds the same
+			// contact and moves its own particle, so only this particle is corrected - by both
+			// halves of the contact as it gets them from either side.
+			for (unsigned int iContact = m_ContactStart[iIndex]; iContact < m_ContactStart[iIndex + 1]; iContact++)
+			{
+				glm::vec2 fDp1 = m_Contacts[iContact].Offset;
+
+				// Apply offset
+				pSoftParticle1->PositionCorrection += 2.0f * fDp1 * PBDSTIFFNESS_ADJUSTEDSB;
 			}
 		}
+	}
+}
 
-		Integrate(dt);
+void SoftBody::Finalize(float dt)
+{
+	Integrate(dt);
 
-		// Update the convex hull based on the deformations
-		if (m_bDrawConvexHull)
-		{
-			m_ConvexHull.Initialize(m_ParticlesList);
-		}
+	SpatialPartition::GetInstance().CheckSoftBodyGridDisplacement(m_ParticlesList);
 
-		if (m_bBezierCurve)
-		{
-			// Update the position of the bezier points
-			m_BezierCurve.UpdateBezierPoints(m_ParticlesList);
-		}
+	// Update the convex hull based on the deformations
+	if (m_bDrawConvexHull)
+	{
+		m_ConvexHull.Update(m_ParticlesList);
+		m_SignedDistanceField.Build(m_ConvexHull.GetEdgeList(), m_ConvexHull.GetBoundsMin(), m_ConvexHull.GetBoundsMax());
+	}
+
+	if (m_bBezierCurve)
+	{
+		// Update the position of the bezier points
+		m_BezierCurve.UpdateBezierPoints(m_ParticlesList);
 	}
 }
 
+#ifndef HEADLESS
+
 void SoftBody::Draw(sf::RenderWindow& window)
 {	
 	if (m_bReady)
@@ -139,7 +129,7 @@ void SoftBody::Draw(sf::RenderWindow& window)
 			m_BezierCurve.DrawBezierCurve(window, m_BezierPoints);
 		}
 		
-		// Draw convex hull using the GrahamScan algorithm
+		// Draw the convex hull
 		if (m_bDrawConvexHull)
 		{
 			m_ConvexHull.Draw(window);
@@ -171,6 +161,8 @@ void SoftBody::Draw(sf::RenderWindow& window)
 	}
 }
 
+#endif // HEADLESS
+
 void SoftBody::ShapeMatching(float dt)
 {
 	// Project particle position
@@ -269,11 +261,6 @@ void SoftBody::ShapeMatching(float dt)
 
 		m_fStiffness = dt / SOFTBODY_STIFFNESS_VALUE;
 		currentParticle.PredictedPosition += SOFTBODY_STIFFNESS_VALUE * (currentParticle.GoalPosition - currentParticle.PredictedPosition);
-
-		if (m_bDrawGoalPositions)
-		{
-			currentParticle.UpdateGoalShapePosition();
-		}
 	}
 }
 
@@ -297,8 +284,111 @@ void SoftBody::Integrate(float dt)
 		// Update local position
 		glm::vec2 localOffset(WALL_LEFTLIMIT, WALL_TOPLIMIT);
 		currentParticle.LocalPosition = currentParticle.Position - localOffset;
+	}
+}
+
+void SoftBody::FindContacts()
+{
+	// The grid is brought up to date before the bodies are stepped
+	SpatialPartition& spatialPartition = SpatialPartition::GetInstance();
+
+	m_Contacts.clear();
+	m_ContactStart.assign(m_iParticleListSize + 1, 0);
+
+	// Bounds of the particles this body can touch
+	glm::vec2 boundsMin(std::numeric_limits<float>::max());
+	glm::vec2 boundsMax(-std::numeric_limits<float>::max());
+	for (unsigned int iIndex = 0; iIndex < m_iParticleListSize; iIndex++)
+	{
+		boundsMin = glm::min(boundsMin, m_ParticlesList[iIndex]->Position);
+		boundsMax = glm::max(boundsMax, m_ParticlesList[iIndex]->Position);
+	}
+	boundsMin -= glm::vec2(PARTICLE_RADIUS_TWO);
+	boundsMax += glm::vec2(PARTICLE_RADIUS_TWO);
+
+	// Skip the particles when no other soft body is close. The particles of the other
+	// bodies are within the skin of their bounds at the last build of the grid.
+	bool bOverlap = false;
+	for (const SoftBodyBounds& bounds : spatialPartition.GetSoftBodyBounds())
+	{
+		if (bounds.Body == this || !bounds.Body->IsReady())
+		{
+			continue;
+		}
+
+		if (boundsMin.x <= bounds.Max.x + SOFT_BODY_GRID_SKIN && boundsMax.x >= bounds.Min.x - SOFT_BODY_GRID_SKIN &&
+			boundsMin.y <= bounds.Max.y + SOFT_BODY_GRID_SKIN && boundsMax.y >= bounds.Min.y - SOFT_BODY_GRID_SKIN)
+		{
+			bOverlap = true;
+			break;
+		}
+	}
+
+	if (!bOverlap)
+	{
+		return;
+	}
+
+	ParticleManager& particleManager = ParticleManager::GetInstance();
+	const UniformGrid& grid = spatialPartition.GetSoftBodyGrid();
+	const int* pEntries = grid.GetEntries();
+
+	glm::vec2 localOffset(WALL_LEFTLIMIT, WALL_TOPLIMIT);
+	float fSearchRadius = PARTICLE_RADIUS_TWO + SOFT_BODY_GRID_SKIN;
+
+	for (unsigned int iIndex = 0; iIndex < m_iParticleListSize; iIndex++)
+	{
+		DeformableParticle* pSoftParticle1 = m_ParticlesList[iIndex];
+
+		int iMinColumn, iMaxColumn, iMinRow, iMaxRow;
+		SpatialPartition::ComputeCellRange(pSoftParticle1->Position - localOffset, fSearchRadius,
+			iMinColumn, iMaxColumn, iMinRow, iMaxRow);
+
+		// Particles of the other soft bodies in the surrounding cells
+		m_ContactCandidates.clear();
+		for (int iRow = iMinRow; iRow <= iMaxRow; iRow++)
+		{
+			for (int iColumn = iMinColumn; iColumn <= iMaxColumn; iColumn++)
+			{
+				int iCell = iColumn + iRow * CELL_COLS;
+
+				for (unsigned int iEntry = grid.GetCellStart(iCell); iEntry < grid.GetCellEnd(iCell); iEntry++)
+				{
+					if (particleManager.GetDeformableParticle(pEntries[iEntry])->GetParentIndex() != pSoftParticle1->GetParentIndex())
+					{
+						m_ContactCandidates.push_back(pEntries[iEntry]);
+					}
+				}
+			}
+		}
+
+		// In the order of the deformable particle list so that the corrections add up the same way for any grid
+		std::sort(m_ContactCandidates.begin(), m_ContactCandidates.end());
+
+		for (int iDeformableParticleIndex : m_ContactCandidates)
+		{
+			DeformableParticle* pOtherParticle = particleManager.GetDeformableParticle(iDeformableParticleIndex);
+
+			// Check if there is a collision between particles
+			if (pOtherParticle->GetParent()->IsReady() && pSoftParticle1->IsCollidingStatic(*pOtherParticle))
+			{
+				glm::vec2 p1p2 = pSoftParticle1->Position - pOtherParticle->Position;
+				float fDistance = glm::length(p1p2);
+
+				Contact contact;
+				contact.Other = pOtherParticle;
+				contact.Offset = glm::vec2(0.0f);
+
+				if (fDistance != 0.0f)
+				{
+					contact.Offset = -0.5f * (fDistance - PARTICLE_RADIUS_TWO) * (p1p2) / fDistance;
+				}
+
+				m_Contacts.push_back(contact);
+			}
+		}
 
-		currentParticle.Update();
+		m_ContactStart[iIndex + 1] = m_Contacts.size();
 	}
 }
 
@@ -434,7 +524,8 @@ void SoftBody::BuildSoftBody()
 {
 	if (m_bDrawConvexHull)
 	{
-		m_ConvexHull.Initialize(m_ParticlesList);
+		m_ConvexHull.Update(m_ParticlesList);
+		m_SignedDistanceField.Build(m_ConvexHull.GetEdgeList(), m_ConvexHull.GetBoundsMin(), m_ConvexHull.GetBoundsMax());
 		m_bConvexHullInitialized = true;
 	}
 
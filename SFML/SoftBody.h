@@ -3,11 +3,15 @@
 
 #include "Common.h"
 #include <algorithm>
-#include "GrahamScan.h"
+#include "ConvexHull.h"
+#include "SignedDistanceField.h"
 #include "BezierCurve.h"
 #include "DeformableParticle.h"
 #include "BaseSimulation.h"
 
+bool ScanlineSortY(glm::vec2& p1, glm::vec2& p2);
+bool ScanlineSortX(glm::vec2& p1, glm::vec2& p2);
+
 class SoftBody : public BaseSimulation
 {
 public:
@@ -15,8 +19,19 @@ public:
 
 	void BuildSoftBody();
 
-	void Update(float dt);
+	// Stages of a step of a ready body. Every body finishes a stage before any of them starts the next
+	// one (SimulationManager::UpdateSoftBodies), the stages only write to the particles of their body.
+
+	// External forces, container and shape matching
+	void PredictPositions(float dt);
+	// Contacts with the other bodies and push out of their hulls, from the positions of the last step
+	void SolveCollisions();
+	// Velocities, positions, convex hull and distance field
+	void Finalize(float dt);
+
+#ifndef HEADLESS
 	void Draw(sf::RenderWindow& window);
+#endif // HEADLESS
 	void SetReady(bool ready);
 
 	inline unsigned int GetParticleCount() { return m_ParticlesList.size(); }
@@ -33,11 +48,16 @@ public:
 	}
 
 	inline bool IsReady() { return m_bReady; }
-	inline GrahamScan& GetConvexHull() { return m_ConvexHull; }
+	inline ConvexHull& GetConvexHull() { return m_ConvexHull; }
+	// Distance to the convex hull, rebuilt with it
+	inline const SignedDistanceField& GetSignedDistanceField() const { return m_SignedDistanceField; }
 
 	inline std::vector<DeformableParticle*>& GetParticleList() { return m_ParticlesList; }
 
 private:
+	// The microbenchmarks time the shape matching on its own
+	friend struct MicrobenchmarkAccess;
+
 	bool m_bAllowFlipping;
 	bool m_bVolumeConservation;
 	bool m_bReady;
@@ -55,12 +75,24 @@ private:
 
 	std::vector<glm::vec2> m_BezierPoints;
 	BezierCurve m_BezierCurve;
-	GrahamScan m_ConvexHull;
+	ConvexHull m_ConvexHull;
+	SignedDistanceField m_SignedDistanceField;
 
 	std::vector<DeformableParticle*> m_ParticlesList;
 	std::vector<DeformableParticle*> m_InitialParticlesList;
 	unsigned int m_iParticleListSize;
 
+	// Particles of the other soft bodies touching a particle of this one and the offset of the particle
+	// out of the contact. The contacts of particle i are [m_ContactStart[i], m_ContactStart[i + 1]).
+	struct Contact
+	{
+		DeformableParticle* Other;
+		glm::vec2 Offset;
+	};
+	std::vector<Contact> m_Contacts;
+	std::vector<unsigned int> m_ContactStart;
+	std::vector<int> m_ContactCandidates;
+
 	// Constants
 	const float SOFTBODY_RESTITUTION_COEFF = 0.9f;
 	const float SOFTBODY_STIFFNESS_VALUE = 0.2f; // 0.0f - elastic 1.0f - solid
@@ -71,13 +103,14 @@ private:
 	const float SOFTBODYPARTICLE_BOTTOMLIMIT = WALL_BOTTOMLIMIT - PARTICLE_RADIUS;
 
 	void ShapeMatching(float dt);
+	void FindContacts();
 	void Integrate(float dt);
 	void UpdateCollision(float dt);
 	void UpdateForces(float dt);
 
 	// Sort function
-	friend extern bool ScanlineSortY(glm::vec2& p1, glm::vec2& p2);
-	friend extern bool ScanlineSortX(glm::vec2& p1, glm::vec2& p2);
+	friend bool ScanlineSortY(glm::vec2& p1, glm::vec2& p2);
+	friend bool ScanlineSortX(glm::vec2& p1, glm::vec2& p2);
 };
 
 #endif // SOFTBODY_H
\ No newline at end of file
@@ -2,21 +2,31 @@
 
 #include <math.h>
 
+#include "ParticleManager.h"
+#include "SoftBody.h"
+
 // ------------------------------------------------------------------------
 
 void SpatialPartition::Setup()
 {
-	for (int i = 0; i < TOTAL_CELLS; i++)
-	{
-		m_Buckets.insert(std::pair<int, std::vector<int>>(i, std::vector<int>()));
-	}
+	m_FluidGrid.Setup(TOTAL_CELLS);
+	m_SoftGrid.Setup(TOTAL_CELLS);
+	m_SoftBodyGrid.Setup(TOTAL_CELLS);
+
+	m_bSoftBodyGridValid = false;
+
+	m_HullCellStart.assign(TOTAL_CELLS + 1, 0);
+	m_HullEntries.clear();
 }
 
 // ------------------------------------------------------------------------
 
 void SpatialPartition::ClearBuckets()
 {
-	m_Buckets.clear();
+	m_RegisteredCellIDs.clear();
+	m_RegisteredIDs.clear();
+
+	m_SoftGrid.Clear();
 }
 
 // ------------------------------------------------------------------------
@@ -25,54 +35,255 @@ void SpatialPartition::RegisterObject(BaseParticle* particle)
 {
 	// Get a list of ids of the cell the current particle is in
 	particle->UpdateCellIds();
-	std::vector<int>& cellIDsList = particle->GetCellIDsList();
 
-#ifdef MULTITHREADING
+	m_RegisteredCellIDs.push_back(particle->GetCellIDsList());
+	m_RegisteredIDs.push_back(particle->GlobalIndex);
+}
+
+// ------------------------------------------------------------------------
+
+void SpatialPartition::BuildBuckets()
+{
+	m_SoftGrid.Build(m_RegisteredCellIDs.data(), m_RegisteredIDs.data(), m_RegisteredIDs.size());
+}
+
+// ------------------------------------------------------------------------
+
+void SpatialPartition::BeginRegistration(unsigned int iObjectCount, unsigned int iChunkCount)
+{
+	m_RegisteredCellIDs.resize(iObjectCount);
+	m_RegisteredIDs.resize(iObjectCount);
+
+	m_SoftGrid.Begin(iChunkCount);
+}
+
+// ------------------------------------------------------------------------
+
+void SpatialPartition::RegisterObject(unsigned int iSlot, BaseParticle* particle)
+{
+	particle->UpdateCellIds();
+
+	// Every slot is written by a single thread
+	m_RegisteredCellIDs[iSlot] = particle->GetCellIDsList();
+	m_RegisteredIDs[iSlot] = particle->GlobalIndex;
+}
+
+// ------------------------------------------------------------------------
+
+void SpatialPartition::CountRegistered(unsigned int iChunk, unsigned int iStartSlot, unsigned int iEndSlot)
+{
+	m_SoftGrid.Count(iChunk, m_RegisteredCellIDs.data(), iStartSlot, iEndSlot);
+}
+
+// ------------------------------------------------------------------------
+
+void SpatialPartition::PrefixSumRegistered()
+{
+	m_SoftGrid.PrefixSum();
+}
+
+// ------------------------------------------------------------------------
+
+void SpatialPartition::ScatterRegistered(unsigned int iChunk, unsigned int iStartSlot, unsigned int iEndSlot)
+{
+	m_SoftGrid.Scatter(iChunk, m_RegisteredCellIDs.data(), m_RegisteredIDs.data(), iStartSlot, iEndSlot);
+}
+
+// ------------------------------------------------------------------------
+
+void SpatialPartition::UpdateSoftBodyGrid()
+{
+	std::vector<DeformableParticle*>& particles = ParticleManager::GetInstance().GetDeformableParticles();
+
+	// Rebuild when a particle moved too far or particles were added since the last build
+	if (m_bSoftBodyGridValid && m_iSoftBodyGridParticleCount == particles.size())
+	{
+		return;
+	}
+
+	glm::vec2 localOffset(WALL_LEFTLIMIT, WALL_TOPLIMIT);
+
+	m_SoftBodyGridCellIDs.resize(particles.size());
+	m_SoftBodyBounds.clear();
+
+	for (unsigned int index = 0; index < particles.size(); index++)
+	{
+		DeformableParticle* pParticle = particles[index];
+
+		pParticle->CollisionGridPosition = pParticle->Position;
 
-	m_BucketAccessMutex.lock();
+		m_SoftBodyGridCellIDs[index].Count = 1;
+		m_SoftBodyGridCellIDs[index].IDs[0] = ComputeCellID(pParticle->Position - localOffset);
 
-#endif // MULTITHREADING
+		// The particles of a soft body are added one after the other
+		if (m_SoftBodyBounds.empty() || m_SoftBodyBounds.back().Body != pParticle->GetParent())
+		{
+			SoftBodyBounds bounds;
+			bounds.Body = pParticle->GetParent();
+			bounds.Min = pParticle->Position;
+			bounds.Max = pParticle->Position;
+			m_SoftBodyBounds.push_back(bounds);
+		}
+		else
+		{
+			SoftBodyBounds& bounds = m_SoftBodyBounds.back();
+			bounds.Min = glm::min(bounds.Min, pParticle->Position);
+			bounds.Max = glm::max(bounds.Max, pParticle->Position);
+		}
+	}
+
+	m_SoftBodyGrid.Build(m_SoftBodyGridCellIDs.data(), nullptr, particles.size());
+
+	m_iSoftBodyGridParticleCount = particles.size();
+	m_bSoftBodyGridValid = true;
+}
+
+// ------------------------------------------------------------------------
+
+void SpatialPartition::CheckSoftBodyGridDisplacement(const std::vector<DeformableParticle*>& particles)
+{
+	float fMaxDisplacement2 = SOFT_BODY_GRID_SKIN * SOFT_BODY_GRID_SKIN;
+
+	for (const DeformableParticle* pParticle : particles)
+	{
+		glm::vec2 displacement = pParticle->Position - pParticle->CollisionGridPosition;
+		if (glm::dot(displacement, displacement) > fMaxDisplacement2)
+		{
+			m_bSoftBodyGridValid = false;
+			return;
+		}
+	}
+}
+
+// ------------------------------------------------------------------------
+
+// Cells overlapped by the bounds of a convex hull, false for an empty hull
+static bool ComputeHullCellRange(const ConvexHull& hull, int& iMinColumn, int& iMaxColumn, int& iMinRow, int& iMaxRow)
+{
+	const glm::vec2& boundsMin = hull.GetBoundsMin();
+	const glm::vec2& boundsMax = hull.GetBoundsMax();
+
+	if (boundsMin.x > boundsMax.x || boundsMin.y > boundsMax.y)
+	{
+		return false;
+	}
+
+	glm::vec2 localOffset(WALL_LEFTLIMIT, WALL_TOPLIMIT);
+	glm::vec2 localMin = boundsMin - localOffset;
+	glm::vec2 localMax = boundsMax - localOffset;
+
+	iMinColumn = glm::clamp(Floor(localMin.x * INVERSE_CELL_SIZE), 0, CELL_COLS - 1);
+	iMaxColumn = glm::clamp(Floor(localMax.x * INVERSE_CELL_SIZE), 0, CELL_COLS - 1);
+	iMinRow = glm::clamp(Floor(localMin.y * INVERSE_CELL_SIZE), 0, CELL_ROWS - 1);
+	iMaxRow = glm::clamp(Floor(localMax.y * INVERSE_CELL_SIZE), 0, CELL_ROWS - 1);
+
+	return true;
+}
+
+void SpatialPartition::BuildHullGrid(const std::vector<SoftBody*>& softBodies)
+{
+	int iMinColumn, iMaxColumn, iMinRow, iMaxRow;
+
+	// Count the bodies of every cell, one entry further for the prefix sum
+	m_HullCellStart.assign(TOTAL_CELLS + 1, 0);
 
-	for each (auto cellId in cellIDsList)
+	for (SoftBody* pSoftBody : softBodies)
 	{
-		m_Buckets[cellId].push_back(particle->GlobalIndex);
+		if (!ComputeHullCellRange(pSoftBody->GetConvexHull(), iMinColumn, iMaxColumn, iMinRow, iMaxRow))
+		{
+			continue;
+		}
+
+		for (int iRow = iMinRow; iRow <= iMaxRow; iRow++)
+		{
+			for (int iColumn = iMinColumn; iColumn <= iMaxColumn; iColumn++)
+			{
+				m_HullCellStart[iColumn + iRow * CELL_COLS + 1]++;
+			}
+		}
+	}
+
+	for (int iCell = 0; iCell < TOTAL_CELLS; iCell++)
+	{
+		m_HullCellStart[iCell + 1] += m_HullCellStart[iCell];
+	}
+
+	// Scatter in list order
+	m_HullEntries.resize(m_HullCellStart[TOTAL_CELLS]);
+	m_HullCellOffsets.assign(m_HullCellStart.begin(), m_HullCellStart.end() - 1);
+
+	for (unsigned int index = 0; index < softBodies.size(); index++)
+	{
+		if (!ComputeHullCellRange(softBodies[index]->GetConvexHull(), iMinColumn, iMaxColumn, iMinRow, iMaxRow))
+		{
+			continue;
+		}
+
+		for (int iRow = iMinRow; iRow <= iMaxRow; iRow++)
+		{
+			for (int iColumn = iMinColumn; iColumn <= iMaxColumn; iColumn++)
+			{
+				m_HullEntries[m_HullCellOffsets[iColumn + iRow * CELL_COLS]++] = index;
+			}
+		}
+	}
+}
+
+// ------------------------------------------------------------------------
+
+std::map<int, std::vector<int>> SpatialPartition::GetBuckets() const
+{
+	std::map<int, std::vector<int>> buckets;
+
+	const int* pEntries = m_SoftGrid.GetEntries();
+	for (int iCell = 0; iCell < m_SoftGrid.GetCellCount(); iCell++)
+	{
+		buckets[iCell].assign(pEntries + m_SoftGrid.GetCellStart(iCell), pEntries + m_SoftGrid.GetCellEnd(iCell));
 	}
 
-#ifdef MULTITHREADING
+	return buckets;
+}
 
-	m_BucketAccessMutex.unlock();
+// ------------------------------------------------------------------------
 
-#endif // MULTITHREADING
+int SpatialPartition::ComputeCellID(const glm::vec2& localPosition)
+{
+	int iColumn = glm::clamp(Floor(localPosition.x * INVERSE_CELL_SIZE), 0, CELL_COLS - 1);
+	int iRow = glm::clamp(Floor(localPosition.y * INVERSE_CELL_SIZE), 0, CELL_ROWS - 1);
 
+	return iColumn + iRow * CELL_COLS;
 }
 
 // ------------------------------------------------------------------------
 
-void SpatialPartition::GetIdForObject(const BaseParticle& particle, std::set<int>& cellIDList)
+// Spread the lower 16 bits of the value so that there is a zero bit between each of them
+static unsigned int SeparateBits(unsigned int x)
 {
-	float fXPos = particle.LocalPosition.x;
-	float fYPos = particle.LocalPosition.y;
-	float fRadius = particle.Radius;
+	x &= 0x0000ffff;
+	x = (x | (x << 8)) & 0x00ff00ff;
+	x = (x | (x << 4)) & 0x0f0f0f0f;
+	x = (x | (x << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;
+	return x;
+}
 
-	// Top left corner
-	int iCellIndex = (int)(std::floor((fXPos - fRadius) / CELL_SIZE) +
-		std::floor((fYPos - fRadius) / CELL_SIZE) * CELL_COLS);
-	cellIDList.insert(iCellIndex);
+unsigned int SpatialPartition::ComputeMortonCode(const glm::vec2& localPosition)
+{
+	int iColumn = glm::clamp(Floor(localPosition.x * INVERSE_CELL_SIZE), 0, CELL_COLS - 1);
+	int iRow = glm::clamp(Floor(localPosition.y * INVERSE_CELL_SIZE), 0, CELL_ROWS - 1);
 
-	// Top right corner
-	iCellIndex = (int)(std::floor((fXPos + fRadius) / CELL_SIZE) +
-		std::floor((fYPos - fRadius) / CELL_SIZE) * CELL_COLS);
-	cellIDList.insert(iCellIndex);
+	return SeparateBits((unsigned int)iColumn) | (SeparateBits((unsigned int)iRow) << 1);
+}
 
-	// Bottom left corner
-	iCellIndex = (int)(std::floor((fXPos - fRadius) / CELL_SIZE) +
-		std::floor((fYPos + fRadius) / CELL_SIZE) * CELL_COLS);
-	cellIDList.insert(iCellIndex);
+// ------------------------------------------------------------------------
 
-	// Bottom right corner
-	iCellIndex = (int)(std::floor((fXPos + fRadius) / CELL_SIZE) +
-		std::floor((fYPos + fRadius) / CELL_SIZE) * CELL_COLS);
-	cellIDList.insert(iCellIndex);
+void SpatialPartition::ComputeCellRange(const glm::vec2& localPosition, float fRadius,
+	int& iMinColumn, int& iMaxColumn, int& iMinRow, int& iMaxRow)
+{
+	iMinColumn = glm::clamp(Floor((localPosition.x - fRadius) * INVERSE_CELL_SIZE), 0, CELL_COLS - 1);
+	iMaxColumn = glm::clamp(Floor((localPosition.x + fRadius) * INVERSE_CELL_SIZE), 0, CELL_COLS - 1);
+	iMinRow = glm::clamp(Floor((localPosition.y - fRadius) * INVERSE_CELL_SIZE), 0, CELL_ROWS - 1);
+	iMaxRow = glm::clamp(Floor((localPosition.y + fRadius) * INVERSE_CELL_SIZE), 0, CELL_ROWS - 1);
 }
 
-// ------------------------------------------------------------------------
\ No newline at end of file
+// ------------------------------------------------------------------------
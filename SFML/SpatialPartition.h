@@ -3,10 +3,22 @@
 
 #include <vector>
 #include <map>
-#include <set>
+#include <atomic>
 
 #include "Common.h"
-#include "FluidParticle.h"
+#include "BaseParticle.h"
+#include "UniformGrid.h"
+
+class SoftBody;
+class DeformableParticle;
+
+// Bounds of particles of a soft body
+struct SoftBodyBounds
+{
+	SoftBody* Body;
+	glm::vec2 Min;
+	glm::vec2 Max;
+};
 
 class SpatialPartition
 {
@@ -19,27 +31,92 @@ public:
 	}
 
 	void Setup();
+
+	// Registered objects - cleared, registered and then sorted into the grid every rebuild.
+	// Serial path, not thread safe.
 	void ClearBuckets();
 	void RegisterObject(BaseParticle* particle);
+	void BuildBuckets();
+
+	// Parallel registration without locks. Every object gets a preallocated slot and the grid is
+	// built with a counting sort, one histogram per chunk of slots:
+	//   BeginRegistration - once, before the other calls
+	//   RegisterObject / CountRegistered - every chunk concurrently
+	//   PrefixSumRegistered - once
+	//   ScatterRegistered - every chunk concurrently
+	void BeginRegistration(unsigned int iObjectCount, unsigned int iChunkCount);
+	void RegisterObject(unsigned int iSlot, BaseParticle* particle);
+	void CountRegistered(unsigned int iChunk, unsigned int iStartSlot, unsigned int iEndSlot);
+	void PrefixSumRegistered();
+	void ScatterRegistered(unsigned int iChunk, unsigned int iStartSlot, unsigned int iEndSlot);
+
+	// Compatibility view of the registered objects grid as cell -> global particle indices.
+	// Built on demand, the solver reads the grids directly.
+	std::map<int, std::vector<int>> GetBuckets() const;
 
-	inline std::map<int, std::vector<int>>& GetBuckets() { return m_Buckets; }
+	// Grid of fluid particles (fluid particle store indices), built by the fluid simulation
+	inline UniformGrid& GetFluidGrid() { return m_FluidGrid; }
+	// Grid of registered deformable particles (global particle indices)
+	inline const UniformGrid& GetSoftGrid() const { return m_SoftGrid; }
+
+	// Grid of all the deformable particles (deformable particle indices) for the collisions between soft
+	// bodies. A build stays valid while no particle moved more than SOFT_BODY_GRID_SKIN from its position
+	// at the build, the queries extend their radius by the skin. The soft bodies check the particles they
+	// integrate, anything else moving a deformable particle has to invalidate the grid.
+	void UpdateSoftBodyGrid();
+	void CheckSoftBodyGridDisplacement(const std::vector<DeformableParticle*>& particles);
+	inline void InvalidateSoftBodyGrid() { m_bSoftBodyGridValid = false; }
+	inline const UniformGrid& GetSoftBodyGrid() const { return m_SoftBodyGrid; }
+
+	// Bounds of the soft bodies at the last build of the grid, a body whose particles aren't consecutive
+	// in the deformable particle list has an entry per run of particles
+	inline const std::vector<SoftBodyBounds>& GetSoftBodyBounds() const { return m_SoftBodyBounds; }
+
+	// Soft bodies by the cells overlapped by the bounds of their convex hull (soft body list indices, in list
+	// order within a cell). Built by the fluid simulation before a step, the hulls don't change during it.
+	void BuildHullGrid(const std::vector<SoftBody*>& softBodies);
+	inline unsigned int GetHullCellStart(int iCell) const { return m_HullCellStart[iCell]; }
+	inline unsigned int GetHullCellEnd(int iCell) const { return m_HullCellStart[iCell + 1]; }
+	inline const int* GetHullEntries() const { return m_HullEntries.data(); }
+
+	// Cell containing the given local position. Positions outside the container map to the closest border cell.
+	static int ComputeCellID(const glm::vec2& localPosition);
+
+	// Z-order (Morton) code of the cell containing the given local position
+	static unsigned int ComputeMortonCode(const glm::vec2& localPosition);
+
+	// Range of cells (inclusive) overlapped by a circle around the given local position, clamped to the grid
+	static void ComputeCellRange(const glm::vec2& localPosition, float fRadius,
+		int& iMinColumn, int& iMaxColumn, int& iMinRow, int& iMaxRow);
 
 private:
 	// -----------------------------------------------------------------------------
 	// Hide constructor for singleton implementation
-	SpatialPartition() {};
+	SpatialPartition() : m_bSoftBodyGridValid(false), m_iSoftBodyGridParticleCount(0) {};
 
 	// Delete unneeded copy constructor and assignment operator
 	SpatialPartition(SpatialPartition const&) = delete;
 	void operator=(SpatialPartition const&) = delete;
 	// -----------------------------------------------------------------------------
 
-	std::map<int, std::vector<int>> m_Buckets;
+	UniformGrid m_FluidGrid;
+	UniformGrid m_SoftGrid;
+
+	// Objects registered since the last clear
+	std::vector<CellIDList> m_RegisteredCellIDs;
+	std::vector<int> m_RegisteredIDs;
 
-	void GetIdForObject(const BaseParticle& particle, std::set<int>& cellIDList);
+	UniformGrid m_SoftBodyGrid;
+	std::vector<CellIDList> m_SoftBodyGridCellIDs;
+	std::vector<SoftBodyBounds> m_SoftBodyBounds;
+	// Cleared by the soft bodies stepped on other threads
+	std::atomic<bool> m_bSoftBodyGridValid;
+	unsigned int m_iSoftBodyGridParticleCount;
 
-	// Multithreading
-	std::mutex m_BucketAccessMutex;
+	// Start of the soft bodies of every cell, one more entry for the end of the last cell
+	std::vector<unsigned int> m_HullCellStart;
+	std::vector<unsigned int> m_HullCellOffsets;
+	std::vector<int> m_HullEntries;
 };
 
-#endif // SPATIAL_PARTITION
\ No newline at end of file
+#endif // SPATIAL_PARTITION
@@ -0,0 +1,105 @@
+#include "UniformGrid.h"
+
+#include <algorithm>
+
+// ------------------------------------------------------------------------
+
+void UniformGrid::Setup(int iCellCount)
+{
+	m_CellStart.assign(iCellCount, 0);
+	m_CellEnd.assign(iCellCount, 0);
+	m_Entries.clear();
+	m_ChunkCellCounts.clear();
+	m_iChunkCount = 0;
+}
+
+// ------------------------------------------------------------------------
+
+void UniformGrid::Begin(unsigned int iChunkCount)
+{
+	m_iChunkCount = iChunkCount;
+	m_ChunkCellCounts.assign(iChunkCount * m_CellStart.size(), 0);
+}
+
+// ------------------------------------------------------------------------
+
+void UniformGrid::Count(unsigned int iChunk, const CellIDList* pCellIDs, unsigned int iStart, unsigned int iEnd)
+{
+	unsigned int* pCounts = &m_ChunkCellCounts[iChunk * m_CellStart.size()];
+
+	for (unsigned int index = iStart; index < iEnd; index++)
+	{
+		const CellIDList& cellIDs = pCellIDs[index];
+		for (int i = 0; i < cellIDs.Count; i++)
+		{
+			pCounts[cellIDs.IDs[i]]++;
+		}
+	}
+}
+
+// ------------------------------------------------------------------------
+
+void UniformGrid::PrefixSum()
+{
+	unsigned int iCellCount = m_CellStart.size();
+	unsigned int iOffset = 0;
+
+	// Cells are laid out in order and, inside a cell, the chunks in order so
+	// that the scatter keeps the objects sorted by index
+	for (unsigned int iCell = 0; iCell < iCellCount; iCell++)
+	{
+		m_CellStart[iCell] = iOffset;
+
+		for (unsigned int iChunk = 0; iChunk < m_iChunkCount; iChunk++)
+		{
+			unsigned int& iCount = m_ChunkCellCounts[iChunk * iCellCount + iCell];
+			unsigned int iChunkCount = iCount;
+
+			iCount = iOffset;
+			iOffset += iChunkCount;
+		}
+
+		m_CellEnd[iCell] = iOffset;
+	}
+
+	m_Entries.resize(iOffset);
+}
+
+// ------------------------------------------------------------------------
+
+void UniformGrid::Scatter(unsigned int iChunk, const CellIDList* pCellIDs, const int* pObjectIDs, unsigned int iStart, unsigned int iEnd)
+{
+	unsigned int* pOffsets = &m_ChunkCellCounts[iChunk * m_CellStart.size()];
+
+	for (unsigned int index = iStart; index < iEnd; index++)
+	{
+		const CellIDList& cellIDs = pCellIDs[index];
+		int iObjectID = pObjectIDs != nullptr ? pObjectIDs[index] : (int)index;
+
+		for (int i = 0; i < cellIDs.Count; i++)
+		{
+			m_Entries[pOffsets[cellIDs.IDs[i]]++] = iObjectID;
+		}
+	}
+}
+
+// ------------------------------------------------------------------------
+
+void UniformGrid::Build(const CellIDList* pCellIDs, const int* pObjectIDs, unsigned int iObjectCount)
+{
+	Begin(1);
+	Count(0, pCellIDs, 0, iObjectCount);
+	PrefixSum();
+	Scatter(0, pCellIDs, pObjectIDs, 0, iObjectCount);
+}
+
+// ------------------------------------------------------------------------
+
+void UniformGrid::Clear()
+{
+	std::fill(m_CellStart.begin(), m_CellStart.end(), 0);
+	std::fill(m_CellEnd.begin(), m_CellEnd.end(), 0);
+	m_Entries.clear();
+}
+
+// ------------------------------------------------------------------------
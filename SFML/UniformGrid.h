@@ -0,0 +1,63 @@
+#ifndef UNIFORMGRID_H
+#define UNIFORMGRID_H
+
+#include <vector>
+
+#include "Common.h"
+
+// Cells an object is registered in. Objects are smaller than a cell so they
+// never span more than 2x2 cells.
+struct CellIDList
+{
+	int Count;
+	int IDs[4];
+};
+
+// ----------------------------------------------------------------------------
+// Flat uniform grid over the container built with a counting sort:
+//   1. Count     - cell histogram for a chunk of objects
+//   2. PrefixSum - exclusive scan of the histograms into cell start offsets
+//   3. Scatter   - write the object ids of a chunk into their cell slots
+// Count and Scatter only touch data owned by their chunk so different chunks
+// can run concurrently. The scatter is stable: within a cell, objects appear
+// in index order.
+// ----------------------------------------------------------------------------
+
+class UniformGrid
+{
+public:
+	UniformGrid() : m_iChunkCount(0) {}
+
+	void Setup(int iCellCount);
+
+	void Begin(unsigned int iChunkCount);
+	void Count(unsigned int iChunk, const CellIDList* pCellIDs, unsigned int iStart, unsigned int iEnd);
+	void PrefixSum();
+	void Scatter(unsigned int iChunk, const CellIDList* pCellIDs, const int* pObjectIDs, unsigned int iStart, unsigned int iEnd);
+
+	// Serial build of the grid from a list of objects (pObjectIDs == nullptr stores the object index)
+	void Build(const CellIDList* pCellIDs, const int* pObjectIDs, unsigned int iObjectCount);
+
+	// Remove all the objects from the grid
+	void Clear();
+
+	inline int GetCellCount() const { return (int)m_CellStart.size(); }
+	inline unsigned int GetCellStart(int iCell) const { return m_CellStart[iCell]; }
+	inline unsigned int GetCellEnd(int iCell) const { return m_CellEnd[iCell]; }
+	inline const int* GetEntries() const { return m_Entries.data(); }
+
+private:
+	// Per chunk cell histograms, chunk major [chunk * cellCount + cell].
+	// After the prefix sum they hold the write offset of each chunk in each cell.
+	std::vector<unsigned int> m_ChunkCellCounts;
+
+	std::vector<unsigned int> m_CellStart;
+	std::vector<unsigned int> m_CellEnd;
+
+	// Object ids sorted by cell
+	std::vector<int> m_Entries;
+
+	unsigned int m_iChunkCount;
+};
+
+#endif // UNIFORMGRID_H
@@ -0,0 +1,222 @@
+#include "WorkerTeam.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+// Number of polls before a waiting thread yields
+static const unsigned int SPIN_COUNT = 4096;
+
+// ------------------------------------------------------------------------
+
+WorkerTeam::WorkerTeam(unsigned int iThreadCount)
+	: m_iThreadCount(iThreadCount > 0 ? iThreadCount : 1),
+	m_iSpinCount(SPIN_COUNT),
+	m_iArrived(0),
+	m_iSense(0),
+	m_fReleaseTime(0.0),
+	m_fRunStartTime(0.0),
+	m_fRunTime(0.0),
+	m_pJob(nullptr),
+	m_iGeneration(0),
+	m_bStop(false)
+{
+	// Spinning only pays off when every member has a core of its own
+	if (m_iThreadCount > std::thread::hardware_concurrency())
+	{
+		m_iSpinCount = 0;
+	}
+
+	MemberState state = {};
+	m_MemberState.resize(m_iThreadCount, state);
+	m_IdleTime.resize(m_iThreadCount, 0.0);
+
+	// Member 0 is the thread calling Run
+	for (unsigned int iThread = 1; iThread < m_iThreadCount; iThread++)
+	{
+		m_Workers.push_back(std::thread(&WorkerTeam::WorkerLoop, this, iThread));
+	}
+}
+
+// ------------------------------------------------------------------------
+
+WorkerTeam::~WorkerTeam()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_WakeMutex);
+		m_bStop = true;
+		m_iGeneration.fetch_add(1);
+	}
+
+	m_WakeCondition.notify_all();
+
+	for (unsigned int i = 0; i < m_Workers.size(); i++)
+	{
+		m_Workers[i].join();
+	}
+}
+
+// ------------------------------------------------------------------------
+
+void WorkerTeam::Run(const Job& job)
+{
+	m_pJob = &job;
+	m_fRunStartTime = GetHighResolutionTime();
+
+	m_MemberState[0].StartTime = m_fRunStartTime;
+	m_MemberState[0].IdleTime = 0.0;
+
+	{
+		std::lock_guard<std::mutex> lock(m_WakeMutex);
+		m_iGeneration.fetch_add(1);
+	}
+
+	m_WakeCondition.notify_all();
+
+	job(0);
+
+	// Wait for the rest of the team to finish the job
+	Wait(0, true);
+
+	m_pJob = nullptr;
+
+	// Waiting for the wake up and for the others at the end counts as idle time
+	m_fRunTime = m_fReleaseTime - m_fRunStartTime;
+
+	for (unsigned int iThread = 0; iThread < m_iThreadCount; iThread++)
+	{
+		const MemberState& state = m_MemberState[iThread];
+		m_IdleTime[iThread] = (state.StartTime - m_fRunStartTime) + state.IdleTime + (m_fReleaseTime - state.ArrivalTime);
+	}
+}
+
+// ------------------------------------------------------------------------
+
+void WorkerTeam::Barrier(unsigned int iThread)
+{
+	Wait(iThread, false);
+}
+
+// ------------------------------------------------------------------------
+
+void WorkerTeam::Wait(unsigned int iThread, bool bLastInRun)
+{
+	MemberState& state = m_MemberState[iThread];
+	state.ArrivalTime = GetHighResolutionTime();
+
+	if (m_iThreadCount == 1)
+	{
+		m_fReleaseTime = state.ArrivalTime;
+		return;
+	}
+
+	// The barrier is released by flipping the shared sense, so it can be reused straight away
+	unsigned int iSense = state.Sense ^ 1;
+	state.Sense = iSense;
+
+	if (m_iArrived.fetch_add(1) == m_iThreadCount - 1)
+	{
+		// Last one in
+		m_fReleaseTime = state.ArrivalTime;
+		m_iArrived.store(0, std::memory_order_relaxed);
+		m_iSense.store(iSense, std::memory_order_release);
+	}
+	else
+	{
+		SpinWait(m_iSense, iSense, m_iSpinCount);
+
+		// The release time is not touched again before every member arrived at the next barrier
+		if (!bLastInRun)
+		{
+			state.IdleTime += m_fReleaseTime - state.ArrivalTime;
+		}
+	}
+}
+
+// ------------------------------------------------------------------------
+
+void WorkerTeam::WorkerLoop(unsigned int iThread)
+{
+	PinThread(iThread);
+
+	unsigned int iGeneration = 0;
+
+	while (true)
+	{
+		// Spin for the next job first, the frames follow each other closely
+		unsigned int iSpin = 0;
+		while (m_iGeneration.load(std::memory_order_acquire) == iGeneration && iSpin++ < m_iSpinCount)
+		{
+			_mm_pause();
+		}
+
+		if (m_iGeneration.load(std::memory_order_acquire) == iGeneration)
+		{
+			std::unique_lock<std::mutex> lock(m_WakeMutex);
+			while (m_iGeneration.load(std::memory_order_acquire) == iGeneration)
+			{
+				m_WakeCondition.wait(lock);
+			}
+		}
+
+		iGeneration = m_iGeneration.load(std::memory_order_acquire);
+
+		if (m_bStop)
+		{
+			return;
+		}
+
+		m_MemberState[iThread].StartTime = GetHighResolutionTime();
+		m_MemberState[iThread].IdleTime = 0.0;
+
+		(*m_pJob)(iThread);
+
+		Wait(iThread, true);
+	}
+}
+
+// ------------------------------------------------------------------------
+
+void WorkerTeam::SpinWait(const std::atomic<unsigned int>& flag, unsigned int iValue, unsigned int iSpinCount)
+{
+	for (unsigned int iSpin = 0; iSpin < iSpinCount; iSpin++)
+	{
+		if (flag.load(std::memory_order_acquire) == iValue)
+		{
+			return;
+		}
+
+		_mm_pause();
+	}
+
+	// More threads than cores - let the others make progress
+	while (flag.load(std::memory_order_acquire) != iValue)
+	{
+		std::this_thread::yield();
+	}
+}
+
+// ------------------------------------------------------------------------
+
+void WorkerTeam::PinThread(unsigned int iCore)
+{
+	// Leave the threads free to move when the team is larger than the machine
+	if (iCore >= std::thread::hardware_concurrency())
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << iCore);
+#else
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	CPU_SET(iCore, &cpuSet);
+	pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet);
+#endif
+}
+
+// ------------------------------------------------------------------------
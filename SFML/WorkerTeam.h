@@ -0,0 +1,92 @@
+#ifndef WORKERTEAM_H
+#define WORKERTEAM_H
+
+#include <vector>
+#include <atomic>
+#include <functional>
+
+#include "Common.h"
+#include "AlignedAllocator.h"
+
+// ----------------------------------------------------------------------------
+// Persistent team of worker threads. Run executes the same job on every
+// member of the team (the calling thread is member 0) and returns when all
+// of them finished. Inside the job the members synchronize with Barrier, a
+// sense-reversing spin barrier, so a job can be a whole sequence of phases
+// with a single wake up of the team.
+//
+// The time every member spent waiting (for the wake up and in the barriers)
+// during the last Run is recorded, the rest of the run counts as busy time.
+// ----------------------------------------------------------------------------
+
+class WorkerTeam
+{
+public:
+	typedef std::function<void(unsigned int iThread)> Job;
+
+	explicit WorkerTeam(unsigned int iThreadCount);
+	~WorkerTeam();
+
+	// Execute the job on all the members of the team and wait for them
+	void Run(const Job& job);
+
+	// Wait until all the members of the team reached the barrier. Must be called by all
+	// the members the same number of times.
+	void Barrier(unsigned int iThread);
+
+	inline unsigned int GetThreadCount() const { return m_iThreadCount; }
+
+	// Timings of the last Run in seconds
+	inline double GetRunTime() const { return m_fRunTime; }
+	inline double GetBusyTime(unsigned int iThread) const { return m_fRunTime - m_IdleTime[iThread]; }
+	inline double GetIdleTime(unsigned int iThread) const { return m_IdleTime[iThread]; }
+
+private:
+	WorkerTeam(const WorkerTeam&);
+	WorkerTeam& operator=(const WorkerTeam&);
+
+	void WorkerLoop(unsigned int iThread);
+
+	// Barrier. The last barrier of a run does not update the member state after the
+	// release since Run reads it straight away.
+	void Wait(unsigned int iThread, bool bLastInRun);
+
+	// Spin on the flag for a while before giving up the time slice
+	static void SpinWait(const std::atomic<unsigned int>& flag, unsigned int iValue, unsigned int iSpinCount);
+
+	// Bind the calling thread to a core
+	static void PinThread(unsigned int iCore);
+
+	// Each member keeps its own barrier sense and timings on a separate cache line
+	struct CACHE_ALIGNED MemberState
+	{
+		unsigned int Sense;
+		double StartTime;
+		double ArrivalTime;
+		double IdleTime;
+	};
+
+	unsigned int m_iThreadCount;
+	unsigned int m_iSpinCount;
+	std::vector<std::thread> m_Workers;
+	CacheAlignedVector<MemberState> m_MemberState;
+
+	// Barrier state
+	std::atomic<unsigned int> m_iArrived;
+	std::atomic<unsigned int> m_iSense;
+	double m_fReleaseTime;
+
+	// Timings of the last run
+	double m_fRunStartTime;
+	double m_fRunTime;
+	std::vector<double> m_IdleTime;
+
+	// Job dispatch. Idle workers block on the condition variable after spinning for a while.
+	const Job* m_pJob;
+	std::atomic<unsigned int> m_iGeneration;
+	bool m_bStop;
+	std::mutex m_WakeMutex;
+	std::condition_variable m_WakeCondition;
+};
+
+#endif // WORKERTEAM_H
@@ -8,7 +8,10 @@
 #include "SoftBody.h"
 #include "SimulationManager.h"
 #include "Stats.h"
+#include "Profiler.h"
+#include "FrameTimeHistogram.h"
 #include <fstream>
+#include <string>
 
 void DrawContainer(sf::RenderWindow& window)
 {
@@ -33,6 +36,8 @@ void DrawContainer(sf::RenderWindow& window)
 
 void Draw(sf::RenderWindow& window)
 {
+	PROFILE_SCOPE(ProfilePhase::Draw);
+
 	if (FLUID_SIMULATION)
 	{
 		// Fluid application draw
@@ -54,8 +59,168 @@ void Draw(sf::RenderWindow& window)
 	}
 }
 
-int main()
+// Percentiles, spread and histogram of the frame times recorded after the warm-up
+void PrintFrameTimes(std::ostream& out, const FrameTimeHistogram& frameTimes, float fWarmUp, bool bPrintBuckets)
+{
+	out << "Warm-up discarded: " << fWarmUp << " s" << std::endl;
+	out << "Frame time p50: " << frameTimes.GetPercentile(50.0) << std::endl;
+	out << "Frame time p90: " << frameTimes.GetPercentile(90.0) << std::endl;
+	out << "Frame time p99: " << frameTimes.GetPercentile(99.0) << std::endl;
+	out << "Frame time p99.9: " << frameTimes.GetPercentile(99.9) << std::endl;
+	out << "Frame time standard deviation: " << frameTimes.GetStandardDeviation() << std::endl;
+	out << "Frame time jitter: " << frameTimes.GetJitter() << std::endl;
+
+	if (bPrintBuckets)
+	{
+		out << "Frame time histogram:" << std::endl;
+		frameTimes.PrintBuckets(out);
+	}
+}
+
+#ifdef MULTITHREADING
+
+// Run the fluid solver with 1 to iMaxThreadCount threads from the same initial state and
+// append the time per step, speedup and parallel efficiency of each thread count to the file
+void RunScalingBenchmark(FluidSimulation& fluidSim, unsigned int iMaxThreadCount, const std::string& outFileName)
+{
+	const unsigned int iWarmUpSteps = 50;
+	const unsigned int iTimedSteps = 300;
+
+	std::ofstream outFile;
+	outFile.open(outFileName, std::ios_base::app);
+
+	// Every thread count starts from the same particles
+	FluidParticleStore initialState;
+	initialState.CopyFrom(fluidSim.GetParticleStore());
+	const unsigned int iInitialThreadCount = fluidSim.GetThreadCount();
+
+	double fSingleThreadTime = 0.0;
+
+	for (unsigned int iThreadCount = 1; iThreadCount <= iMaxThreadCount; iThreadCount++)
+	{
+		fluidSim.RestoreParticleStore(initialState);
+		fluidSim.SetThreadCount(iThreadCount);
+
+		for (unsigned int iStep = 0; iStep < iWarmUpSteps; iStep++)
+		{
+			fluidSim.Update(FIXED_DELTA);
+		}
+
+		double fGridBuildTime = 0.0;
+		double fStartTime = GetHighResolutionTime();
+
+		for (unsigned int iStep = 0; iStep < iTimedSteps; iStep++)
+		{
+			fluidSim.Update(FIXED_DELTA);
+			fGridBuildTime += fluidSim.GetGridBuildTime();
+		}
+
+		double fTimePerStep = (GetHighResolutionTime() - fStartTime) / iTimedSteps;
+		double fGridBuildTimePerStep = fGridBuildTime / iTimedSteps;
+
+		if (iThreadCount == 1)
+		{
+			fSingleThreadTime = fTimePerStep;
+		}
+
+		double fSpeedup = fSingleThreadTime / fTimePerStep;
+		double fEfficiency = fSpeedup / iThreadCount;
+
+		std::cout << "Threads: " << iThreadCount << " time per step: " << fTimePerStep * 1000.0 << " ms grid build: " <<
+			fGridBuildTimePerStep * 1000.0 << " ms speedup: " << fSpeedup << " efficiency: " << fEfficiency << std::endl;
+
+		outFile << "-------------------------------------------------------------------------" << std::endl;
+		outFile << "Thread count: " << iThreadCount << std::endl;
+		outFile << "Hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+		outFile << "Fluid particle count: " << fluidSim.GetPaticleCount() << std::endl;
+		outFile << "Kernels: " << fluidSim.GetKernels().Name << std::endl;
+		outFile << "Timed steps: " << iTimedSteps << std::endl;
+		outFile << "Average time per step: " << fTimePerStep << std::endl;
+		outFile << "Average grid build time per step: " << fGridBuildTimePerStep << std::endl;
+		outFile << "Speedup: " << fSpeedup << std::endl;
+		outFile << "Efficiency: " << fEfficiency << std::endl;
+	}
+
+	outFile.close();
+
+	fluidSim.RestoreParticleStore(initialState);
+	fluidSim.SetThreadCount(iInitialThreadCount);
+}
+
+#endif // MULTITHREADING
+
+void PrintUsage()
+{
+	std::cout << "Usage: 2DFluidSoftBodiesInteraction [options]" << std::endl;
+	std::cout << "  --threads N                 solver thread count, overrides PBD_THREAD_COUNT" << std::endl;
+	std::cout << "  --scaling-benchmark [N]     sweep 1..N solver threads (all hardware threads by default) and exit" << std::endl;
+	std::cout << "  --scaling-output FILE       file the scaling benchmark appends to" << std::endl;
+	std::cout << "  --trace FILE                record a Chrome trace of the solver threads, written on exit and with T" << std::endl;
+	std::cout << "  --benchmark-warmup SECONDS  time discarded at the start of the benchmark mode (B)" << std::endl;
+	std::cout << "  --seed N                    fixed random seed and deterministic solver, the scene is the same every run" << std::endl;
+}
+
+int main(int argc, char** argv)
 {
+	// --------------------------------------------------------------------------
+	// Command line, the options are listed by PrintUsage
+	unsigned int iThreadCount = 0;
+	bool bDeterministic = false;
+	unsigned int iSeed = 0;
+	bool bScalingBenchmark = false;
+	unsigned int iScalingMaxThreads = 0;
+	std::string scalingOutFileName = "../Benchmarks/benchmarkScaling.txt";
+	std::string traceFileName;
+	float fBenchmarkWarmUp = 2.0f; // seconds
+
+	for (int iArg = 1; iArg < argc; iArg++)
+	{
+		std::string arg = argv[iArg];
+
+		if (arg == "--help")
+		{
+			PrintUsage();
+			return 0;
+		}
+		else if (arg == "--threads" && iArg + 1 < argc)
+		{
+			iThreadCount = (unsigned int)std::max(atoi(argv[++iArg]), 1);
+		}
+		else if (arg == "--scaling-benchmark")
+		{
+			bScalingBenchmark = true;
+
+			if (iArg + 1 < argc && atoi(argv[iArg + 1]) > 0)
+			{
+				iScalingMaxThreads = (unsigned int)atoi(argv[++iArg]);
+			}
+		}
+		else if (arg == "--scaling-output" && iArg + 1 < argc)
+		{
+			scalingOutFileName = argv[++iArg];
+		}
+		else if (arg == "--trace" && iArg + 1 < argc)
+		{
+			traceFileName = argv[++iArg];
+		}
+		else if (arg == "--benchmark-warmup" && iArg + 1 < argc)
+		{
+			fBenchmarkWarmUp = std::max((float)atof(argv[++iArg]), 0.0f);
+		}
+		else if (arg == "--seed" && iArg + 1 < argc)
+		{
+			iSeed = (unsigned int)strtoul(argv[++iArg], nullptr, 10);
+			bDeterministic = true;
+		}
+		else
+		{
+			// A mistyped option must not open the default scene
+			std::cerr << "Unknown argument: " << arg << std::endl;
+			PrintUsage();
+			return 1;
+		}
+	}
+
 	// --------------------------------------------------------------------------
 	// Benchmark
 	bool bBenchmarkMode = false;
@@ -72,6 +237,10 @@ int main()
 
 	float fBenchmarkTimeAccumulator = 0.0f; // Seconds
 	float fBenchmarkLength = 60.0; // seconds
+	float fBenchmarkWarmUpAccumulator = 0.0f; // Seconds
+
+	// Every frame time after the warm-up, the first frames include the startup spikes
+	FrameTimeHistogram frameTimes;
 
 	// Create file stream
 	std::ofstream outFile;
@@ -115,6 +284,14 @@ int main()
 		30,
 		sf::Color::Red);
 
+#ifdef PROFILING
+	// Frame breakdown - rolling average, p50 and p99 of each phase
+	Stats profileStats(font,
+		300.0f, 20.0f,
+		20,
+		sf::Color::Yellow);
+#endif // PROFILING
+
 	// ---------------------------------------------------------------------------
 	// Application - fluid implementation
 	std::vector<std::shared_ptr<FluidSimulation>> FluidSimulationList;
@@ -125,7 +302,19 @@ int main()
 		std::shared_ptr<FluidSimulation> fluidSim = std::make_shared<FluidSimulation>(font);
 		fluidSim->BuildParticleSystem(glm::vec2(100.0f, 150.0f), sf::Color::Blue);
 
+		// The simulation seeds with the time in its constructor
+		if (bDeterministic)
+		{
+			srand(iSeed);
+			fluidSim->SetDeterministic(true);
+		}
+
 #ifdef MULTITHREADING
+		if (iThreadCount > 0)
+		{
+			fluidSim->SetThreadCount(iThreadCount);
+		}
+
 		fluidSim->SetupMultithread();
 #endif // MULTITHREADING
 
@@ -267,6 +456,30 @@ int main()
 	
 	// ---------------------------------------------------------------------------
 
+#ifdef MULTITHREADING
+	if (bScalingBenchmark && !FluidSimulationList.empty())
+	{
+		if (iScalingMaxThreads == 0)
+		{
+			iScalingMaxThreads = FluidSimulation::GetDefaultThreadCount();
+		}
+
+		RunScalingBenchmark(*FluidSimulationList[0], iScalingMaxThreads, scalingOutFileName);
+
+		outFile.close();
+		return 0;
+	}
+#endif // MULTITHREADING
+
+#ifdef PROFILING
+	if (!traceFileName.empty())
+	{
+		Profiler::GetInstance().StartTrace();
+	}
+#endif // PROFILING
+
+	// ---------------------------------------------------------------------------
+
 	currentTime = timer.getElapsedTime();
 
 	// ---------------------------------------------------------------------------
@@ -292,6 +505,26 @@ int main()
 					{
 						// --------------------------------------------------------------------------------
 
+#ifdef PROFILING
+						// Write the trace recorded so far
+						case sf::Keyboard::T:
+						{
+							if (Profiler::GetInstance().IsTracing())
+							{
+								if (Profiler::GetInstance().WriteTrace(traceFileName))
+								{
+									std::cout << "Trace written to " << traceFileName << std::endl;
+								}
+								else
+								{
+									std::cout << "Failed to write the trace to " << traceFileName << std::endl;
+								}
+							}
+
+							break;
+						}
+#endif // PROFILING
+
 						// Handle start/stop benchmark
 						case sf::Keyboard::B:
 						{
@@ -316,6 +549,7 @@ int main()
 								std::cout << "Min time per frame: " << fMinTimePerFrame << std::endl;
 								std::cout << "Max time per frame: " << fMaxTimePerFrame << std::endl;
 								std::cout << "Average time per frame: " << fAverageTimePerFrame << std::endl;
+								PrintFrameTimes(std::cout, frameTimes, fBenchmarkWarmUp, false);
 
 								std::cout << "Soft body count: " << SoftBodiesList.size() << std::endl;
 							}
@@ -333,6 +567,8 @@ int main()
 								fAverageFPS = 0.0f;
 								fTotalFrames = 0.0f;
 								fBenchmarkTimeAccumulator = 0.0f;
+								fBenchmarkWarmUpAccumulator = 0.0f;
+								frameTimes.Clear();
 
 								fMinTimePerFrame = std::numeric_limits<float>::max();
 								fMaxTimePerFrame = std::numeric_limits<float>::min();
@@ -481,7 +717,6 @@ int main()
 #ifdef MULTITHREADING
 							FluidSimulation* fluidsList = SimulationManager::GetInstance().GetFluidSimulationList()[0];
 							fluidsList[0].AddFluidParticles(glm::vec2(currentMousePosition.x, currentMousePosition.y), sf::Color::Red);
-							fluidsList[0].SetupMultithread();
 #endif // MULTITHREADING
 
 							bFluidInput = false;
@@ -633,6 +868,9 @@ int main()
 			if (deformableControlledParticle != nullptr)
 			{
 				deformableControlledParticle->Position = glm::vec2(currentMousePosition.x, currentMousePosition.y);
+
+				// The soft bodies only track the particles they move themselves
+				SpatialPartition::GetInstance().InvalidateSoftBodyGrid();
 			}
 		}
 		
@@ -644,9 +882,20 @@ int main()
 		fTimeAccumulator += fFrameTime;
 
 		// Update benchmark time
+		bool bBenchmarkFrame = false;
 		if (bBenchmarkMode)
 		{
-			fBenchmarkTimeAccumulator += fFrameTime;
+			// The frames of the warm-up are not recorded
+			if (fBenchmarkWarmUpAccumulator < fBenchmarkWarmUp)
+			{
+				fBenchmarkWarmUpAccumulator += fFrameTime;
+			}
+			else
+			{
+				bBenchmarkFrame = true;
+				fBenchmarkTimeAccumulator += fFrameTime;
+				frameTimes.Record(fFrameTime);
+			}
 
 			// Benchmark ended - show results
 			if (fBenchmarkTimeAccumulator >= fBenchmarkLength)
@@ -667,6 +916,7 @@ int main()
 				outFile << "Single threaded." << std::endl;
 #endif // MULTITHREADING
 				outFile << "Fluid particle count: " << FluidSimulationList[0]->GetPaticleCount() << std::endl;
+				outFile << "Reorder interval: " << FluidSimulationList[0]->GetReorderInterval() << std::endl;
 				outFile << "Min FPS: " << iMinFPS << std::endl;
 				outFile << "Max FPS: " << iMaxFPS << std::endl;
 				outFile << "Average FPS: " << fAverageFPS << std::endl;
@@ -675,6 +925,7 @@ int main()
 				outFile << "Min time per frame: " << fMinTimePerFrame << std::endl;
 				outFile << "Max time per frame: " << fMaxTimePerFrame << std::endl;
 				outFile << "Average time per frame: " << fAverageTimePerFrame << std::endl;
+				PrintFrameTimes(outFile, frameTimes, fBenchmarkWarmUp, true);
 
 				outFile << "Soft body count: " << SoftBodiesList.size() << std::endl;
 				outFile << "Soft body particle count: " << ParticleManager::GetInstance().GetDeformableParticles().size() << std::endl;
@@ -686,6 +937,10 @@ int main()
 
 		// Get the total particle count
 		unsigned int iParticleCount = ParticleManager::GetInstance().GetParticles().size();
+		for each (std::shared_ptr<FluidSimulation> fluidSim in FluidSimulationList)
+		{
+			iParticleCount += fluidSim->GetPaticleCount();
+		}
 
 		for (int speedCounter = 0; speedCounter < SPEEDMULTIPLIER; speedCounter++)
 		{
@@ -694,18 +949,15 @@ int main()
 				// Fluid application update 	
 				for each (std::shared_ptr<FluidSimulation> fluidSim in FluidSimulationList)
 				{
-					fluidSim->Update(window, FIXED_DELTA);
+					fluidSim->Update(FIXED_DELTA);
 				}
 			}
 				
 			if (SOFTBODY_SIMULATION)
 			{
-				// Soft-bodies update
-				std::vector<SoftBody*>& SoftBodyList = SimulationManager::GetInstance().GetSoftBodySimulationList();
-				for each (SoftBody* pSoftBody in SoftBodyList)
-				{
-					pSoftBody->Update(FIXED_DELTA);
-				}
+				// Soft-bodies update, on the threads of the fluid solver if there is one
+				WorkerTeam* pWorkerTeam = FluidSimulationList.empty() ? nullptr : FluidSimulationList[0]->GetWorkerTeam();
+				SimulationManager::GetInstance().UpdateSoftBodies(FIXED_DELTA, pWorkerTeam);
 			}
 		}
 
@@ -713,23 +965,26 @@ int main()
 		iFPS = (unsigned int)(1.0f / intervalTime.asSeconds());
 
 		// Update benchmark data
-		if (iFPS > iMaxFPS)
-		{
-			iMaxFPS = iFPS;
-		}
-		if (iFPS < iMinFPS)
-		{
-			iMinFPS = iFPS;
-		}
-		if (fFrameTime < fMinTimePerFrame)
+		if (bBenchmarkFrame)
 		{
-			fMinTimePerFrame = fFrameTime;
-		}
-		if (fFrameTime > fMaxTimePerFrame)
-		{
-			fMaxTimePerFrame = fFrameTime;
+			if (iFPS > iMaxFPS)
+			{
+				iMaxFPS = iFPS;
+			}
+			if (iFPS < iMinFPS)
+			{
+				iMinFPS = iFPS;
+			}
+			if (fFrameTime < fMinTimePerFrame)
+			{
+				fMinTimePerFrame = fFrameTime;
+			}
+			if (fFrameTime > fMaxTimePerFrame)
+			{
+				fMaxTimePerFrame = fFrameTime;
+			}
+			fTotalFrames++;
 		}
-		fTotalFrames++;
 
 		// Container draw
 		DrawContainer(window);
@@ -747,11 +1002,26 @@ int main()
 
 		appStats.Draw(window);
 
+#ifdef PROFILING
+		PROFILE_END_FRAME();
+
+		profileStats.SetString(Profiler::GetInstance().GetBreakdownString());
+		profileStats.Draw(window);
+#endif // PROFILING
+
 		// --------------------------------------------------------------------------
 		window.display();
 	}
 
 	outFile.close();
 
+#ifdef PROFILING
+	if (Profiler::GetInstance().IsTracing())
+	{
+		Profiler::GetInstance().StopTrace();
+		Profiler::GetInstance().WriteTrace(traceFileName);
+	}
+#endif // PROFILING
+
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <initializer_list>
+#include <math.h>
+
+#include "FrameTimeHistogram.h"
+
+// ----------------------------------------------------------------------------
+// Boundaries of the frame time histogram: the shortest and longest recordable
+// times, the clamp of longer ones and the bucket precision around them. Run
+// by ctest, the exit code is 1 if a check fails.
+// ----------------------------------------------------------------------------
+
+static int s_iFailureCount = 0;
+
+static void Check(bool bCondition, const std::string& description)
+{
+	if (!bCondition)
+	{
+		std::cerr << "FAILED: " << description << std::endl;
+		s_iFailureCount++;
+	}
+}
+
+// Within the 1/64 precision of the buckets
+static bool IsClose(double fValue, double fExpected)
+{
+	return fabs(fValue - fExpected) <= fExpected / 64.0 + 1e-6;
+}
+
+// ------------------------------------------------------------------------
+
+int main()
+{
+	const double fMaxTime = FrameTimeHistogram::GetMaxRecordableTime();
+	Check(fMaxTime > 35.0 * 60.0, "the range covers 35 minutes");
+
+	// The largest value lands in the last bucket
+	{
+		FrameTimeHistogram histogram;
+		histogram.Record(fMaxTime);
+
+		Check(histogram.GetCount() == 1, "the largest time is counted");
+		Check(histogram.GetMax() == fMaxTime, "the largest time is recorded as itself");
+		Check(histogram.GetPercentile(100.0) == fMaxTime, "the percentile of the largest time");
+
+		// Its bucket is inside the histogram, where the percentiles and the listing find it
+		std::stringstream buckets;
+		histogram.PrintBuckets(buckets);
+		Check(!buckets.str().empty(), "the bucket of the largest time is listed");
+	}
+
+	// Longer times, up to infinity, are clamped to it
+	{
+		FrameTimeHistogram histogram;
+		histogram.Record(1500.0);
+		histogram.Record(fMaxTime * 2.0);
+		histogram.Record(1e30);
+		histogram.Record(INFINITY);
+
+		Check(histogram.GetCount() == 4, "the clamped times are counted");
+		Check(histogram.GetMax() == fMaxTime, "the clamped times are recorded as the largest time");
+		Check(histogram.GetPercentile(50.0) == fMaxTime, "the percentile of the clamped times");
+	}
+
+	// Negative and zero times land in the first bucket
+	{
+		FrameTimeHistogram histogram;
+		histogram.Record(-1.0);
+		histogram.Record(0.0);
+
+		Check(histogram.GetCount() == 2, "the negative times are counted");
+		Check(histogram.GetMin() == 0.0 && histogram.GetMax() == 0.0, "the negative times are recorded as 0");
+	}
+
+	// Both ends of every magnitude keep the precision
+	{
+		FrameTimeHistogram histogram;
+		for (unsigned int iMagnitude = 0; iMagnitude <= 24; iMagnitude++)
+		{
+			double fTime = (128ULL << iMagnitude) / 1000000.0;
+			for (double fValue : { fTime * 0.5, fTime * 0.999 })
+			{
+				histogram.Clear();
+				histogram.Record(fValue);
+				Check(IsClose(histogram.GetPercentile(50.0), fValue), "the percentile of " + std::to_string(fValue) + " s");
+			}
+		}
+	}
+
+	if (s_iFailureCount > 0)
+	{
+		std::cerr << s_iFailureCount << " checks failed" << std::endl;
+		return 1;
+	}
+
+	std::cout << "All checks passed" << std::endl;
+	return 0;
+}